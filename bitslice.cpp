@@ -0,0 +1,369 @@
+#include "bitslice.h"
+#include "support.h"
+
+#include <algorithm>
+
+//------------------------------------------------------------------------------
+static int PopCount (SliceWord w)
+{
+#ifdef __GNUC__
+	return __builtin_popcountll (w);
+#else
+	int n = 0;
+	while (w)
+	{
+		w &= w - 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+//------------------------------------------------------------------------------
+BitSlicedClassifier::BitSlicedClassifier (const TreeIndex *supertree)
+{
+	ST = supertree;
+	Seen.assign (ST->GetNumTaxa(), false);
+	NodePos.assign (ST->GetNumNodes(), -1);
+	Below.assign (ST->GetNumNodes(), 0);
+	Up.assign (ST->GetNumNodes(), -1);
+	Clear ();
+}
+
+//------------------------------------------------------------------------------
+void BitSlicedClassifier::Clear ()
+{
+	for (int v = svSupport; v <= svPermit; v++)
+		Tally[v].assign (ST->GetNumNodes(), 0);
+	TreeNumber.clear ();
+	Clusters.clear ();
+	Undisplayed.clear ();
+	Conflicts.clear ();
+
+	QueuedNumber.clear ();
+	LeafStart.assign (1, 0);
+	LeafNode.clear ();
+	Top.clear ();
+	ClusterStart.assign (1, 0);
+	ClusterLo.clear ();
+	ClusterHi.clear ();
+	ClusterTop.clear ();
+	Declined = false;
+	InducedNodes = 0;
+	BlockLeaves = 0;
+}
+
+//------------------------------------------------------------------------------
+bool BitSlicedClassifier::AddTree (const TreeIndex &t, int k)
+{
+	int n = t.GetNumLeaves ();
+	if (Declined || (n == 0) || (n > MaxLeaves))
+		return false;
+
+	int start = (int)LeafNode.size();
+	bool ok = true;
+	for (int i = 0; (i < n) && ok; i++)
+	{
+		int x = t.GetTaxon (t.GetLeafAtRank (i));
+		ok = (x >= 0) && (x < ST->GetNumTaxa()) && (ST->GetLeafOfTaxon (x) != -1) && !Seen[x];
+		if (ok)
+		{
+			Seen[x] = true;
+			LeafNode.push_back (ST->GetLeafOfTaxon (x));
+		}
+	}
+	for (int i = 0; i < n; i++)
+	{
+		int x = t.GetTaxon (t.GetLeafAtRank (i));
+		if ((x >= 0) && (x < ST->GetNumTaxa()))
+			Seen[x] = false;
+	}
+	if (!ok)
+	{
+		LeafNode.resize (start);
+		return false;
+	}
+
+	// LCA in the supertree of the leaves below each node, children first
+	NodeTop.assign (t.GetNumNodes(), -1);
+	for (int i = 0; i < t.GetNumNodes(); i++)
+	{
+		if (t.IsLeaf (i))
+			NodeTop[i] = LeafNode[start + t.GetLeafLo (i)];
+		int a = t.GetParent (i);
+		if (a != -1)
+			NodeTop[a] = (NodeTop[a] == -1) ? NodeTop[i] : ST->LCA (NodeTop[a], NodeTop[i]);
+	}
+	Top.push_back (NodeTop[t.GetRoot()]);
+
+	// Nontrivial non-root clusters, as in SupportEngine::PrepareTree
+	for (int i = 0; i < t.GetNumNodes(); i++)
+	{
+		int size = t.GetClusterSize (i);
+		if (!t.IsLeaf (i) && (i != t.GetRoot()) && (size >= 2) && (size < n))
+		{
+			ClusterLo.push_back (t.GetLeafLo (i));
+			ClusterHi.push_back (t.GetLeafHi (i));
+			ClusterTop.push_back (NodeTop[i]);
+		}
+	}
+	if ((int)ClusterLo.size() - ClusterStart.back() > MaxLeaves)
+	{
+		// Unary nodes repeat clusters
+		LeafNode.resize (start);
+		Top.pop_back ();
+		ClusterLo.resize (ClusterStart.back());
+		ClusterHi.resize (ClusterStart.back());
+		ClusterTop.resize (ClusterStart.back());
+		return false;
+	}
+	QueuedNumber.push_back (k);
+	LeafStart.push_back ((int)LeafNode.size());
+	ClusterStart.push_back ((int)ClusterLo.size());
+
+	if (QueuedNumber.size() == 64)
+		Flush ();
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// The induced nodes are the leaves of the block and the nodes with taxa
+// of the block below two or more children. Walking up from each leaf as
+// far as the first node already seen counts those children, and touches
+// each ancestor of the leaves once. The touched nodes are then sorted by
+// depth (a counting sort, as depths are small), so that parents come
+// before children, or children before parents if taken in reverse.
+void BitSlicedClassifier::InduceBlock ()
+{
+	int b = (int)QueuedNumber.size();
+	Touched.clear ();
+	int lo = ST->GetNumNodes ();
+	int hi = 0;
+	for (int p = 0; p < LeafStart[b]; p++)
+	{
+		int u = LeafNode[p];
+		if (Below[u] != 0)
+			continue;
+		Below[u] = 1;
+		Touched.push_back (u);
+		hi = std::max (hi, ST->GetDepth (u));
+		int a;
+		for (a = ST->GetParent (u); a != -1; a = ST->GetParent (a))
+		{
+			if (Below[a]++ != 0)
+				break;
+			Touched.push_back (a);
+		}
+		if (a == -1)
+			lo = 0;
+		else
+			lo = std::min (lo, ST->GetDepth (a));
+	}
+	int m = (int)Touched.size();
+	DepthStart.assign (hi - lo + 2, 0);
+	for (int k = 0; k < m; k++)
+		DepthStart[ST->GetDepth (Touched[k]) - lo + 1]++;
+	for (int d = lo; d <= hi; d++)
+		DepthStart[d - lo + 1] += DepthStart[d - lo];
+	ByDepth.resize (m);
+	for (int k = 0; k < m; k++)
+	{
+		int u = Touched[k];
+		ByDepth[DepthStart[ST->GetDepth (u) - lo]++] = u;
+	}
+
+	// Below counts the children of each internal node with taxa of the
+	// block below them, each child's walk having reached it once
+	Sub.Clear ();
+	for (int k = m - 1; k >= 0; k--)
+	{
+		int u = ByDepth[k];
+		if (ST->IsLeaf (u) || (Below[u] >= 2))
+		{
+			NodePos[u] = Sub.GetNumNodes ();
+			Sub.Host.push_back (u);
+		}
+	}
+	for (int k = 0; k < m; k++)
+	{
+		int u = ByDepth[k];
+		int a = ST->GetParent (u);
+		Up[u] = (a == -1) ? -1 : ((NodePos[a] != -1) ? a : Up[a]);
+	}
+	Sub.Parent.resize (Sub.GetNumNodes());
+	for (int k = 0; k < Sub.GetNumNodes(); k++)
+	{
+		int a = Up[Sub.Host[k]];
+		Sub.Parent[k] = (a == -1) ? -1 : NodePos[a];
+	}
+}
+
+//------------------------------------------------------------------------------
+void BitSlicedClassifier::ClassifyTile (int first, int width)
+{
+	// Three words per node and slot: trees with a taxon of X below the
+	// node, with a taxon of L - X, and with X within the node's clade
+	int m = Sub.GetNumNodes ();
+	int b = (int)QueuedNumber.size();
+	int stride = 3 * width;
+	Words.assign (m * stride, 0);
+	SliceWord *words = &Words[0];
+	for (int j = 0; j < b; j++)
+	{
+		SliceWord bit = SliceWord (1) << j;
+		for (int i = 0; i < width; i++)
+		{
+			int c = ClusterStart[j] + first + i;
+			if (c >= ClusterStart[j + 1])
+				break;
+			for (int p = LeafStart[j]; p < LeafStart[j + 1]; p++)
+			{
+				int pos = p - LeafStart[j];
+				SliceWord *w = words + NodePos[LeafNode[p]] * stride + 3 * i;
+				if ((pos >= ClusterLo[c]) && (pos <= ClusterHi[c]))
+					w[0] |= bit;
+				else
+					w[1] |= bit;
+			}
+			words[NodePos[ClusterTop[c]] * stride + 3 * i + 2] |= bit;
+		}
+	}
+
+	// Children precede parents in Sub, so each node's words are complete
+	// when it is reached. The root is relevant to no tree.
+	SliceWord found[MaxLeaves];
+	SliceWord conflicted[MaxLeaves];
+	for (int i = 0; i < width; i++)
+		found[i] = conflicted[i] = 0;
+	for (int k = 0; k < m - 1; k++)
+	{
+		SliceWord *w = words + k * stride;
+		SliceWord *pw = words + Sub.Parent[k] * stride;
+		SliceWord s = 0;
+		SliceWord c = 0;
+		for (int i = 0; i < stride; i += 3)
+		{
+			SliceWord x = w[i];
+			SliceWord y = w[i + 1];
+			SliceWord inside = w[i + 2];
+			SliceWord si = inside & ~y;
+			SliceWord ci = x & ~inside & y;
+			found[i / 3] |= si;
+			conflicted[i / 3] |= ci;
+			s |= si;
+			c |= ci;
+			pw[i] |= x;
+			pw[i + 1] |= y;
+			pw[i + 2] |= inside;
+		}
+		Sup[k] |= s;
+		Con[k] |= c;
+	}
+	for (int i = 0; i < width; i++)
+	{
+		Found[first + i] = found[i];
+		Conflicted[first + i] = conflicted[i];
+	}
+}
+
+//------------------------------------------------------------------------------
+void BitSlicedClassifier::Flush ()
+{
+	int b = (int)QueuedNumber.size();
+	if (b == 0)
+		return;
+
+	// Clades restricting to the same subset of the block's taxa get the
+	// same verdicts, so only the subtree induced by those taxa is
+	// classified, the verdict of each of its nodes applying to the path
+	// up to its parent, as in SupportEngine
+	InduceBlock ();
+	int m = Sub.GetNumNodes ();
+
+	// If the trees share few taxa the induced subtree has about two nodes
+	// per leaf of the block, as many as classifying the trees one at a
+	// time would visit, so leave the rest to SupportEngine
+	InducedNodes += m;
+	BlockLeaves += LeafStart[b];
+	if ((TreeNumber.size() >= 256) && (4 * InducedNodes > 7 * BlockLeaves))
+		Declined = true;
+
+	// Relevance: trees with taxa below the node but not all of them
+	Words.assign (2 * m, 0);
+	SliceWord *words = &Words[0];
+	for (int j = 0; j < b; j++)
+	{
+		SliceWord bit = SliceWord (1) << j;
+		for (int p = LeafStart[j]; p < LeafStart[j + 1]; p++)
+			words[2 * NodePos[LeafNode[p]]] |= bit;
+		words[2 * NodePos[Top[j]] + 1] |= bit;
+	}
+	Relevant.resize (m);
+	for (int k = 0; k < m - 1; k++)
+	{
+		Relevant[k] = words[2 * k] & ~words[2 * k + 1];
+		int a = Sub.Parent[k];
+		words[2 * a] |= words[2 * k];
+		words[2 * a + 1] |= words[2 * k + 1];
+	}
+
+	int slots = 0;
+	for (int j = 0; j < b; j++)
+		slots = std::max (slots, ClusterStart[j + 1] - ClusterStart[j]);
+	Sup.assign (m, 0);
+	Con.assign (m, 0);
+	Found.assign (slots, 0);
+	Conflicted.assign (slots, 0);
+	int tile = std::max (1, std::min ((int)MaxLeaves, (int)(TileBytes / (3 * sizeof (SliceWord) * m))));
+	for (int first = 0; first < slots; first += tile)
+		ClassifyTile (first, std::min (tile, slots - first));
+
+	// A clade supported by a tree is compatible with all its clusters
+	for (int k = 0; k < m - 1; k++)
+	{
+		int u = Sub.Host[k];
+		int a = Sub.Host[Sub.Parent[k]];
+		SliceWord s = Sup[k];
+		SliceWord c = Con[k] & ~s;
+		int n = PopCount (s);
+		Tally[svSupport][u] += n;
+		Tally[svSupport][a] -= n;
+		n = PopCount (c);
+		Tally[svConflict][u] += n;
+		Tally[svConflict][a] -= n;
+		n = PopCount (Relevant[k] & ~s & ~c);
+		Tally[svPermit][u] += n;
+		Tally[svPermit][a] -= n;
+	}
+	for (int k = 0; k < m; k++)
+		NodePos[Sub.Host[k]] = -1;
+	for (int k = 0; k < (int)Touched.size(); k++)
+		Below[Touched[k]] = 0;
+
+	for (int j = 0; j < b; j++)
+	{
+		int clusters = ClusterStart[j + 1] - ClusterStart[j];
+		int undisplayed = 0;
+		int conflicts = 0;
+		for (int i = 0; i < clusters; i++)
+		{
+			if (((Found[i] >> j) & 1) == 0)
+				undisplayed++;
+			if ((Conflicted[i] >> j) & 1)
+				conflicts++;
+		}
+		TreeNumber.push_back (QueuedNumber[j]);
+		Clusters.push_back (clusters);
+		Undisplayed.push_back (undisplayed);
+		Conflicts.push_back (conflicts);
+	}
+
+	QueuedNumber.clear ();
+	LeafStart.assign (1, 0);
+	LeafNode.clear ();
+	Top.clear ();
+	ClusterStart.assign (1, 0);
+	ClusterLo.clear ();
+	ClusterHi.clear ();
+	ClusterTop.clear ();
+}
@@ -0,0 +1,184 @@
+/**
+ * @file bitslice.h
+ *
+ * Classify supertree clades against blocks of 64 small input trees at once.
+ *
+ */
+
+#ifndef BITSLICEH
+#define BITSLICEH
+
+#include <vector>
+
+#include "treeindex.h"
+
+/**
+ * @var typedef unsigned long long SliceWord
+ * @brief One bit per input tree of a block
+ */
+typedef unsigned long long SliceWord;
+
+/**
+ * @class BitSlicedClassifier
+ * Counts the verdicts of SupportEngine for small input trees, 64 trees at
+ * a time, with the trees of a block as the bits of a word.
+ *
+ * For a clade C and an input tree with leaf set L, C is relevant if it
+ * contains a taxon of L but not all of them. Each supertree leaf has a
+ * word with a bit set for the trees containing its taxon (a slice of the
+ * transposed taxon by tree matrix), so the trees with a taxon in C are
+ * the OR of the words below C's node. Similarly, L lies within C if C's
+ * node is an ancestor of the LCA of L, so marking each tree at that LCA
+ * gives the trees with no taxon outside C as another OR below the node.
+ * Both are found for every clade in one postorder pass.
+ *
+ * Support and conflict are decided the same way, one cluster slot at a
+ * time: slot i holds the ith nontrivial cluster X of each tree of the
+ * block, and R = C restricted to L. R is X if X lies within C and C has
+ * no taxa of L - X; X conflicts with R if X meets C, X is not within C
+ * and C has taxa of L - X.
+ *
+ * Clades with the same taxa of the block get the same verdicts, so only
+ * the subtree of the supertree induced by the taxa of the block is
+ * classified, and a block costs O(slots x induced nodes) word operations
+ * whatever the number of trees in it. The words of several slots are
+ * kept side by side for each node, in tiles of as many slots as keep the
+ * words of the block within TileBytes, so each pass works in L2 cache.
+ * Only trees with at most MaxLeaves leaves and clusters, all taxa in the
+ * supertree and none repeated, are accepted, and none at all once the
+ * blocks classified show that the trees share too few taxa for blocks to
+ * pay.
+ */
+class BitSlicedClassifier
+{
+public:
+	/**
+	 * Largest input tree accepted (in leaves and in clusters), and size of
+	 * the words of a tile
+	 */
+	enum { MaxLeaves = 32, TileBytes = 262144 };
+
+	/**
+	 * @param supertree the indexed supertree. BuildLCA must have been called.
+	 */
+	BitSlicedClassifier (const TreeIndex *supertree);
+	virtual ~BitSlicedClassifier () {};
+
+	/**
+	 * Reset all counts to zero and drop any trees not yet classified.
+	 */
+	virtual void Clear ();
+	/**
+	 * Queue an input tree, classifying the block once it has 64 trees.
+	 * @param t the indexed input tree
+	 * @param k number of the tree, under which its own counts are reported
+	 * @return false (and the tree is not queued) if the tree is too large
+	 * or has taxa absent from the supertree or repeated, or if blocks are
+	 * no longer being formed
+	 */
+	virtual bool AddTree (const TreeIndex &t, int k);
+	/**
+	 * Classify the trees queued so far.
+	 */
+	virtual void Flush ();
+
+	/**
+	 * @return the difference, for the trees classified, between the number
+	 * with the given verdict (svSupport, svConflict or svPermit) on the
+	 * clade below node and the sum of those numbers for its children.
+	 * Summed over subtrees, as by SupportEngine::Finish, these give the
+	 * counts.
+	 */
+	int GetDifference (int node, int verdict) const { return Tally[verdict][node]; };
+	/**
+	 * @return the number of trees classified
+	 */
+	int GetNumTrees () const { return (int)TreeNumber.size(); };
+	/**
+	 * For the ith tree classified: its number k as passed to AddTree, the
+	 * number of its nontrivial clusters, of those not clusters of the
+	 * supertree restricted to its taxa, and of those conflicting with a
+	 * clade of the supertree.
+	 */
+	void GetTreeCounts (int i, int &k, int &clusters, int &undisplayed, int &conflicts) const
+	{
+		k = TreeNumber[i];
+		clusters = Clusters[i];
+		undisplayed = Undisplayed[i];
+		conflicts = Conflicts[i];
+	};
+
+protected:
+	const TreeIndex *ST;
+	/**
+	 * Differences for each verdict and supertree node, indexed [verdict][node]
+	 */
+	std::vector<int> Tally[4];
+	/**
+	 * Per tree counts, in the order classified
+	 */
+	std::vector<int> TreeNumber;
+	std::vector<int> Clusters;
+	std::vector<int> Undisplayed;
+	std::vector<int> Conflicts;
+	/**
+	 * Whether further trees are refused, as the blocks so far shared too
+	 * few taxa, and the sizes behind that decision
+	 */
+	bool Declined;
+	long InducedNodes;
+	long BlockLeaves;
+
+	// Queued trees: the supertree leaf of each leaf (in the input tree's
+	// leaf order) and the LCA of them all, and each nontrivial cluster as
+	// an interval of positions in that order, with its LCA
+	std::vector<int> QueuedNumber;
+	std::vector<int> LeafStart;
+	std::vector<int> LeafNode;
+	std::vector<int> Top;
+	std::vector<int> ClusterStart;
+	std::vector<int> ClusterLo;
+	std::vector<int> ClusterHi;
+	std::vector<int> ClusterTop;
+	std::vector<bool> Seen;
+	std::vector<int> NodeTop;
+
+	// Subtree of the supertree induced by the taxa of the block, and the
+	// position in it of each supertree node (or -1). InduceBlock also
+	// counts the children of each node with taxa of the block below them,
+	// and finds the nearest induced proper ancestor of each node touched.
+	InducedSubtree Sub;
+	std::vector<int> NodePos;
+	std::vector<int> Below;
+	std::vector<int> Up;
+	std::vector<int> Touched;
+	std::vector<int> ByDepth;
+	std::vector<int> DepthStart;
+
+	// Words of the current tile, side by side for each induced node and
+	// slot: trees with a taxon of X below the node, with a taxon of L - X,
+	// and with X within the node's clade
+	std::vector<SliceWord> Words;
+	// For each induced node, the trees to which it is relevant, and which
+	// support or conflict with it
+	std::vector<SliceWord> Relevant;
+	std::vector<SliceWord> Sup;
+	std::vector<SliceWord> Con;
+	// For each slot, the trees whose cluster is found in the supertree, and
+	// whose cluster conflicts with a clade
+	std::vector<SliceWord> Found;
+	std::vector<SliceWord> Conflicted;
+
+	/**
+	 * Build the subtree of the supertree induced by the taxa of the block,
+	 * in time linear in the number of their ancestors rather than
+	 * TreeIndex::Induce's sorts, as the block may hold many taxa.
+	 */
+	virtual void InduceBlock ();
+	/**
+	 * Classify the block against slots first to first + width - 1.
+	 */
+	virtual void ClassifyTile (int first, int width);
+};
+
+#endif
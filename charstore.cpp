@@ -0,0 +1,308 @@
+#include "charstore.h"
+
+// NCL includes
+#include "nexusdefs.h"
+#include "xnexus.h"
+#include "nexustoken.h"
+#include "nexus.h"
+#include "taxablock.h"
+#include "assumptionsblock.h"
+#include "discretedatum.h"
+#include "discretematrix.h"
+#include "charactersblock.h"
+
+#include <cstring>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+	#define CHARSTORE_MMAP 1
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#define CHARSTORE_MAGIC "STSCHARS"
+#define CHARSTORE_VERSION 1
+#define CHARSTORE_BYTE_ORDER 0x01020304
+
+//------------------------------------------------------------------------------
+// Append a section to an image, padded so the next one is 8-byte aligned.
+static long long AddSection (std::vector<char> &image, const void *data, size_t bytes)
+{
+	long long offset = (long long)image.size();
+	if (bytes > 0)
+		image.insert (image.end(), (const char *)data, (const char *)data + bytes);
+	while (image.size() % 8 != 0)
+		image.push_back (0);
+	return offset;
+}
+
+//------------------------------------------------------------------------------
+// Append NUL-terminated strings, and the offset of each within them.
+static void AddStrings (const std::vector<std::string> &s, std::vector<long long> &index, std::vector<char> &blob)
+{
+	index.clear ();
+	blob.clear ();
+	for (int k = 0; k < (int)s.size(); k++)
+	{
+		index.push_back ((long long)blob.size());
+		blob.insert (blob.end(), s[k].begin(), s[k].end());
+		blob.push_back ('\0');
+	}
+	index.push_back ((long long)blob.size());
+}
+
+//------------------------------------------------------------------------------
+CharacterStore::CharacterStore ()
+{
+	Mapped = NULL;
+	MappedSize = 0;
+	Header = NULL;
+}
+
+//------------------------------------------------------------------------------
+CharacterStore::~CharacterStore ()
+{
+	Clear ();
+}
+
+//------------------------------------------------------------------------------
+void CharacterStore::Clear ()
+{
+#ifdef CHARSTORE_MMAP
+	if (Mapped)
+		munmap (Mapped, (size_t)MappedSize);
+#endif
+	Mapped = NULL;
+	MappedSize = 0;
+	Image.clear ();
+	Header = NULL;
+}
+
+//------------------------------------------------------------------------------
+int CharacterStore::CountStates (StateMask m)
+{
+	m >>= csFirstState;
+	int n = 0;
+	while (m)
+	{
+		m &= m - 1;
+		n++;
+	}
+	return n;
+}
+
+//------------------------------------------------------------------------------
+int CharacterStore::FirstState (StateMask m)
+{
+	m >>= csFirstState;
+	if (m == 0)
+		return -1;
+	int k = 0;
+	while ((m & 1) == 0)
+	{
+		m >>= 1;
+		k++;
+	}
+	return k;
+}
+
+//------------------------------------------------------------------------------
+bool CharacterStore::Build (CharactersBlock &c, AssumptionsBlock *a)
+{
+	Clear ();
+	int ntax = c.GetNTax ();
+	int nchar = c.GetNChar ();
+	int ncharTotal = c.GetNCharTotal ();
+
+	// Cell width, from the number of symbols and the states actually used
+	std::string symbols (c.GetSymbols() ? c.GetSymbols() : "");
+	int nstates = (int)symbols.size();
+	for (int j = 0; j < nchar; j++)
+		for (int i = 0; i < ntax; i++)
+			if (!c.IsMissingState (i, j) && !c.IsGapState (i, j))
+				for (int k = 0; k < c.GetNumStates (i, j); k++)
+					if (c.GetInternalRepresentation (i, j, k) >= nstates)
+						nstates = c.GetInternalRepresentation (i, j, k) + 1;
+	int bits = nstates + csFirstState;
+	int width = (bits <= 8) ? 1 : ((bits <= 16) ? 2 : 4);
+	if (bits > 32)
+		return false;
+
+	std::vector<unsigned char> cells ((size_t)nchar * ntax * width, 0);
+	for (int j = 0; j < nchar; j++)
+	{
+		for (int i = 0; i < ntax; i++)
+		{
+			StateMask m = 0;
+			if (c.IsMissingState (i, j))
+				m = csMissing;
+			else if (c.IsGapState (i, j))
+				m = csGap;
+			else
+			{
+				for (int k = 0; k < c.GetNumStates (i, j); k++)
+					m |= (StateMask)1 << (c.GetInternalRepresentation (i, j, k) + csFirstState);
+				if (c.IsPolymorphic (i, j))
+					m |= csPolymorphic;
+			}
+			unsigned char *p = &cells[((size_t)j * ntax + i) * width];
+			if (width == 1)
+				*p = (unsigned char)m;
+			else if (width == 2)
+				*(unsigned short *)p = (unsigned short)m;
+			else
+				*(unsigned int *)p = m;
+		}
+	}
+
+	std::vector<std::string> taxonLabels, charLabels, setNames;
+	std::vector<unsigned char> activeTaxa (ntax), activeChars (nchar), eliminated (ncharTotal);
+	std::vector<int> origChar (nchar);
+	for (int i = 0; i < ntax; i++)
+	{
+		taxonLabels.push_back (c.GetTaxonLabel (c.GetOrigTaxonIndex (i)));
+		activeTaxa[i] = c.IsDeleted (i) ? 0 : 1;
+	}
+	for (int j = 0; j < nchar; j++)
+	{
+		origChar[j] = c.GetOrigCharIndex (j);
+		std::string label = c.GetCharLabel (origChar[j]);
+		charLabels.push_back ((label == " ") ? std::string ("") : label);
+		activeChars[j] = c.IsExcluded (j) ? 0 : 1;
+	}
+	for (int k = 0; k < ncharTotal; k++)
+		eliminated[k] = c.IsEliminated (k) ? 1 : 0;
+
+	std::vector<long long> setIndex (1, 0);
+	std::vector<int> setMembers;
+	if (a)
+	{
+		LabelList names;
+		a->GetCharSetNames (names);
+		for (int k = 0; k < (int)names.size(); k++)
+		{
+			IntSet &s = a->GetCharSet (names[k]);
+			setNames.push_back (names[k]);
+			for (IntSet::const_iterator it = s.begin(); it != s.end(); it++)
+				setMembers.push_back (*it);
+			setIndex.push_back ((long long)setMembers.size());
+		}
+	}
+
+	StoreHeader h;
+	memset (&h, 0, sizeof (h));
+	memcpy (h.Magic, CHARSTORE_MAGIC, 8);
+	h.Version = CHARSTORE_VERSION;
+	h.ByteOrder = CHARSTORE_BYTE_ORDER;
+	h.NumTaxa = ntax;
+	h.NumChars = nchar;
+	h.NumCharsTotal = ncharTotal;
+	h.NumCharSets = (int)setNames.size();
+	h.CellBytes = width;
+	h.NumSymbols = (int)symbols.size();
+
+	std::vector<char> image;
+	AddSection (image, &h, sizeof (h));
+	std::vector<long long> index;
+	std::vector<char> blob;
+	h.Offset[ssSymbols] = AddSection (image, symbols.c_str(), symbols.size() + 1);
+	AddStrings (taxonLabels, index, blob);
+	h.Offset[ssTaxonLabelIndex] = AddSection (image, &index[0], index.size() * sizeof (long long));
+	h.Offset[ssTaxonLabels] = AddSection (image, blob.empty() ? NULL : &blob[0], blob.size());
+	AddStrings (charLabels, index, blob);
+	h.Offset[ssCharLabelIndex] = AddSection (image, &index[0], index.size() * sizeof (long long));
+	h.Offset[ssCharLabels] = AddSection (image, blob.empty() ? NULL : &blob[0], blob.size());
+	h.Offset[ssActiveTaxa] = AddSection (image, activeTaxa.empty() ? NULL : &activeTaxa[0], activeTaxa.size());
+	h.Offset[ssActiveChars] = AddSection (image, activeChars.empty() ? NULL : &activeChars[0], activeChars.size());
+	h.Offset[ssOrigChar] = AddSection (image, origChar.empty() ? NULL : &origChar[0], origChar.size() * sizeof (int));
+	h.Offset[ssEliminated] = AddSection (image, eliminated.empty() ? NULL : &eliminated[0], eliminated.size());
+	AddStrings (setNames, index, blob);
+	h.Offset[ssCharSetNameIndex] = AddSection (image, &index[0], index.size() * sizeof (long long));
+	h.Offset[ssCharSetNames] = AddSection (image, blob.empty() ? NULL : &blob[0], blob.size());
+	h.Offset[ssCharSetIndex] = AddSection (image, &setIndex[0], setIndex.size() * sizeof (long long));
+	h.Offset[ssCharSets] = AddSection (image, setMembers.empty() ? NULL : &setMembers[0], setMembers.size() * sizeof (int));
+	h.Offset[ssMatrix] = AddSection (image, cells.empty() ? NULL : &cells[0], cells.size());
+	h.Size = (long long)image.size();
+	memcpy (&image[0], &h, sizeof (h));
+
+	Image.assign (image.size() / sizeof (long long), 0);
+	memcpy (&Image[0], &image[0], image.size());
+	Header = (const StoreHeader *)&Image[0];
+	return true;
+}
+
+//------------------------------------------------------------------------------
+bool CharacterStore::Save (const char *filename) const
+{
+	if (!Header)
+		return false;
+	std::ofstream f (filename, std::ios::out | std::ios::binary);
+	if (!f)
+		return false;
+	f.write ((const char *)Header, (std::streamsize)Header->Size);
+	f.close ();
+	return !f.fail();
+}
+
+//------------------------------------------------------------------------------
+bool CharacterStore::Check (const void *base, long long size) const
+{
+	const StoreHeader *h = (const StoreHeader *)base;
+	if ((size < (long long)sizeof (StoreHeader)) || (memcmp (h->Magic, CHARSTORE_MAGIC, 8) != 0)
+		|| (h->Version != CHARSTORE_VERSION) || (h->ByteOrder != CHARSTORE_BYTE_ORDER) || (h->Size != size))
+		return false;
+	for (int s = 0; s < ssNumSections; s++)
+		if ((h->Offset[s] < (long long)sizeof (StoreHeader)) || (h->Offset[s] > size) || (h->Offset[s] % 8 != 0))
+			return false;
+	return (h->Offset[ssMatrix] + (long long)h->NumTaxa * h->NumChars * h->CellBytes <= size);
+}
+
+//------------------------------------------------------------------------------
+bool CharacterStore::Load (const char *filename)
+{
+	Clear ();
+#ifdef CHARSTORE_MMAP
+	int fd = open (filename, O_RDONLY);
+	if (fd == -1)
+		return false;
+	struct stat st;
+	if ((fstat (fd, &st) != 0) || (st.st_size == 0))
+	{
+		close (fd);
+		return false;
+	}
+	void *p = mmap (NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+	if (p == MAP_FAILED)
+		return false;
+	Mapped = p;
+	MappedSize = (long long)st.st_size;
+	if (!Check (p, MappedSize))
+	{
+		Clear ();
+		return false;
+	}
+	Header = (const StoreHeader *)p;
+	return true;
+#else
+	std::ifstream f (filename, std::ios::in | std::ios::binary);
+	if (!f)
+		return false;
+	f.seekg (0, std::ios::end);
+	long long size = (long long)f.tellg ();
+	f.seekg (0, std::ios::beg);
+	if (size <= 0)
+		return false;
+	Image.assign ((size_t)(size + 7) / 8, 0);
+	f.read ((char *)&Image[0], (std::streamsize)size);
+	if (f.fail() || !Check (&Image[0], size))
+	{
+		Clear ();
+		return false;
+	}
+	Header = (const StoreHeader *)&Image[0];
+	return true;
+#endif
+}
@@ -0,0 +1,249 @@
+/**
+ * @file charstore.h
+ *
+ * Binary, memory-mapped store of the data in a CHARACTERS (or DATA) block.
+ *
+ */
+
+#ifndef CHARSTOREH
+#define CHARSTOREH
+
+#include <string>
+#include <vector>
+
+class CharactersBlock;
+class AssumptionsBlock;
+
+/**
+ * @var typedef unsigned int StateMask
+ * @brief The states of one cell of a character matrix, one bit each
+ */
+typedef unsigned int StateMask;
+
+/**
+ * Bits of a StateMask. State k (the internal representation used by
+ * CharactersBlock) is bit (k + csFirstState).
+ */
+enum
+{
+	csMissing = 1,			// missing data
+	csGap = 2,				// gap (inapplicable)
+	csPolymorphic = 4,		// polymorphism, rather than uncertainty, if more than one state
+	csFirstState = 3
+};
+
+/**
+ * @class StateView
+ * A row or column of a CharacterStore, read in place.
+ */
+class StateView
+{
+public:
+	StateView (const unsigned char *base, long long stride, int width, int size)
+	{
+		Base = base;
+		Stride = stride;
+		Width = width;
+		Size = size;
+	};
+
+	int GetSize () const { return Size; };
+	StateMask operator[] (int k) const
+	{
+		const unsigned char *p = Base + k * Stride;
+		if (Width == 1)
+			return *p;
+		if (Width == 2)
+			return *(const unsigned short *)p;
+		return *(const unsigned int *)p;
+	};
+
+protected:
+	const unsigned char *Base;
+	long long Stride;
+	int Width;
+	int Size;
+};
+
+/**
+ * @class CharacterStore
+ * The matrix of a CHARACTERS block as one state bitmask per cell, with
+ * the taxon and character labels, which taxa and characters are active,
+ * which characters were eliminated and the character sets, laid out as a
+ * single image that can be saved to a file and mapped back into memory
+ * (with mmap, where available) without parsing or allocating per cell.
+ *
+ * Cells are stored by character (each character's column is contiguous,
+ * as the analyses want them) in the fewest bytes (1, 2 or 4) that hold
+ * the flags and a bit for each symbol, so a binary MRP matrix takes one
+ * byte per cell rather than a DiscreteDatum. Labels are stored as
+ * NUL-terminated strings with a table of offsets, so they too are read in
+ * place. The image starts with a header giving its size, the byte order
+ * and the offset of each section, which Load checks before use.
+ *
+ * Characters and taxa are numbered as in the block (i.e., eliminated
+ * characters are not in the matrix, and GetOrigCharIndex gives the
+ * original number of each); characters sets hold original indices.
+ */
+class CharacterStore
+{
+public:
+	CharacterStore ();
+	virtual ~CharacterStore ();
+
+	/**
+	 * Release the image.
+	 */
+	virtual void Clear ();
+	/**
+	 * Copy the data of a block.
+	 * @param c the block
+	 * @param a the ASSUMPTIONS block with the character sets, or NULL
+	 * @return false if the block has more symbols than a StateMask holds
+	 */
+	virtual bool Build (CharactersBlock &c, AssumptionsBlock *a = NULL);
+	/**
+	 * Write the image to a file.
+	 * @return true if successful
+	 */
+	virtual bool Save (const char *filename) const;
+	/**
+	 * Map a file written by Save.
+	 * @return true if successful, false if the file can't be read or isn't
+	 * a store written on a machine with the same byte order
+	 */
+	virtual bool Load (const char *filename);
+
+	int GetNumTaxa () const { return Header ? Header->NumTaxa : 0; };
+	int GetNumCharacters () const { return Header ? Header->NumChars : 0; };
+	/**
+	 * @return the number of characters including those eliminated
+	 */
+	int GetNumCharactersTotal () const { return Header ? Header->NumCharsTotal : 0; };
+	int GetNumSymbols () const { return Header->NumSymbols; };
+	const char *GetSymbols () const { return (const char *)Section (ssSymbols); };
+	/**
+	 * @return bytes per cell
+	 */
+	int GetCellBytes () const { return Header->CellBytes; };
+
+	const char *GetTaxonLabel (int i) const { return String (ssTaxonLabels, i); };
+	const char *GetCharLabel (int j) const { return String (ssCharLabels, j); };
+	int GetOrigCharIndex (int j) const { return ((const int *)Section (ssOrigChar))[j]; };
+	bool IsActiveTaxon (int i) const { return Section (ssActiveTaxa)[i] != 0; };
+	bool IsActiveChar (int j) const { return Section (ssActiveChars)[j] != 0; };
+	bool IsEliminated (int origCharIndex) const { return Section (ssEliminated)[origCharIndex] != 0; };
+
+	int GetNumCharSets () const { return Header->NumCharSets; };
+	const char *GetCharSetName (int k) const { return String (ssCharSetNames, k); };
+	int GetCharSetSize (int k) const
+	{
+		const long long *first = (const long long *)Section (ssCharSetIndex);
+		return (int)(first[k + 1] - first[k]);
+	};
+	/**
+	 * @return the original indices of the characters in set k
+	 */
+	const int *GetCharSet (int k) const
+	{
+		const long long *first = (const long long *)Section (ssCharSetIndex);
+		return (const int *)Section (ssCharSets) + first[k];
+	};
+
+	/**
+	 * @return the states of taxon i for character j
+	 */
+	StateMask GetStates (int i, int j) const { return GetColumn (j)[i]; };
+	/**
+	 * @return the states of every taxon for character j
+	 */
+	StateView GetColumn (int j) const
+	{
+		int w = Header->CellBytes;
+		return StateView (Section (ssMatrix) + (long long)j * Header->NumTaxa * w, w, w, Header->NumTaxa);
+	};
+	/**
+	 * @return the states of taxon i for every character
+	 */
+	StateView GetRow (int i) const
+	{
+		int w = Header->CellBytes;
+		return StateView (Section (ssMatrix) + (long long)i * w, (long long)Header->NumTaxa * w, w, Header->NumChars);
+	};
+
+	/**
+	 * @return the number of states in a mask
+	 */
+	static int CountStates (StateMask m);
+	/**
+	 * @return the lowest state in a mask, or -1 if it has none
+	 */
+	static int FirstState (StateMask m);
+
+protected:
+	/**
+	 * Sections of the image. Each section of strings follows its index.
+	 */
+	enum
+	{
+		ssSymbols = 0,
+		ssTaxonLabelIndex,	// offset of each taxon label, and the end of the last
+		ssTaxonLabels,
+		ssCharLabelIndex,
+		ssCharLabels,
+		ssActiveTaxa,
+		ssActiveChars,
+		ssOrigChar,
+		ssEliminated,
+		ssCharSetNameIndex,
+		ssCharSetNames,
+		ssCharSetIndex,		// first member of each set, and the end of the last
+		ssCharSets,
+		ssMatrix,
+		ssNumSections
+	};
+
+	struct StoreHeader
+	{
+		char Magic[8];
+		int Version;
+		int ByteOrder;
+		int NumTaxa;
+		int NumChars;
+		int NumCharsTotal;
+		int NumCharSets;
+		int CellBytes;
+		int NumSymbols;
+		long long Size;
+		long long Offset[ssNumSections];
+	};
+
+	/**
+	 * Image built in memory, or read into memory where mmap isn't available
+	 */
+	std::vector<long long> Image;
+	/**
+	 * Mapped file, or NULL
+	 */
+	void *Mapped;
+	long long MappedSize;
+	const StoreHeader *Header;
+
+	const unsigned char *Section (int s) const { return (const unsigned char *)Header + Header->Offset[s]; };
+	const char *String (int s, int k) const
+	{
+		const long long *index = (const long long *)Section (s - 1);
+		return (const char *)Section (s) + index[k];
+	};
+	/**
+	 * Check that the image at base, of the given size, is a store.
+	 */
+	virtual bool Check (const void *base, long long size) const;
+
+private:
+	// The header points into the image or mapping, so stores aren't copied
+	CharacterStore (const CharacterStore &);
+	CharacterStore &operator= (const CharacterStore &);
+};
+
+#endif
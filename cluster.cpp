@@ -0,0 +1,469 @@
+#include "cluster.h"
+
+#include <algorithm>
+
+// Operations for ClusterSet::Operate
+enum
+{
+	opIntersection = 0,
+	opDifference,
+	opUnion
+};
+
+//------------------------------------------------------------------------------
+static int PopCount (ClusterWord w)
+{
+#ifdef __GNUC__
+	return __builtin_popcountll (w);
+#else
+	int n = 0;
+	while (w)
+	{
+		w &= w - 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+//------------------------------------------------------------------------------
+void ClusterSet::Assign (const std::vector<int> &members)
+{
+	std::vector<int> sorted (members);
+	std::sort (sorted.begin(), sorted.end());
+	sorted.erase (std::unique (sorted.begin(), sorted.end()), sorted.end());
+	std::vector<int> runs;
+	for (int i = 0; i < (int)sorted.size(); i++)
+	{
+		if (!runs.empty() && (runs.back() + 1 == sorted[i]))
+			runs.back() = sorted[i];
+		else
+		{
+			runs.push_back (sorted[i]);
+			runs.push_back (sorted[i]);
+		}
+	}
+	AssignRuns (runs, (int)sorted.size());
+}
+
+//------------------------------------------------------------------------------
+void ClusterSet::AssignInterval (int lo, int hi)
+{
+	std::vector<int> runs;
+	if (lo <= hi)
+	{
+		runs.push_back (lo);
+		runs.push_back (hi);
+	}
+	AssignRuns (runs, std::max (0, hi - lo + 1));
+}
+
+//------------------------------------------------------------------------------
+// Choose the smallest of the three forms (preferring the simpler on ties)
+void ClusterSet::AssignRuns (const std::vector<int> &runs, int size)
+{
+	Size = size;
+	Elements.clear ();
+	Bits.clear ();
+
+	// Merge adjacent runs
+	std::vector<int> merged;
+	for (int i = 0; i < (int)runs.size(); i += 2)
+	{
+		if (!merged.empty() && (merged.back() + 1 >= runs[i]))
+			merged.back() = std::max (merged.back(), runs[i + 1]);
+		else
+		{
+			merged.push_back (runs[i]);
+			merged.push_back (runs[i + 1]);
+		}
+	}
+
+	long sparseBytes = (long)size * sizeof (int);
+	long runBytes = (long)merged.size() * sizeof (int);
+	long denseBytes = (long)((Universe + 63) / 64) * sizeof (ClusterWord);
+	if ((sparseBytes <= runBytes) && (sparseBytes <= denseBytes))
+	{
+		Form = csSparse;
+		Elements.reserve (size);
+		for (int i = 0; i < (int)merged.size(); i += 2)
+			for (int x = merged[i]; x <= merged[i + 1]; x++)
+				Elements.push_back (x);
+	}
+	else if (runBytes <= denseBytes)
+	{
+		Form = csRuns;
+		Elements = merged;
+	}
+	else
+	{
+		Form = csDense;
+		Bits.assign ((Universe + 63) / 64, 0);
+		for (int i = 0; i < (int)merged.size(); i += 2)
+			for (int x = merged[i]; x <= merged[i + 1]; x++)
+				Bits[x / 64] |= (ClusterWord)1 << (x % 64);
+	}
+}
+
+//------------------------------------------------------------------------------
+bool ClusterSet::Contains (int x) const
+{
+	if ((x < 0) || (x >= Universe))
+		return false;
+	switch (Form)
+	{
+		case csSparse:
+			return std::binary_search (Elements.begin(), Elements.end(), x);
+		case csRuns:
+		{
+			// Last run starting at or before x
+			int lo = 0, hi = (int)Elements.size() / 2 - 1;
+			while (lo < hi)
+			{
+				int mid = (lo + hi + 1) / 2;
+				if (Elements[2 * mid] <= x)
+					lo = mid;
+				else
+					hi = mid - 1;
+			}
+			return (hi >= 0) && (Elements[2 * lo] <= x) && (x <= Elements[2 * lo + 1]);
+		}
+		default:
+			return (Bits[x / 64] >> (x % 64)) & 1;
+	}
+}
+
+//------------------------------------------------------------------------------
+void ClusterSet::GetMembers (std::vector<int> &members) const
+{
+	members.clear ();
+	members.reserve (Size);
+	switch (Form)
+	{
+		case csSparse:
+			members = Elements;
+			break;
+		case csRuns:
+			for (int i = 0; i < (int)Elements.size(); i += 2)
+				for (int x = Elements[i]; x <= Elements[i + 1]; x++)
+					members.push_back (x);
+			break;
+		default:
+			for (int w = 0; w < (int)Bits.size(); w++)
+				for (ClusterWord bits = Bits[w]; bits != 0; bits &= bits - 1)
+					members.push_back (w * 64 + PopCount ((bits & (~bits + 1)) - 1));
+			break;
+	}
+}
+
+//------------------------------------------------------------------------------
+void ClusterSet::GetRuns (std::vector<int> &runs) const
+{
+	runs.clear ();
+	switch (Form)
+	{
+		case csRuns:
+			runs = Elements;
+			break;
+		case csSparse:
+			for (int i = 0; i < (int)Elements.size(); i++)
+			{
+				if (!runs.empty() && (runs.back() + 1 == Elements[i]))
+					runs.back() = Elements[i];
+				else
+				{
+					runs.push_back (Elements[i]);
+					runs.push_back (Elements[i]);
+				}
+			}
+			break;
+		default:
+		{
+			int start = -1;
+			for (int x = 0; x <= Universe; x++)
+			{
+				// Skip empty and full words quickly
+				if ((x % 64 == 0) && (x + 64 <= Universe))
+				{
+					ClusterWord w = Bits[x / 64];
+					if ((w == 0) && (start == -1))
+					{
+						x += 63;
+						continue;
+					}
+					if ((w == ~(ClusterWord)0) && (start != -1))
+					{
+						x += 63;
+						continue;
+					}
+				}
+				bool in = (x < Universe) && ((Bits[x / 64] >> (x % 64)) & 1);
+				if (in && (start == -1))
+					start = x;
+				else if (!in && (start != -1))
+				{
+					runs.push_back (start);
+					runs.push_back (x - 1);
+					start = -1;
+				}
+			}
+			break;
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+// Apply op to a and b, storing the result if result is not NULL, and
+// return the size of the result.
+int ClusterSet::Operate (const ClusterSet &a, const ClusterSet &b, int op, ClusterSet *result)
+{
+	int universe = std::max (a.Universe, b.Universe);
+
+	// Word by word if both are dense
+	if ((a.Form == csDense) && (b.Form == csDense) && (a.Universe == b.Universe))
+	{
+		std::vector<ClusterWord> bits (a.Bits.size());
+		int size = 0;
+		for (int w = 0; w < (int)bits.size(); w++)
+		{
+			switch (op)
+			{
+				case opIntersection: bits[w] = a.Bits[w] & b.Bits[w]; break;
+				case opDifference: bits[w] = a.Bits[w] & ~b.Bits[w]; break;
+				default: bits[w] = a.Bits[w] | b.Bits[w]; break;
+			}
+			size += PopCount (bits[w]);
+		}
+		if (result)
+		{
+			ClusterSet tmp (universe);
+			tmp.Form = csDense;
+			tmp.Size = size;
+			tmp.Bits = bits;
+			std::vector<int> runs;
+			tmp.GetRuns (runs);
+			result->Universe = universe;
+			result->AssignRuns (runs, size);
+		}
+		return size;
+	}
+
+	// Filter the members of a small sparse set by membership of the other
+	if ((op != opUnion) && ((a.Form == csSparse) || ((op == opIntersection) && (b.Form == csSparse))))
+	{
+		bool swap = (a.Form != csSparse) || ((op == opIntersection) && (b.Form == csSparse) && (b.Size < a.Size));
+		const ClusterSet &s = swap ? b : a;
+		const ClusterSet &o = swap ? a : b;
+		std::vector<int> runs;
+		int size = 0;
+		for (int i = 0; i < (int)s.Elements.size(); i++)
+		{
+			int x = s.Elements[i];
+			if (o.Contains (x) == (op == opIntersection))
+			{
+				size++;
+				if (result)
+				{
+					if (!runs.empty() && (runs.back() + 1 == x))
+						runs.back() = x;
+					else
+					{
+						runs.push_back (x);
+						runs.push_back (x);
+					}
+				}
+			}
+		}
+		if (result)
+		{
+			result->Universe = universe;
+			result->AssignRuns (runs, size);
+		}
+		return size;
+	}
+
+	// Otherwise merge the lists of runs
+	std::vector<int> ra, rb, runs;
+	a.GetRuns (ra);
+	b.GetRuns (rb);
+	int i = 0, j = 0, size = 0;
+	int na = (int)ra.size(), nb = (int)rb.size();
+	switch (op)
+	{
+		case opIntersection:
+			while ((i < na) && (j < nb))
+			{
+				int lo = std::max (ra[i], rb[j]);
+				int hi = std::min (ra[i + 1], rb[j + 1]);
+				if (lo <= hi)
+				{
+					runs.push_back (lo);
+					runs.push_back (hi);
+					size += hi - lo + 1;
+				}
+				if (ra[i + 1] < rb[j + 1])
+					i += 2;
+				else
+					j += 2;
+			}
+			break;
+		case opDifference:
+			for (i = 0; i < na; i += 2)
+			{
+				int lo = ra[i];
+				while ((j < nb) && (rb[j + 1] < lo))
+					j += 2;
+				int k = j;
+				while ((lo <= ra[i + 1]) && (k < nb) && (rb[k] <= ra[i + 1]))
+				{
+					if (rb[k] > lo)
+					{
+						runs.push_back (lo);
+						runs.push_back (rb[k] - 1);
+						size += rb[k] - lo;
+					}
+					lo = std::max (lo, rb[k + 1] + 1);
+					k += 2;
+				}
+				if (lo <= ra[i + 1])
+				{
+					runs.push_back (lo);
+					runs.push_back (ra[i + 1]);
+					size += ra[i + 1] - lo + 1;
+				}
+			}
+			break;
+		default:
+			while ((i < na) || (j < nb))
+			{
+				int lo, hi;
+				if ((j >= nb) || ((i < na) && (ra[i] <= rb[j])))
+				{
+					lo = ra[i];
+					hi = ra[i + 1];
+					i += 2;
+				}
+				else
+				{
+					lo = rb[j];
+					hi = rb[j + 1];
+					j += 2;
+				}
+				if (!runs.empty() && (runs.back() + 1 >= lo))
+				{
+					if (hi > runs.back())
+					{
+						size += hi - runs.back();
+						runs.back() = hi;
+					}
+				}
+				else
+				{
+					runs.push_back (lo);
+					runs.push_back (hi);
+					size += hi - lo + 1;
+				}
+			}
+			break;
+	}
+	if (result)
+	{
+		result->Universe = universe;
+		result->AssignRuns (runs, size);
+	}
+	return size;
+}
+
+//------------------------------------------------------------------------------
+int ClusterSet::IntersectionSize (const ClusterSet &a, const ClusterSet &b)
+{
+	return Operate (a, b, opIntersection, NULL);
+}
+
+//------------------------------------------------------------------------------
+void ClusterSet::Intersection (const ClusterSet &a, const ClusterSet &b, ClusterSet &result)
+{
+	ClusterSet tmp;
+	Operate (a, b, opIntersection, &tmp);
+	result = tmp;
+}
+
+//------------------------------------------------------------------------------
+void ClusterSet::Difference (const ClusterSet &a, const ClusterSet &b, ClusterSet &result)
+{
+	ClusterSet tmp;
+	Operate (a, b, opDifference, &tmp);
+	result = tmp;
+}
+
+//------------------------------------------------------------------------------
+void ClusterSet::Union (const ClusterSet &a, const ClusterSet &b, ClusterSet &result)
+{
+	ClusterSet tmp;
+	Operate (a, b, opUnion, &tmp);
+	result = tmp;
+}
+
+//------------------------------------------------------------------------------
+bool ClusterSet::IsSubsetOf (const ClusterSet &other) const
+{
+	if (Size > other.Size)
+		return false;
+	return Operate (*this, other, opDifference, NULL) == 0;
+}
+
+//------------------------------------------------------------------------------
+bool ClusterSet::operator== (const ClusterSet &other) const
+{
+	return (Size == other.Size) && IsSubsetOf (other);
+}
+
+//------------------------------------------------------------------------------
+bool ClusterSet::IsCompatibleWith (const ClusterSet &other) const
+{
+	int common = IntersectionSize (*this, other);
+	return (common == 0) || (common == Size) || (common == other.Size);
+}
+
+//------------------------------------------------------------------------------
+void ClusterSet::TaxonRanks (const TreeIndex &t, std::vector<int> &rank)
+{
+	rank.assign (t.GetNumTaxa(), -1);
+	int next = 0;
+	for (int k = 0; k < t.GetNumLeaves(); k++)
+	{
+		int x = t.GetTaxon (t.GetLeafAtRank (k));
+		if ((x >= 0) && (rank[x] == -1))
+			rank[x] = next++;
+	}
+	for (int x = 0; x < t.GetNumTaxa(); x++)
+		if (rank[x] == -1)
+			rank[x] = next++;
+}
+
+//------------------------------------------------------------------------------
+void ClusterSet::NodeClusters (const TreeIndex &t, const std::vector<int> &rank, std::vector<ClusterSet> &clusters)
+{
+	int n = t.GetNumNodes ();
+	int universe = (int)rank.size();
+	clusters.assign (n, ClusterSet (universe));
+	std::vector<int> member (1);
+	for (int u = 0; u < t.GetNumLeaves(); u++)
+	{
+		if (t.GetTaxon (u) == -1)
+			continue;
+		member[0] = rank[t.GetTaxon (u)];
+		clusters[u].Assign (member);
+	}
+	// Children before parents
+	for (int k = n - 1; k >= 0; k--)
+	{
+		int u = t.GetNodeAtPreorder (k);
+		if (t.IsLeaf (u))
+			continue;
+		ClusterSet c (universe);
+		for (int v = t.GetChild (u); v != -1; v = t.GetSibling (v))
+			Union (c, clusters[v], c);
+		clusters[u] = c;
+	}
+}
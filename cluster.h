@@ -0,0 +1,128 @@
+/**
+ * @file cluster.h
+ *
+ * Compact representation of clusters (sets of taxa) for large trees.
+ *
+ */
+
+#ifndef CLUSTERH
+#define CLUSTERH
+
+#include <vector>
+
+#include "treeindex.h"
+
+/**
+ * @var typedef unsigned long long ClusterWord
+ * @brief One word of a dense cluster
+ */
+typedef unsigned long long ClusterWord;
+
+/**
+ * @class ClusterSet
+ * A set of integers from 0 to (universe - 1) stored in whichever of three
+ * forms takes least memory:
+ *
+ * - csSparse, a sorted list of the members (4 bytes per member), best for
+ * small clusters;
+ *
+ * - csRuns, a sorted list of maximal intervals [lo, hi] (8 bytes per run).
+ * If taxa are numbered in the order of the leaves of a tree (see
+ * TaxonRanks) every cluster of that tree is a single run, and clusters of
+ * similar trees have few runs;
+ *
+ * - csDense, a bitset (universe / 8 bytes).
+ *
+ * Sets are immutable once built, except by assignment. The binary
+ * operations accept any mix of forms, and choose the form of the result
+ * afresh. Unlike IntegerSet (std::set), memory depends on the structure
+ * of the cluster rather than just its size.
+ */
+class ClusterSet
+{
+public:
+	enum
+	{
+		csSparse = 0,
+		csRuns,
+		csDense
+	};
+
+	ClusterSet (int universe = 0) { Universe = universe; Size = 0; Form = csSparse; };
+	virtual ~ClusterSet () {};
+
+	/**
+	 * Set the members to the given list, which need not be sorted.
+	 */
+	virtual void Assign (const std::vector<int> &members);
+	/**
+	 * Set the members to lo, ..., hi.
+	 */
+	virtual void AssignInterval (int lo, int hi);
+
+	int GetUniverse () const { return Universe; };
+	int GetSize () const { return Size; };
+	bool IsEmpty () const { return Size == 0; };
+	int GetForm () const { return Form; };
+	/**
+	 * @return the number of bytes used to store the members
+	 */
+	int GetBytes () const { return (int)(Elements.size() * sizeof (int) + Bits.size() * sizeof (ClusterWord)); };
+
+	bool Contains (int x) const;
+	/**
+	 * @param members the members in increasing order
+	 */
+	virtual void GetMembers (std::vector<int> &members) const;
+	/**
+	 * @param runs the maximal intervals of members, as lo, hi pairs
+	 */
+	virtual void GetRuns (std::vector<int> &runs) const;
+
+	bool IsSubsetOf (const ClusterSet &other) const;
+	bool operator== (const ClusterSet &other) const;
+	bool operator!= (const ClusterSet &other) const { return !(*this == other); };
+	/**
+	 * @return true if the sets are disjoint or one contains the other
+	 */
+	bool IsCompatibleWith (const ClusterSet &other) const;
+
+	static int IntersectionSize (const ClusterSet &a, const ClusterSet &b);
+	static void Intersection (const ClusterSet &a, const ClusterSet &b, ClusterSet &result);
+	static void Difference (const ClusterSet &a, const ClusterSet &b, ClusterSet &result);
+	static void Union (const ClusterSet &a, const ClusterSet &b, ClusterSet &result);
+
+	/**
+	 * Number taxa by the order of the leaves of tree t (the rank of each
+	 * leaf in preorder), so that each cluster of t is a single run. Taxa
+	 * not in t are numbered after those that are.
+	 * @param t the tree
+	 * @param rank the number for each taxon
+	 */
+	static void TaxonRanks (const TreeIndex &t, std::vector<int> &rank);
+	/**
+	 * Build the cluster of every node of t, numbering taxa by rank.
+	 */
+	static void NodeClusters (const TreeIndex &t, const std::vector<int> &rank, std::vector<ClusterSet> &clusters);
+
+protected:
+	int Universe;
+	int Size;
+	int Form;
+	/**
+	 * Members (csSparse) or lo, hi pairs (csRuns)
+	 */
+	std::vector<int> Elements;
+	/**
+	 * Bitset (csDense)
+	 */
+	std::vector<ClusterWord> Bits;
+
+	/**
+	 * Store the set given by its runs in the smallest form.
+	 */
+	virtual void AssignRuns (const std::vector<int> &runs, int size);
+	static int Operate (const ClusterSet &a, const ClusterSet &b, int op, ClusterSet *result);
+};
+
+#endif
@@ -0,0 +1,386 @@
+#include "compatibility.h"
+
+// NCL includes
+#include "nexusdefs.h"
+#include "xnexus.h"
+#include "nexustoken.h"
+#include "nexus.h"
+#include "taxablock.h"
+#include "assumptionsblock.h"
+#include "discretedatum.h"
+#include "discretematrix.h"
+#include "charactersblock.h"
+
+#include "charstore.h"
+
+#include <cstdio>
+
+// Bytes of character columns in each block of pairs (two blocks of columns
+// should fit in the level 2 cache)
+#define COMPATIBILITY_BLOCK_BYTES 131072
+
+//------------------------------------------------------------------------------
+static int PopCount (CompatibilityWord w)
+{
+#ifdef __GNUC__
+	return __builtin_popcountll (w);
+#else
+	int n = 0;
+	while (w)
+	{
+		w &= w - 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+//------------------------------------------------------------------------------
+CharacterCompatibility::CharacterCompatibility (int numTaxa)
+{
+	NumTaxa = numTaxa;
+	Words = (numTaxa + 63) / 64;
+	if (Words == 0)
+		Words = 1;
+	MatrixWords = 0;
+}
+
+//------------------------------------------------------------------------------
+void CharacterCompatibility::AddCharacter (const std::vector<int> &states, const std::string &name)
+{
+	int j = (int)Names.size();
+	Bits.resize (Bits.size() + 2 * Words, 0);
+	CompatibilityWord *zero = &Bits[2 * j * Words];
+	CompatibilityWord *one = zero + Words;
+	for (int x = 0; (x < (int)states.size()) && (x < NumTaxa); x++)
+	{
+		if (states[x] == 0)
+			zero[x / 64] |= (CompatibilityWord)1 << (x % 64);
+		else if (states[x] == 1)
+			one[x / 64] |= (CompatibilityWord)1 << (x % 64);
+	}
+	Names.push_back (name);
+}
+
+//------------------------------------------------------------------------------
+int CharacterCompatibility::AddCharacters (CharactersBlock &c, const std::map<std::string, int> &taxonIndex)
+{
+	// Profile index of each row of the matrix
+	std::vector<int> taxon (c.GetNTax(), -1);
+	for (int i = 0; i < c.GetNTax(); i++)
+	{
+		if (c.IsDeleted (i))
+			continue;
+		std::map<std::string, int>::const_iterator there = taxonIndex.find (c.GetTaxonLabel (c.GetOrigTaxonIndex (i)));
+		if (there != taxonIndex.end())
+			taxon[i] = there->second;
+	}
+
+	int skipped = 0;
+	std::vector<int> states;
+	for (int j = 0; j < c.GetNChar(); j++)
+	{
+		if (c.IsExcluded (j))
+			continue;
+		// Code the lower of the two states as 0
+		int low = -1, high = -1;
+		bool binary = true;
+		states.assign (NumTaxa, -1);
+		for (int i = 0; (i < c.GetNTax()) && binary; i++)
+		{
+			if ((taxon[i] == -1) || c.IsMissingState (i, j) || c.IsGapState (i, j) || c.IsPolymorphic (i, j))
+				continue;
+			int s = c.GetInternalRepresentation (i, j);
+			states[taxon[i]] = s;
+			if ((s == low) || (s == high))
+				continue;
+			if (low == -1)
+				low = s;
+			else if (high == -1)
+				high = s;
+			else
+				binary = false;
+		}
+		if (!binary)
+		{
+			skipped++;
+			continue;
+		}
+		if ((high != -1) && (high < low))
+		{
+			int tmp = low;
+			low = high;
+			high = tmp;
+		}
+		for (int x = 0; x < NumTaxa; x++)
+			if (states[x] != -1)
+				states[x] = (states[x] == low) ? 0 : 1;
+
+		char name[32];
+		sprintf (name, "%d", c.GetOrigCharNumber (j));
+		std::string label = c.GetCharLabel (c.GetOrigCharIndex (j));
+		AddCharacter (states, (label != "" && label != " ") ? label : std::string (name));
+	}
+	return skipped;
+}
+
+//------------------------------------------------------------------------------
+int CharacterCompatibility::AddCharacters (const CharacterStore &c, const std::map<std::string, int> &taxonIndex)
+{
+	std::vector<int> taxon (c.GetNumTaxa(), -1);
+	for (int i = 0; i < c.GetNumTaxa(); i++)
+	{
+		if (!c.IsActiveTaxon (i))
+			continue;
+		std::map<std::string, int>::const_iterator there = taxonIndex.find (c.GetTaxonLabel (i));
+		if (there != taxonIndex.end())
+			taxon[i] = there->second;
+	}
+
+	int skipped = 0;
+	std::vector<int> states;
+	for (int j = 0; j < c.GetNumCharacters(); j++)
+	{
+		if (!c.IsActiveChar (j))
+			continue;
+		// As for a CHARACTERS block, read from the column in place
+		StateView column = c.GetColumn (j);
+		int low = -1, high = -1;
+		bool binary = true;
+		states.assign (NumTaxa, -1);
+		for (int i = 0; (i < c.GetNumTaxa()) && binary; i++)
+		{
+			StateMask m = column[i];
+			if ((taxon[i] == -1) || (m & (csMissing | csGap | csPolymorphic)))
+				continue;
+			int s = CharacterStore::FirstState (m);
+			states[taxon[i]] = s;
+			if ((s == low) || (s == high))
+				continue;
+			if (low == -1)
+				low = s;
+			else if (high == -1)
+				high = s;
+			else
+				binary = false;
+		}
+		if (!binary)
+		{
+			skipped++;
+			continue;
+		}
+		if ((high != -1) && (high < low))
+		{
+			int tmp = low;
+			low = high;
+			high = tmp;
+		}
+		for (int x = 0; x < NumTaxa; x++)
+			if (states[x] != -1)
+				states[x] = (states[x] == low) ? 0 : 1;
+
+		char name[32];
+		sprintf (name, "%d", c.GetOrigCharIndex (j) + 1);
+		std::string label = c.GetCharLabel (j);
+		AddCharacter (states, (label != "") ? label : std::string (name));
+	}
+	return skipped;
+}
+
+//------------------------------------------------------------------------------
+void CharacterCompatibility::AddTree (const TreeIndex &t, int tree)
+{
+	std::vector<int> states (NumTaxa, -1);
+	std::vector<int> rank (t.GetNumLeaves());
+	for (int k = 0; k < t.GetNumLeaves(); k++)
+	{
+		rank[k] = t.GetTaxon (t.GetLeafAtRank (k));
+		if ((rank[k] >= 0) && (rank[k] < NumTaxa))
+			states[rank[k]] = 0;
+	}
+	for (int u = 0; u < t.GetNumNodes(); u++)
+	{
+		if (t.IsLeaf (u) || (u == t.GetRoot()))
+			continue;
+		std::vector<int> c (states);
+		for (int k = t.GetLeafLo (u); k <= t.GetLeafHi (u); k++)
+			if ((rank[k] >= 0) && (rank[k] < NumTaxa))
+				c[rank[k]] = 1;
+		char name[32];
+		sprintf (name, "tree%d_node%d", tree, u - t.GetNumLeaves() + 1);
+		AddCharacter (c, name);
+	}
+}
+
+//------------------------------------------------------------------------------
+// The four-gamete test: true unless the taxa with states 0 and 1 in the
+// first character (a0, a1) and in the second (b0, b1) give all four
+// combinations. Checking for an early exit costs more than a few extra
+// words, so it is only done every COMPATIBILITY_CHUNK words.
+#define COMPATIBILITY_CHUNK 8
+static inline bool FourGameteTest (const CompatibilityWord *a0, const CompatibilityWord *a1,
+	const CompatibilityWord *b0, const CompatibilityWord *b1, int words)
+{
+	CompatibilityWord s00 = 0, s01 = 0, s10 = 0, s11 = 0;
+	for (int lo = 0; lo < words; lo += COMPATIBILITY_CHUNK)
+	{
+		int hi = (lo + COMPATIBILITY_CHUNK < words) ? lo + COMPATIBILITY_CHUNK : words;
+		for (int w = lo; w < hi; w++)
+		{
+			s00 |= a0[w] & b0[w];
+			s01 |= a0[w] & b1[w];
+			s10 |= a1[w] & b0[w];
+			s11 |= a1[w] & b1[w];
+		}
+		if ((s00 != 0) & (s01 != 0) & (s10 != 0) & (s11 != 0))
+			return false;
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------
+bool CharacterCompatibility::Test (int a, int b) const
+{
+	const CompatibilityWord *a0 = &Bits[2 * a * Words];
+	const CompatibilityWord *b0 = &Bits[2 * b * Words];
+	return FourGameteTest (a0, a0 + Words, b0, b0 + Words, Words);
+}
+
+//------------------------------------------------------------------------------
+void CharacterCompatibility::Compute (bool keepMatrix)
+{
+	int n = GetNumCharacters ();
+	Compatible.assign (n, 0);
+	Matrix.clear ();
+	MatrixWords = 0;
+	if (keepMatrix)
+	{
+		MatrixWords = (n + 63) / 64;
+		Matrix.assign ((size_t)n * MatrixWords, 0);
+	}
+	int block = COMPATIBILITY_BLOCK_BYTES / (int)(2 * Words * sizeof (CompatibilityWord));
+	if (block < 16)
+		block = 16;
+	int nblocks = (n + block - 1) / block;
+	const CompatibilityWord *bits = Bits.empty() ? NULL : &Bits[0];
+	int words = Words;
+
+	// Each thread takes whole rows of blocks, so sets bits only in its own
+	// rows of the matrix, and counts into its own array
+#ifdef _OPENMP
+	#pragma omp parallel
+#endif
+	{
+		std::vector<int> count (n, 0);
+#ifdef _OPENMP
+		#pragma omp for schedule(dynamic)
+#endif
+		for (int bi = 0; bi < nblocks; bi++)
+		{
+			int ilo = bi * block;
+			int ihi = (ilo + block < n) ? ilo + block : n;
+			for (int bj = bi; bj < nblocks; bj++)
+			{
+				int jlo = bj * block;
+				int jhi = (jlo + block < n) ? jlo + block : n;
+				for (int i = ilo; i < ihi; i++)
+				{
+					CompatibilityWord *row = keepMatrix ? &Matrix[(size_t)i * MatrixWords] : NULL;
+					const CompatibilityWord *a = bits + 2 * i * words;
+					for (int j = (jlo > i + 1) ? jlo : i + 1; j < jhi; j++)
+					{
+						const CompatibilityWord *b = bits + 2 * j * words;
+						if (FourGameteTest (a, a + words, b, b + words, words))
+						{
+							count[i]++;
+							count[j]++;
+							if (row)
+								row[j / 64] |= (CompatibilityWord)1 << (j % 64);
+						}
+					}
+				}
+			}
+		}
+#ifdef _OPENMP
+		#pragma omp critical
+#endif
+		for (int j = 0; j < n; j++)
+			Compatible[j] += count[j];
+	}
+
+	if (keepMatrix)
+	{
+		// Copy the upper triangle to the lower, 64 by 64 bits at a time, and
+		// set the diagonal. Rows are taken 64 at a time, and the words read
+		// for a group of rows are never written by another thread.
+		int groups = MatrixWords;
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic)
+#endif
+		for (int g = 0; g < groups; g++)
+		{
+			for (int h = 0; h <= g; h++)
+			{
+				int jhi = (64 * h + 64 < n) ? 64 * h + 64 : n;
+				for (int j = 64 * h; j < jhi; j++)
+				{
+					// Bits above the diagonal only
+					CompatibilityWord w = Matrix[(size_t)j * MatrixWords + g];
+					if (h == g)
+						w &= (j % 64 == 63) ? 0 : ~(((CompatibilityWord)2 << (j % 64)) - 1);
+					while (w)
+					{
+						int i = 64 * g + PopCount ((w & (~w + 1)) - 1);
+						Matrix[(size_t)i * MatrixWords + h] |= (CompatibilityWord)1 << (j % 64);
+						w &= w - 1;
+					}
+				}
+			}
+			int ihi = (64 * g + 64 < n) ? 64 * g + 64 : n;
+			for (int i = 64 * g; i < ihi; i++)
+				Matrix[(size_t)i * MatrixWords + g] |= (CompatibilityWord)1 << (i % 64);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+long long CharacterCompatibility::GetNumCompatiblePairs () const
+{
+	long long pairs = 0;
+	for (int j = 0; j < (int)Compatible.size(); j++)
+		pairs += Compatible[j];
+	return pairs / 2;
+}
+
+//------------------------------------------------------------------------------
+bool CharacterCompatibility::IsCompatible (int a, int b) const
+{
+	if (a == b)
+		return true;
+	if (!Matrix.empty())
+		return (Matrix[(size_t)a * MatrixWords + b / 64] >> (b % 64)) & 1;
+	return Test (a, b);
+}
+
+//------------------------------------------------------------------------------
+void CharacterCompatibility::Report (std::ostream &f) const
+{
+	int n = GetNumCharacters ();
+	for (int j = 0; j < n; j++)
+		f << j + 1 << "\t" << Names[j] << "\t" << GetNumCompatible (j) << std::endl;
+	f << "Compatible pairs\t" << GetNumCompatiblePairs () << "\tof\t" << (long long)n * (n - 1) / 2 << std::endl;
+}
+
+//------------------------------------------------------------------------------
+void CharacterCompatibility::WriteMatrix (std::ostream &f) const
+{
+	int n = GetNumCharacters ();
+	std::string line (n, '0');
+	for (int i = 0; i < n; i++)
+	{
+		const CompatibilityWord *row = &Matrix[(size_t)i * MatrixWords];
+		for (int j = 0; j < n; j++)
+			line[j] = ((row[j / 64] >> (j % 64)) & 1) ? '1' : '0';
+		f << line << std::endl;
+	}
+}
@@ -0,0 +1,147 @@
+/**
+ * @file compatibility.h
+ *
+ * Pairwise compatibility of binary characters.
+ *
+ */
+
+#ifndef COMPATIBILITYH
+#define COMPATIBILITYH
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "treeindex.h"
+
+class CharactersBlock;
+class CharacterStore;
+
+/**
+ * @var typedef unsigned long long CompatibilityWord
+ * @brief One word of a bit-packed column of the character matrix
+ */
+typedef unsigned long long CompatibilityWord;
+
+/**
+ * @class CharacterCompatibility
+ * Pairwise compatibility of binary characters, e.g. those of a
+ * morphological matrix or the matrix representation (MRP) of a set of
+ * input trees (Baum 1992, Taxon 41:3-10; Ragan 1992, Mol. Phylogenet. Evol.
+ * 1:53-58). Two binary characters are compatible if they could both have
+ * evolved on some tree without homoplasy, which is the case unless all
+ * four combinations of states (0,0), (0,1), (1,0) and (1,1) occur among
+ * the taxa scored for both (the four-gamete test). Missing data, gaps and
+ * polymorphisms are ignored.
+ *
+ * The matrix is stored by character, each as two bit sets over the taxa
+ * (those with state 0 and those with state 1), so a pair of characters is
+ * tested with a few ANDs per word of taxa, stopping as soon as all four
+ * combinations have been seen. The pairs are visited in square blocks of
+ * characters small enough for the columns of both to stay in cache, and
+ * the rows of blocks are shared between threads if compiled with OpenMP.
+ * The full matrix takes one bit per pair, so it is optional for very large
+ * numbers of characters.
+ */
+class CharacterCompatibility
+{
+public:
+	/**
+	 * @param numTaxa number of taxa in the profile
+	 */
+	CharacterCompatibility (int numTaxa);
+	virtual ~CharacterCompatibility () {};
+
+	/**
+	 * Add a character.
+	 * @param states the state (0 or 1) of each taxon, or -1 if missing
+	 * @param name a name for the character
+	 */
+	virtual void AddCharacter (const std::vector<int> &states, const std::string &name);
+	/**
+	 * Add the active binary characters of a CHARACTERS or DATA block,
+	 * ignoring deleted taxa and taxa not in the profile. Characters with
+	 * more than two states are skipped.
+	 * @param c the block
+	 * @param taxonIndex the index of each taxon label in the profile
+	 * @return the number of characters skipped
+	 */
+	virtual int AddCharacters (CharactersBlock &c, const std::map<std::string, int> &taxonIndex);
+	/**
+	 * Add the active binary characters of a CharacterStore, as above,
+	 * except that a cell with uncertain states (e.g., {01}) is taken as
+	 * its lowest state rather than the first listed.
+	 */
+	virtual int AddCharacters (const CharacterStore &c, const std::map<std::string, int> &taxonIndex);
+	/**
+	 * Add the matrix representation of a tree: one character for each
+	 * clade other than the root and the leaves, with the taxa in the clade
+	 * scored 1, the other taxa in the tree 0 and the rest missing.
+	 * @param t the tree
+	 * @param tree the number of the tree, used to name its characters
+	 */
+	virtual void AddTree (const TreeIndex &t, int tree);
+
+	/**
+	 * Test every pair of characters.
+	 * @param keepMatrix store the result for every pair, rather than just
+	 * the number of characters compatible with each
+	 */
+	virtual void Compute (bool keepMatrix = true);
+
+	int GetNumCharacters () const { return (int)Names.size(); };
+	int GetNumTaxa () const { return NumTaxa; };
+	/**
+	 * @return the number of other characters compatible with character j
+	 */
+	int GetNumCompatible (int j) const { return Compatible[j]; };
+	/**
+	 * @return the number of compatible pairs of characters
+	 */
+	long long GetNumCompatiblePairs () const;
+	/**
+	 * @return true if characters a and b are compatible, taken from the
+	 * matrix if it was kept
+	 */
+	virtual bool IsCompatible (int a, int b) const;
+
+	/**
+	 * Write one line per character: its number, name and the number of
+	 * other characters it is compatible with, followed by the number of
+	 * compatible pairs.
+	 */
+	virtual void Report (std::ostream &f) const;
+	/**
+	 * Write the matrix, one row of 0s and 1s per character. Compute must
+	 * have kept the matrix.
+	 */
+	virtual void WriteMatrix (std::ostream &f) const;
+
+protected:
+	int NumTaxa;
+	/**
+	 * Words per bit set of taxa
+	 */
+	int Words;
+	/**
+	 * For each character the taxa with state 0 followed by those with state
+	 * 1, Words words each
+	 */
+	std::vector<CompatibilityWord> Bits;
+	std::vector<std::string> Names;
+	std::vector<int> Compatible;
+	/**
+	 * Row-major bit matrix of compatible pairs, MatrixWords words per row,
+	 * or empty
+	 */
+	std::vector<CompatibilityWord> Matrix;
+	int MatrixWords;
+
+	/**
+	 * The four-gamete test on the columns of a and b.
+	 */
+	bool Test (int a, int b) const;
+};
+
+#endif
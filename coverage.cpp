@@ -0,0 +1,307 @@
+#include "coverage.h"
+
+#include <algorithm>
+
+//------------------------------------------------------------------------------
+static int PopCount (CoverageWord w)
+{
+#ifdef __GNUC__
+	return __builtin_popcountll (w);
+#else
+	int n = 0;
+	while (w)
+	{
+		w &= w - 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+//------------------------------------------------------------------------------
+static int FindRoot (std::vector<int> &parent, int i)
+{
+	while (parent[i] != i)
+	{
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+//------------------------------------------------------------------------------
+TaxonCoverage::TaxonCoverage (const TreeIndex *supertree)
+{
+	ST = supertree;
+	NumTrees = 0;
+	TaxonWords = (ST->GetNumTaxa() + 63) / 64;
+	Words = 0;
+	MinOverlap = 2;
+	NumComponents = 0;
+}
+
+//------------------------------------------------------------------------------
+void TaxonCoverage::AddTree (const TreeIndex &t)
+{
+	TreeTaxa.resize (TreeTaxa.size() + TaxonWords, 0);
+	CoverageWord *row = &TreeTaxa[NumTrees * TaxonWords];
+	for (int i = 0; i < t.GetNumLeaves(); i++)
+	{
+		int x = t.GetTaxon (i);
+		if ((x >= 0) && (x < ST->GetNumTaxa()))
+			row[x / 64] |= (CoverageWord)1 << (x % 64);
+	}
+	NumTrees++;
+}
+
+//------------------------------------------------------------------------------
+void TaxonCoverage::Finish (int minOverlap)
+{
+	MinOverlap = minOverlap;
+	int ntaxa = ST->GetNumTaxa ();
+
+	// Transpose the tree rows into taxon rows
+	Words = (NumTrees + 63) / 64;
+	Matrix.assign (ntaxa * Words, 0);
+	Frequency.assign (ntaxa, 0);
+	for (int j = 0; j < NumTrees; j++)
+	{
+		const CoverageWord *row = &TreeTaxa[j * TaxonWords];
+		for (int w = 0; w < TaxonWords; w++)
+		{
+			for (CoverageWord bits = row[w]; bits != 0; bits &= bits - 1)
+			{
+				int x = w * 64 + PopCount ((bits & (~bits + 1)) - 1);
+				Matrix[x * Words + j / 64] |= (CoverageWord)1 << (j % 64);
+				Frequency[x]++;
+			}
+		}
+	}
+
+	FindComponents ();
+	FindDistinguished ();
+}
+
+//------------------------------------------------------------------------------
+// Union-find over the trees. Pairs already in the same component are
+// skipped, so once the graph is connected little work remains.
+void TaxonCoverage::FindComponents ()
+{
+	std::vector<int> parent (NumTrees);
+	for (int j = 0; j < NumTrees; j++)
+		parent[j] = j;
+	for (int i = 0; i < NumTrees; i++)
+	{
+		const CoverageWord *a = &TreeTaxa[i * TaxonWords];
+		for (int j = i + 1; j < NumTrees; j++)
+		{
+			int ri = FindRoot (parent, i);
+			int rj = FindRoot (parent, j);
+			if (ri == rj)
+				continue;
+			const CoverageWord *b = &TreeTaxa[j * TaxonWords];
+			int shared = 0;
+			for (int w = 0; (w < TaxonWords) && (shared < MinOverlap); w++)
+				shared += PopCount (a[w] & b[w]);
+			if (shared >= MinOverlap)
+				parent[std::max (ri, rj)] = std::min (ri, rj);
+		}
+	}
+
+	// Number the components in order of their first tree
+	NumComponents = 0;
+	Component.assign (NumTrees, -1);
+	std::vector<int> number (NumTrees, -1);
+	for (int j = 0; j < NumTrees; j++)
+	{
+		int r = FindRoot (parent, j);
+		if (number[r] == -1)
+			number[r] = NumComponents++;
+		Component[j] = number[r];
+	}
+}
+
+//------------------------------------------------------------------------------
+void TaxonCoverage::FindDistinguished ()
+{
+	int n = ST->GetNumNodes ();
+	int root = ST->GetRoot ();
+	int W = Words;
+
+	// Trees with a taxon below each node
+	std::vector<CoverageWord> below (n * W, 0);
+	for (int u = 0; u < ST->GetNumLeaves(); u++)
+		std::copy (Matrix.begin() + ST->GetTaxon (u) * W, Matrix.begin() + (ST->GetTaxon (u) + 1) * W,
+			below.begin() + u * W);
+	for (int k = n - 1; k > 0; k--)
+	{
+		int u = ST->GetNodeAtPreorder (k);
+		int p = ST->GetParent (u);
+		for (int w = 0; w < W; w++)
+			below[p * W + w] |= below[u * W + w];
+	}
+
+	// Trees with taxa outside the cluster of each node (up), and trees with
+	// taxa in at least two of the components on the far side of the edge
+	// above each node (uptwo), from prefix and suffix unions over siblings
+	std::vector<CoverageWord> up (n * W, 0), uptwo (n * W, 0);
+	for (int k = 0; k < n; k++)
+	{
+		int p = ST->GetNodeAtPreorder (k);
+		if (ST->IsLeaf (p))
+			continue;
+		std::vector<int> children;
+		for (int c = ST->GetChild (p); c != -1; c = ST->GetSibling (c))
+			children.push_back (c);
+		int d = (int)children.size();
+		std::vector<CoverageWord> preAny ((d + 1) * W, 0), preTwo ((d + 1) * W, 0);
+		std::vector<CoverageWord> sufAny ((d + 1) * W, 0), sufTwo ((d + 1) * W, 0);
+		for (int i = 0; i < d; i++)
+			for (int w = 0; w < W; w++)
+			{
+				CoverageWord b = below[children[i] * W + w];
+				preTwo[(i + 1) * W + w] = preTwo[i * W + w] | (preAny[i * W + w] & b);
+				preAny[(i + 1) * W + w] = preAny[i * W + w] | b;
+			}
+		for (int i = d - 1; i >= 0; i--)
+			for (int w = 0; w < W; w++)
+			{
+				CoverageWord b = below[children[i] * W + w];
+				sufTwo[i * W + w] = sufTwo[(i + 1) * W + w] | (sufAny[(i + 1) * W + w] & b);
+				sufAny[i * W + w] = sufAny[(i + 1) * W + w] | b;
+			}
+		for (int i = 0; i < d; i++)
+		{
+			int c = children[i];
+			for (int w = 0; w < W; w++)
+			{
+				CoverageWord any = preAny[i * W + w] | sufAny[(i + 1) * W + w];
+				CoverageWord two = preTwo[i * W + w] | sufTwo[(i + 1) * W + w]
+					| (preAny[i * W + w] & sufAny[(i + 1) * W + w]);
+				if (p != root)
+				{
+					two |= any & up[p * W + w];
+					any |= up[p * W + w];
+				}
+				up[c * W + w] = any;
+				uptwo[c * W + w] = two;
+			}
+		}
+	}
+
+	// Internal edges. If the root has degree two its edges form one
+	// unrooted edge, whose far side is the other child's subtrees.
+	int merged = -1;
+	if (ST->GetDegree (root) == 2)
+		merged = ST->GetSibling (ST->GetChild (root));
+	EdgeNodes.clear ();
+	for (int u = ST->GetNumLeaves(); u < n; u++)
+	{
+		if ((u == root) || (u == merged))
+			continue;
+		if ((merged != -1) && (ST->GetParent (u) == root) && ST->IsLeaf (merged))
+			continue;
+		EdgeNodes.push_back (u);
+	}
+
+	int m = (int)EdgeNodes.size();
+	std::vector<int> found (m, 0);
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic, 64)
+#endif
+	for (int e = 0; e < m; e++)
+	{
+		int v = EdgeNodes[e];
+		int far = -1;
+		if ((merged != -1) && (ST->GetParent (v) == root))
+			far = merged;
+		for (int w = 0; (w < W) && !found[e]; w++)
+		{
+			CoverageWord any = 0, two = 0;
+			for (int c = ST->GetChild (v); c != -1; c = ST->GetSibling (c))
+			{
+				two |= any & below[c * W + w];
+				any |= below[c * W + w];
+			}
+			CoverageWord other = 0;
+			if (far == -1)
+				other = uptwo[v * W + w];
+			else
+			{
+				CoverageWord fany = 0;
+				for (int c = ST->GetChild (far); c != -1; c = ST->GetSibling (c))
+				{
+					other |= fany & below[c * W + w];
+					fany |= below[c * W + w];
+				}
+			}
+			if (two & other)
+				found[e] = 1;
+		}
+	}
+	Distinguished.assign (m, false);
+	for (int e = 0; e < m; e++)
+		Distinguished[e] = (found[e] != 0);
+}
+
+//------------------------------------------------------------------------------
+int TaxonCoverage::GetNumDistinguished () const
+{
+	int count = 0;
+	for (int e = 0; e < (int)Distinguished.size(); e++)
+		if (Distinguished[e])
+			count++;
+	return count;
+}
+
+//------------------------------------------------------------------------------
+void TaxonCoverage::Report (std::ostream &f, const std::vector<std::string> &labels) const
+{
+	int filled = 0, ntaxa = 0;
+	for (int x = 0; x < ST->GetNumTaxa(); x++)
+	{
+		if ((ST->GetLeafOfTaxon (x) == -1) && (Frequency[x] == 0))
+			continue;
+		f << labels[x] << "\t" << Frequency[x] << "\t" << (NumTrees ? (double) Frequency[x] / NumTrees : 0.0) << std::endl;
+		filled += Frequency[x];
+		ntaxa++;
+	}
+	f << "Coverage\t" << ntaxa << "\t" << NumTrees << "\t"
+		<< ((NumTrees && ntaxa) ? (double) filled / ((double) NumTrees * ntaxa) : 0.0) << std::endl;
+
+	f << "Overlap components\t" << MinOverlap << "\t" << NumComponents << std::endl;
+	if (NumComponents > 1)
+	{
+		for (int c = 0; c < NumComponents; c++)
+		{
+			f << "Component " << c + 1 << "\t";
+			for (int j = 0, cnt = 0; j < NumTrees; j++)
+			{
+				if (Component[j] == c)
+				{
+					if (cnt++ > 0)
+						f << ",";
+					f << j + 1;
+				}
+			}
+			f << std::endl;
+		}
+	}
+
+	f << "Distinguished edges\t" << GetNumDistinguished () << "\t" << GetNumEdges ()
+		<< "\t" << (IsDecisive () ? "decisive" : "not decisive") << std::endl;
+	for (int e = 0; e < GetNumEdges(); e++)
+	{
+		if (Distinguished[e])
+			continue;
+		int u = EdgeNodes[e];
+		f << "(";
+		for (int k = ST->GetLeafLo (u); k <= ST->GetLeafHi (u); k++)
+		{
+			if (k != ST->GetLeafLo (u))
+				f << ",";
+			f << labels[ST->GetTaxon (ST->GetLeafAtRank (k))];
+		}
+		f << ")\tnot distinguished" << std::endl;
+	}
+}
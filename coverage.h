@@ -0,0 +1,127 @@
+/**
+ * @file coverage.h
+ *
+ * Taxon coverage of the input trees, taxonomic overlap and phylogenetic
+ * decisiveness.
+ *
+ */
+
+#ifndef COVERAGEH
+#define COVERAGEH
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "treeindex.h"
+
+/**
+ * @var typedef unsigned long long CoverageWord
+ * @brief One word of a bit-packed row of the coverage matrix
+ */
+typedef unsigned long long CoverageWord;
+
+/**
+ * @class TaxonCoverage
+ * Bit-packed taxon by tree matrix recording which input trees contain
+ * each taxon, and analyses based on it:
+ *
+ * - the number of input trees containing each taxon;
+ *
+ * - the connected components of the taxonomic overlap graph, whose
+ * vertices are the input trees, two trees being joined if they share at
+ * least a given number of taxa (Sanderson et al. 1998, Trends Ecol.
+ * Evol. 13:105-109);
+ *
+ * - whether the coverage pattern is decisive for the supertree, i.e.
+ * whether every internal edge of the supertree (taken as unrooted) is
+ * distinguished by some input tree (Steel and Sanderson 2010, Appl. Math.
+ * Lett. 23:82-86). An edge is distinguished if an input tree has taxa in
+ * two of the subtrees on one side of the edge and two of the subtrees on
+ * the other, i.e. covers a quartet that resolves the edge. For each
+ * supertree node the set of trees with a taxon below it is the union of
+ * the sets for its children, so each edge is checked with a few bitwise
+ * operations per word of trees. The edges are checked in parallel if
+ * compiled with OpenMP.
+ */
+class TaxonCoverage
+{
+public:
+	/**
+	 * @param supertree the indexed supertree
+	 */
+	TaxonCoverage (const TreeIndex *supertree);
+	virtual ~TaxonCoverage () {};
+
+	/**
+	 * Record the taxa of an input tree.
+	 */
+	virtual void AddTree (const TreeIndex &t);
+	/**
+	 * Build the matrix and run the analyses. Call once after all trees have
+	 * been added.
+	 * @param minOverlap the number of taxa two trees must share to be
+	 * joined in the overlap graph
+	 */
+	virtual void Finish (int minOverlap);
+
+	int GetNumTrees () const { return NumTrees; };
+	/**
+	 * @return true if input tree j contains taxon x
+	 */
+	bool Covers (int x, int j) const { return (Matrix[x * Words + j / 64] >> (j % 64)) & 1; };
+	/**
+	 * @return the number of input trees containing taxon x
+	 */
+	int GetFrequency (int x) const { return Frequency[x]; };
+	int GetNumComponents () const { return NumComponents; };
+	/**
+	 * @return the component of the overlap graph containing tree j
+	 */
+	int GetComponent (int j) const { return Component[j]; };
+	int GetNumEdges () const { return (int)EdgeNodes.size(); };
+	int GetNumDistinguished () const;
+	/**
+	 * @return true if the supertree is the only tree displaying all its
+	 * restrictions to the input taxon sets, as far as the coverage goes
+	 */
+	bool IsDecisive () const { return GetNumDistinguished () == GetNumEdges (); };
+
+	/**
+	 * Write the number of trees containing each taxon, the overall
+	 * coverage, the components of the overlap graph, and the internal
+	 * edges of the supertree that no input tree distinguishes.
+	 * @param f output stream
+	 * @param labels taxon labels, indexed by taxon
+	 */
+	virtual void Report (std::ostream &f, const std::vector<std::string> &labels) const;
+
+protected:
+	const TreeIndex *ST;
+	int NumTrees;
+	int TaxonWords;
+	int Words;
+	int MinOverlap;
+	/**
+	 * Taxa of each input tree, TaxonWords words per tree
+	 */
+	std::vector<CoverageWord> TreeTaxa;
+	/**
+	 * The coverage matrix, Words words (one bit per tree) per taxon
+	 */
+	std::vector<CoverageWord> Matrix;
+	std::vector<int> Frequency;
+	int NumComponents;
+	std::vector<int> Component;
+	/**
+	 * Internal edges of the supertree (identified by the node below), and
+	 * whether each is distinguished
+	 */
+	std::vector<int> EdgeNodes;
+	std::vector<bool> Distinguished;
+
+	virtual void FindComponents ();
+	virtual void FindDistinguished ();
+};
+
+#endif
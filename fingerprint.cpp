@@ -0,0 +1,143 @@
+#include "fingerprint.h"
+
+//------------------------------------------------------------------------------
+// SplitMix64 generator
+static unsigned long long NextRandom (unsigned long long &state)
+{
+	unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+//------------------------------------------------------------------------------
+ClusterFingerprints::ClusterFingerprints (int numTaxa, unsigned long long seed)
+{
+	unsigned long long state = seed;
+	Keys.resize (numTaxa);
+	for (int x = 0; x < numTaxa; x++)
+	{
+		Keys[x].Hi = NextRandom (state);
+		Keys[x].Lo = NextRandom (state);
+	}
+}
+
+//------------------------------------------------------------------------------
+void ClusterFingerprints::Compute (const TreeIndex &t, std::vector<Fingerprint> &fp, const std::vector<bool> *mask) const
+{
+	int n = t.GetNumNodes ();
+	fp.assign (n, Fingerprint ());
+	for (int u = 0; u < n; u++)
+	{
+		int x = t.GetTaxon (u);
+		if (t.IsLeaf (u) && (x >= 0) && (x < GetNumTaxa()) && (!mask || (*mask)[x]))
+			fp[u] = Keys[x];
+	}
+	// Children before parents
+	for (int k = n - 1; k > 0; k--)
+	{
+		int u = t.GetNodeAtPreorder (k);
+		fp[t.GetParent (u)] ^= fp[u];
+	}
+}
+
+//------------------------------------------------------------------------------
+Fingerprint ClusterFingerprints::Of (const std::vector<int> &taxa) const
+{
+	Fingerprint f;
+	for (int i = 0; i < (int)taxa.size(); i++)
+		f ^= Keys[taxa[i]];
+	return f;
+}
+
+//------------------------------------------------------------------------------
+Fingerprint ClusterFingerprints::OfMask (const std::vector<bool> &mask) const
+{
+	Fingerprint f;
+	for (int x = 0; (x < (int)mask.size()) && (x < GetNumTaxa()); x++)
+		if (mask[x])
+			f ^= Keys[x];
+	return f;
+}
+
+//------------------------------------------------------------------------------
+FingerprintTable::FingerprintTable (bool verify)
+{
+	Verify = verify;
+	Clear ();
+}
+
+//------------------------------------------------------------------------------
+void FingerprintTable::Clear ()
+{
+	Collisions = 0;
+	Slots.assign (16, -1);
+	Fingerprints.clear ();
+	Clusters.clear ();
+	Counts.clear ();
+}
+
+//------------------------------------------------------------------------------
+int FingerprintTable::Probe (const Fingerprint &fp, const ClusterSet *cluster, bool &collision) const
+{
+	collision = false;
+	int mask = (int)Slots.size() - 1;
+	int s = (int)(fp.Lo & (unsigned long long)mask);
+	while (Slots[s] != -1)
+	{
+		int e = Slots[s];
+		if (Fingerprints[e] == fp)
+		{
+			if (!Verify || !cluster || (Clusters[e] == *cluster))
+				return s;
+			collision = true;
+		}
+		s = (s + 1) & mask;
+	}
+	return s;
+}
+
+//------------------------------------------------------------------------------
+int FingerprintTable::Find (const Fingerprint &fp, const ClusterSet *cluster) const
+{
+	bool collision;
+	return Slots[Probe (fp, cluster, collision)];
+}
+
+//------------------------------------------------------------------------------
+int FingerprintTable::Insert (const Fingerprint &fp, const ClusterSet *cluster)
+{
+	bool collision;
+	int s = Probe (fp, cluster, collision);
+	if (Slots[s] != -1)
+	{
+		Counts[Slots[s]]++;
+		return Slots[s];
+	}
+	if (collision)
+		Collisions++;
+	int e = (int)Fingerprints.size();
+	Slots[s] = e;
+	Fingerprints.push_back (fp);
+	Counts.push_back (1);
+	if (Verify)
+		Clusters.push_back (cluster ? *cluster : ClusterSet ());
+	// Keep the load factor below one half
+	if (2 * (int)Fingerprints.size() > (int)Slots.size())
+		Grow ();
+	return e;
+}
+
+//------------------------------------------------------------------------------
+void FingerprintTable::Grow ()
+{
+	Slots.assign (2 * Slots.size(), -1);
+	int mask = (int)Slots.size() - 1;
+	for (int e = 0; e < (int)Fingerprints.size(); e++)
+	{
+		int s = (int)(Fingerprints[e].Lo & (unsigned long long)mask);
+		while (Slots[s] != -1)
+			s = (s + 1) & mask;
+		Slots[s] = e;
+	}
+}
@@ -0,0 +1,158 @@
+/**
+ * @file fingerprint.h
+ *
+ * Random 128-bit fingerprints of clusters, for comparing clusters of
+ * different trees in constant time.
+ *
+ */
+
+#ifndef FINGERPRINTH
+#define FINGERPRINTH
+
+#include <vector>
+
+#include "treeindex.h"
+#include "cluster.h"
+
+/**
+ * @class Fingerprint
+ * A 128-bit fingerprint. The fingerprint of a cluster is the exclusive or
+ * of the random keys of its taxa, so the fingerprint of a node is the
+ * exclusive or of those of its children, and the fingerprint of the
+ * complement of a cluster is that of the cluster xor that of the leaf set.
+ * Two different clusters have the same fingerprint with probability
+ * 2^-128.
+ */
+class Fingerprint
+{
+public:
+	unsigned long long Hi;
+	unsigned long long Lo;
+
+	Fingerprint () { Hi = Lo = 0; };
+	Fingerprint (unsigned long long hi, unsigned long long lo) { Hi = hi; Lo = lo; };
+
+	bool IsZero () const { return (Hi == 0) && (Lo == 0); };
+	bool operator== (const Fingerprint &other) const { return (Hi == other.Hi) && (Lo == other.Lo); };
+	bool operator!= (const Fingerprint &other) const { return !(*this == other); };
+	bool operator< (const Fingerprint &other) const { return (Hi < other.Hi) || ((Hi == other.Hi) && (Lo < other.Lo)); };
+	Fingerprint &operator^= (const Fingerprint &other) { Hi ^= other.Hi; Lo ^= other.Lo; return *this; };
+	Fingerprint operator^ (const Fingerprint &other) const { Fingerprint f (*this); f ^= other; return f; };
+};
+
+/**
+ * @class ClusterFingerprints
+ * Random keys for the taxa of a profile, and the fingerprints of the
+ * clusters of indexed trees computed from them. The fingerprints of all
+ * nodes of a tree are computed in a single pass from the leaves to the
+ * root, in O(n) time.
+ *
+ * Trees can only be compared if their fingerprints use the same keys, so
+ * one ClusterFingerprints object should be shared by all the trees. The
+ * keys depend only on the seed.
+ */
+class ClusterFingerprints
+{
+public:
+	/**
+	 * @param numTaxa number of taxa in the profile
+	 * @param seed seed for the random keys
+	 */
+	ClusterFingerprints (int numTaxa, unsigned long long seed = 1);
+	virtual ~ClusterFingerprints () {};
+
+	int GetNumTaxa () const { return (int)Keys.size(); };
+	const Fingerprint &GetKey (int x) const { return Keys[x]; };
+
+	/**
+	 * Compute the fingerprint of the cluster of every node of t.
+	 * @param t the indexed tree
+	 * @param fp the fingerprint of each node, indexed by node
+	 * @param mask if not NULL, only taxa x with (*mask)[x] true are
+	 * included, giving the fingerprints of the clusters of t restricted to
+	 * that leaf set
+	 */
+	virtual void Compute (const TreeIndex &t, std::vector<Fingerprint> &fp, const std::vector<bool> *mask = NULL) const;
+	/**
+	 * @return the fingerprint of a set of taxa
+	 */
+	virtual Fingerprint Of (const std::vector<int> &taxa) const;
+	/**
+	 * @return the fingerprint of the taxa x with mask[x] true
+	 */
+	virtual Fingerprint OfMask (const std::vector<bool> &mask) const;
+
+protected:
+	std::vector<Fingerprint> Keys;
+};
+
+/**
+ * @class FingerprintTable
+ * Hash table of clusters keyed by fingerprint, with open addressing. Each
+ * entry records how many times it has been inserted.
+ *
+ * If verification is on each entry also stores its cluster, and a cluster
+ * only matches an entry if both the fingerprint and the cluster are equal,
+ * so the table is exact even if two clusters share a fingerprint. The
+ * number of such collisions is counted.
+ */
+class FingerprintTable
+{
+public:
+	/**
+	 * @param verify if true, store clusters and compare them on lookup
+	 */
+	FingerprintTable (bool verify = false);
+	virtual ~FingerprintTable () {};
+
+	virtual void Clear ();
+	/**
+	 * Find a cluster.
+	 * @param fp the fingerprint of the cluster
+	 * @param cluster the cluster, needed only if verification is on
+	 * @return the entry for the cluster, or -1 if it is not in the table
+	 */
+	virtual int Find (const Fingerprint &fp, const ClusterSet *cluster = NULL) const;
+	/**
+	 * Insert a cluster, or increment its count if it is already present.
+	 * @param fp the fingerprint of the cluster
+	 * @param cluster the cluster, needed only if verification is on
+	 * @return the entry for the cluster
+	 */
+	virtual int Insert (const Fingerprint &fp, const ClusterSet *cluster = NULL);
+
+	bool IsVerified () const { return Verify; };
+	int GetNumEntries () const { return (int)Fingerprints.size(); };
+	const Fingerprint &GetFingerprint (int e) const { return Fingerprints[e]; };
+	/**
+	 * @return the cluster of entry e (verification only)
+	 */
+	const ClusterSet &GetCluster (int e) const { return Clusters[e]; };
+	int GetCount (int e) const { return Counts[e]; };
+	/**
+	 * @return the number of distinct clusters that shared the fingerprint
+	 * of an existing entry (verification only)
+	 */
+	int GetNumCollisions () const { return Collisions; };
+
+protected:
+	bool Verify;
+	int Collisions;
+	/**
+	 * Entry in each slot, or -1. The number of slots is a power of two.
+	 */
+	std::vector<int> Slots;
+	std::vector<Fingerprint> Fingerprints;
+	std::vector<ClusterSet> Clusters;
+	std::vector<int> Counts;
+
+	/**
+	 * @return the slot holding the entry for fp (and cluster), or the
+	 * empty slot where it would go. Sets collision to true if another
+	 * entry had the same fingerprint.
+	 */
+	int Probe (const Fingerprint &fp, const ClusterSet *cluster, bool &collision) const;
+	virtual void Grow ();
+};
+
+#endif
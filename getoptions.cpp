@@ -110,6 +110,23 @@ IsReal(char *s)
   else return 0;
 }
 
+/* Position of Getopt() in the current argv, kept between calls.
+ */
+static int opt_ind   = 1;        /* init to 1 on first call  */
+static char *opt_ptr = NULL;     /* ptr to next valid switch */
+
+/* Function: ResetGetopt()
+ *
+ * Purpose:  Start parsing a new argv with Getopt(), e.g. one
+ *           built from a line of a file of commands.
+ */
+void
+ResetGetopt(void)
+{
+  opt_ind = 1;
+  opt_ptr = NULL;
+}
+
 /* Function: Getopt()
  * 
  * Purpose:  Portable command line option parsing with abbreviated
@@ -154,15 +171,13 @@ Getopt(int argc, char **argv, struct opt_s *opt, int nopts, char *usage,
   int i;
   int arglen;
   int nmatch;
-  static int optind   = 1;        /* init to 1 on first call  */
-  static char *optptr = NULL;     /* ptr to next valid switch */
   int opti;
 
   /* Check to see if we've run out of options.
    */
-  if (optind >= argc || argv[optind][0] != '-')
+  if (opt_ind >= argc || argv[opt_ind][0] != '-')
     { 
-      *ret_optind  = optind; 
+      *ret_optind  = opt_ind; 
       *ret_optarg  = NULL; 
       *ret_optname = NULL; 
       return 0; 
@@ -171,10 +186,10 @@ Getopt(int argc, char **argv, struct opt_s *opt, int nopts, char *usage,
   /* Check to see if we're being told that this is the end
    * of the options.
    */
-  if (strcmp(argv[optind], "--") == 0)
+  if (strcmp(argv[opt_ind], "--") == 0)
     { 
-      optind++;
-      *ret_optind  = optind; 
+      opt_ind++;
+      *ret_optind  = opt_ind; 
       *ret_optname = NULL;
       *ret_optarg  = NULL; 
       return 0; 
@@ -186,27 +201,27 @@ Getopt(int argc, char **argv, struct opt_s *opt, int nopts, char *usage,
    * prefix -- single letter switches can be concatenated.
    */
 				/* full option */
-  if (optptr == NULL && strncmp(argv[optind], "--", 2) == 0)
+  if (opt_ptr == NULL && strncmp(argv[opt_ind], "--", 2) == 0)
     {
-      optptr = NULL;		/* full options can't concantenate */
-      arglen = strlen(argv[optind]);
+      opt_ptr = NULL;		/* full options can't concantenate */
+      arglen = strlen(argv[opt_ind]);
       nmatch = 0;
       for (i = 0; i < nopts; i++)
 	if (opt[i].single == false &&
-	    strncmp(opt[i].name, argv[optind], arglen) == 0)
+	    strncmp(opt[i].name, argv[opt_ind], arglen) == 0)
 	  { 
 	    nmatch++;
 	    opti = i;
 	  }
       if (nmatch > 1)
       {
-      	cerr << "Option \"" << argv[optind] << "\" is ambiguous; please be more specific."
+      	cerr << "Option \"" << argv[opt_ind] << "\" is ambiguous; please be more specific."
         	<< endl << usage << endl;
         exit (0);
 		}
       if (nmatch == 0)
       {
-      	cerr << "No such option \"" << argv[optind] << "\"."
+      	cerr << "No such option \"" << argv[opt_ind] << "\"."
         	<< endl << usage << endl;
         exit(0);
   	}
@@ -217,32 +232,32 @@ Getopt(int argc, char **argv, struct opt_s *opt, int nopts, char *usage,
        */
       if (opt[opti].argtype != ARG_NONE) 
 	{
-	  if (optind+1 >= argc)
+	  if (opt_ind+1 >= argc)
       {
       	cerr << "Option " << opt[opti].name << "\" requires an argument."
         	<< endl << usage << endl;
         exit (0);
 		}
-	  *ret_optarg = argv[optind+1];
-	  optind+=2;
+	  *ret_optarg = argv[opt_ind+1];
+	  opt_ind+=2;
 	}
       else  /* ARG_NONE */
 	{
 	  *ret_optarg = NULL;
-	  optind++;
+	  opt_ind++;
 	}
     }
   else				/* else, a single letter option "-o" */
     {
 				/* find the option */
-      if (optptr == NULL) 
-	optptr = argv[optind]+1;
+      if (opt_ptr == NULL) 
+	opt_ptr = argv[opt_ind]+1;
       for (opti = -1, i = 0; i < nopts; i++)
-	if (opt[i].single == true && *optptr == opt[i].name[1])
+	if (opt[i].single == true && *opt_ptr == opt[i].name[1])
 	  { opti = i; break; }
       if (opti == -1)
       {
-      	cerr << "No such option \"" << *optptr << "\"."
+      	cerr << "No such option \"" << *opt_ptr << "\"."
         	<< endl << usage << endl;
         exit(0);
   	}
@@ -251,15 +266,15 @@ Getopt(int argc, char **argv, struct opt_s *opt, int nopts, char *usage,
 				/* set the argument, if there is one */
       if (opt[opti].argtype != ARG_NONE) 
 	{
-	  if (*(optptr+1) != '\0')   /* attached argument */
+	  if (*(opt_ptr+1) != '\0')   /* attached argument */
 	    {
-	      *ret_optarg = optptr+1;
-	      optind++;
+	      *ret_optarg = opt_ptr+1;
+	      opt_ind++;
 	    }
-	  else if (optind+1 < argc) /* unattached argument */
+	  else if (opt_ind+1 < argc) /* unattached argument */
 	    {
-	      *ret_optarg = argv[optind+1];
-	      optind+=2;	      
+	      *ret_optarg = argv[opt_ind+1];
+	      opt_ind+=2;	      
 	    }
 	  else
       {
@@ -268,17 +283,17 @@ Getopt(int argc, char **argv, struct opt_s *opt, int nopts, char *usage,
         exit(0);
   	}
 
-	  optptr = NULL;	/* can't concatenate after an argument */
+	  opt_ptr = NULL;	/* can't concatenate after an argument */
 	}
       else  /* ARG_NONE */
 	{
 	  *ret_optarg = NULL;
-	  if (*(optptr+1) != '\0')   /* concatenation */
-	    optptr++; 
+	  if (*(opt_ptr+1) != '\0')   /* concatenation */
+	    opt_ptr++; 
 	  else
 	    {
-	      optind++;                /* move to next field */
-	      optptr = NULL;
+	      opt_ind++;                /* move to next field */
+	      opt_ptr = NULL;
 	    }
 	}
 
@@ -309,7 +324,7 @@ Getopt(int argc, char **argv, struct opt_s *opt, int nopts, char *usage,
       /* ARG_STRING is always ok, no type check necessary */
     }
 
-  *ret_optind = optind;
+  *ret_optind = opt_ind;
   return 1;
 }
 
@@ -330,15 +345,15 @@ struct opt_s OPTIONS[] = {
 int
 main(int argc, char **argv)
 {
-  int   optind;
+  int   opt_ind;
   char *optarg;
   char *optname;
 
   while (Getopt(argc, argv, OPTIONS, NOPTIONS, "Usage/help here",
-		&optind, &optname, &optarg))
+		&opt_ind, &optname, &optarg))
     {
       printf("index: %d name: %s argument: %s\n",
-	     optind, optname, optarg);
+	     opt_ind, optname, optarg);
     }
 }
 
@@ -44,5 +44,7 @@ struct opt_s {
 int
 Getopt(int argc, char **argv, struct opt_s *opt, int nopts, char *usage,
        int *ret_optind, char **ret_optname, char **ret_optarg);
+void
+ResetGetopt(void);
 
 #endif
@@ -0,0 +1,208 @@
+#include "jackknife.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef _OPENMP
+	#include <omp.h>
+#endif
+
+// Number of replicates whose results are held in memory at once
+#define JACKKNIFE_BATCH 64
+
+//------------------------------------------------------------------------------
+// SplitMix64 (Steele et al. 2014), used so that each replicate has its own
+// reproducible stream of random numbers whatever thread runs it.
+static unsigned long long NextRandom (unsigned long long &state)
+{
+	unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+//------------------------------------------------------------------------------
+TaxonJackknife::TaxonJackknife (const TreeIndex *supertree, const SupportEngine *engine)
+{
+	ST = supertree;
+	Engine = engine;
+	Replicates = 100;
+	Fraction = 0.1;
+	Seed = 1;
+	NumDeleted = 0;
+}
+
+//------------------------------------------------------------------------------
+void TaxonJackknife::DrawMask (int k, std::vector<bool> &mask) const
+{
+	unsigned long long state = (unsigned long long)Seed;
+	NextRandom (state);
+	state ^= (unsigned long long)k * 0xD1B54A32D192ED03ULL;
+
+	// Partial Fisher-Yates shuffle of the supertree's leaves
+	int n = ST->GetNumLeaves ();
+	std::vector<int> leaves (n);
+	for (int i = 0; i < n; i++)
+		leaves[i] = i;
+	mask.assign (ST->GetNumTaxa(), true);
+	for (int i = 0; i < NumDeleted; i++)
+	{
+		int j = i + (int)(NextRandom (state) % (unsigned long long)(n - i));
+		std::swap (leaves[i], leaves[j]);
+		mask[ST->GetTaxon (leaves[i])] = false;
+	}
+}
+
+//------------------------------------------------------------------------------
+void TaxonJackknife::RunReplicate (int k, const std::vector<TreeIndex> &trees, SupportEngine &engine,
+	std::vector<int> &row, double &meanV) const
+{
+	std::vector<bool> mask;
+	DrawMask (k, mask);
+
+	engine.Clear ();
+	engine.SetTaxonMask (&mask);
+	for (int j = 0; j < (int)trees.size(); j++)
+		engine.AddTree (trees[j], j);
+	engine.Finish ();
+	engine.SetTaxonMask (NULL);
+
+	// Number of remaining taxa below each node
+	int n = ST->GetNumNodes ();
+	std::vector<int> kept (n, 0);
+	for (int i = n - 1; i >= 0; i--)
+	{
+		int u = ST->GetNodeAtPreorder (i);
+		if (ST->IsLeaf (u) && mask[ST->GetTaxon (u)])
+			kept[u]++;
+		if (u != ST->GetRoot())
+			kept[ST->GetParent (u)] += kept[u];
+	}
+	int total = kept[ST->GetRoot()];
+
+	// Nodes whose restricted clades coincide form paths; count each
+	// distinct clade once, at the top of its path
+	SupportSummary summary;
+	int t = engine.GetNumTrees ();
+	for (int u = ST->GetNumLeaves(); u < n; u++)
+	{
+		int *r = &row[3 * u];
+		r[0] = -1;
+		if ((u == ST->GetRoot()) || (kept[u] < 2) || (kept[u] == total))
+			continue;
+		r[0] = engine.GetCount (u, svSupport);
+		r[1] = engine.GetCount (u, svConflict);
+		r[2] = engine.GetCount (u, svPermit);
+		if (kept[u] < kept[ST->GetParent (u)])
+			summary.AddClade (r[0], r[1], r[2], engine.GetCount (u, svIrrelevant), t);
+	}
+	meanV = (summary.Clades > 0) ? summary.MeanV() : 0.0;
+}
+
+//------------------------------------------------------------------------------
+void TaxonJackknife::Compute (const std::vector<TreeIndex> &trees)
+{
+	int n = ST->GetNumNodes ();
+	NumDeleted = (int)(Fraction * ST->GetNumLeaves() + 0.5);
+	NumDeleted = std::max (0, std::min (NumDeleted, ST->GetNumLeaves()));
+
+	Survived.assign (n, 0);
+	Stable.assign (n, 0);
+	SumS.assign (n, 0.0);
+	SumQ.assign (n, 0.0);
+	SumV.assign (n, 0.0);
+	SumV2.assign (n, 0.0);
+	ReplicateV.assign (Replicates, 0.0);
+
+	std::vector< std::vector<int> > rows (JACKKNIFE_BATCH);
+	for (int first = 0; first < Replicates; first += JACKKNIFE_BATCH)
+	{
+		int batch = std::min (JACKKNIFE_BATCH, Replicates - first);
+
+#ifdef _OPENMP
+		#pragma omp parallel
+#endif
+		{
+			SupportEngine engine (ST);
+#ifdef _OPENMP
+			#pragma omp for schedule(dynamic)
+#endif
+			for (int b = 0; b < batch; b++)
+			{
+				rows[b].resize (3 * n);
+				RunReplicate (first + b, trees, engine, rows[b], ReplicateV[first + b]);
+			}
+		}
+
+		// Combine in replicate order so that the sums are reproducible
+		for (int b = 0; b < batch; b++)
+		{
+			for (int u = ST->GetNumLeaves(); u < n; u++)
+			{
+				const int *r = &rows[b][3 * u];
+				if (r[0] == -1)
+					continue;
+				double v, vplus, vminus;
+				SupportSummary::Indices (r[0], r[1], r[2], v, vplus, vminus);
+				Survived[u]++;
+				if ((r[0] > 0) == (Engine->GetCount (u, svSupport) > 0))
+					Stable[u]++;
+				SumS[u] += r[0];
+				SumQ[u] += r[1];
+				SumV[u] += v;
+				SumV2[u] += v * v;
+			}
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+void TaxonJackknife::Report (std::ostream &f, const std::vector<std::string> &labels) const
+{
+	for (int u = ST->GetNumLeaves(); u < ST->GetNumNodes(); u++)
+	{
+		if (u == ST->GetRoot())
+			continue;
+		f << "(";
+		for (int k = ST->GetLeafLo (u); k <= ST->GetLeafHi (u); k++)
+		{
+			if (k != ST->GetLeafLo (u))
+				f << ",";
+			f << labels[ST->GetTaxon (ST->GetLeafAtRank (k))];
+		}
+		f << ")";
+
+		double v, vplus, vminus;
+		SupportSummary::Indices (Engine->GetCount (u, svSupport), Engine->GetCount (u, svConflict),
+			Engine->GetCount (u, svPermit), v, vplus, vminus);
+		f << "\t" << v << "\t" << Survived[u];
+		if (Survived[u] > 0)
+		{
+			double mean = SumV[u] / Survived[u];
+			double var = SumV2[u] / Survived[u] - mean * mean;
+			f << "\t" << SumS[u] / Survived[u] << "\t" << SumQ[u] / Survived[u]
+				<< "\t" << mean << "\t" << sqrt (std::max (var, 0.0))
+				<< "\t" << GetStability (u);
+		}
+		else
+			f << "\t-\t-\t-\t-\t-";
+		f << std::endl;
+	}
+
+	double sum = 0.0, sum2 = 0.0, lo = 1.0, hi = -1.0;
+	for (int k = 0; k < Replicates; k++)
+	{
+		sum += ReplicateV[k];
+		sum2 += ReplicateV[k] * ReplicateV[k];
+		lo = std::min (lo, ReplicateV[k]);
+		hi = std::max (hi, ReplicateV[k]);
+	}
+	f << "Replicates\t" << Replicates << "\tDeleted\t" << NumDeleted;
+	if (Replicates > 0)
+	{
+		double mean = sum / Replicates;
+		f << "\tmeanV\t" << mean << " (" << lo << "," << hi << ")"
+			<< "\tsd\t" << sqrt (std::max (sum2 / Replicates - mean * mean, 0.0));
+	}
+	f << std::endl;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file jackknife.h
+ *
+ * Stability of supertree clade support under random deletion of taxa.
+ *
+ */
+
+#ifndef JACKKNIFEH
+#define JACKKNIFEH
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "treeindex.h"
+#include "support.h"
+
+/**
+ * @class TaxonJackknife
+ * Repeatedly deletes a random fraction of the taxa from the supertree and
+ * from every input tree, and recomputes the support for each supertree
+ * clade that survives (i.e., still has at least two taxa and is not the
+ * whole restricted tree).
+ *
+ * Deletion is done with SupportEngine::SetTaxonMask, so no trees are
+ * rebuilt: each replicate costs one pass of the engine over the input
+ * trees, using the induced subtree of the remaining taxa.
+ *
+ * Replicate k draws its taxa from a generator seeded with (seed, k) alone,
+ * and the results are combined in replicate order, so the output does
+ * not depend on the number of threads. If compiled with OpenMP the
+ * replicates are shared between threads, each with its own engine.
+ */
+class TaxonJackknife
+{
+public:
+	/**
+	 * @param supertree the indexed supertree. BuildLCA must have been called.
+	 * @param engine the engine holding the counts for the complete data
+	 */
+	TaxonJackknife (const TreeIndex *supertree, const SupportEngine *engine);
+	virtual ~TaxonJackknife () {};
+
+	virtual void SetReplicates (int n) { Replicates = n; };
+	/**
+	 * @param f fraction of the supertree taxa to delete in each replicate
+	 */
+	virtual void SetFraction (double f) { Fraction = f; };
+	virtual void SetSeed (unsigned long s) { Seed = s; };
+
+	/**
+	 * Run the replicates.
+	 * @param trees the indexed input trees
+	 */
+	virtual void Compute (const std::vector<TreeIndex> &trees);
+
+	/**
+	 * Write one line per supertree clade: the clade, V for the complete
+	 * data, the number of replicates in which it survived, the mean S and
+	 * Q, the mean and standard deviation of V, and the support stability
+	 * (the fraction of surviving replicates in which the clade is supported
+	 * by at least one input tree if and only if it is with the complete
+	 * data). A final line gives the distribution of the mean V of the
+	 * supertree over replicates.
+	 * @param f output stream
+	 * @param labels taxon labels, indexed by taxon
+	 */
+	virtual void Report (std::ostream &f, const std::vector<std::string> &labels) const;
+
+	int GetNumDeleted () const { return NumDeleted; };
+	int GetSurvived (int node) const { return Survived[node]; };
+	double GetMeanV (int node) const { return Survived[node] ? SumV[node] / Survived[node] : 0.0; };
+	double GetStability (int node) const { return Survived[node] ? double (Stable[node]) / Survived[node] : 0.0; };
+
+protected:
+	const TreeIndex *ST;
+	const SupportEngine *Engine;
+	int Replicates;
+	double Fraction;
+	unsigned long Seed;
+	int NumDeleted;
+
+	// Totals for each supertree node over the replicates in which it survived
+	std::vector<int> Survived;
+	std::vector<int> Stable;
+	std::vector<double> SumS;
+	std::vector<double> SumQ;
+	std::vector<double> SumV;
+	std::vector<double> SumV2;
+	// Mean V of the restricted supertree in each replicate
+	std::vector<double> ReplicateV;
+
+	/**
+	 * Choose the taxa kept in replicate k.
+	 */
+	virtual void DrawMask (int k, std::vector<bool> &mask) const;
+	/**
+	 * Run replicate k and record S, Q and P for every supertree node
+	 * (S = -1 if the clade did not survive), and the mean V of the
+	 * distinct restricted clades.
+	 */
+	virtual void RunReplicate (int k, const std::vector<TreeIndex> &trees, SupportEngine &engine,
+		std::vector<int> &row, double &meanV) const;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include "labelsupport.h"
+
+#include <cstdlib>
+
+//------------------------------------------------------------------------------
+double LabelSupport::Parse (const std::string &s)
+{
+	const char *q = s.c_str();
+	char *end;
+	double x = strtod (q, &end);
+	if ((end == q) || (x < 0.0) || !((*end == '\0') || (*end == '/')))
+		return -1.0;
+	return x;
+}
+
+//------------------------------------------------------------------------------
+void LabelSupport::Read (Tree &t)
+{
+	int n = t.GetNumNodes ();
+	Value.assign (n, -1.0);
+	NumValues = 0;
+	bool percent = false;
+	for (int i = 0; i < n; i++)
+	{
+		NodePtr p = t[i];
+		if (p->IsLeaf() || (p == t.GetRoot()))
+			continue;
+		Value[i] = Parse (p->GetLabel());
+		if (Value[i] >= 0.0)
+			NumValues++;
+		if (Value[i] > 1.0)
+			percent = true;
+	}
+	if (percent)
+		for (int i = 0; i < n; i++)
+			if (Value[i] >= 0.0)
+				Value[i] /= 100.0;
+}
+
+//------------------------------------------------------------------------------
+int LabelSupport::Collapse (TreeIndex &t, double threshold)
+{
+	int n = t.GetNumNodes ();
+	Remove.assign (n, false);
+	int removed = 0;
+	for (int i = 0; i < n; i++)
+	{
+		if (!t.IsLeaf (i) && (i != t.GetRoot()) && (Value[i] >= 0.0) && (Value[i] < threshold))
+		{
+			Remove[i] = true;
+			removed++;
+		}
+	}
+	if (removed == 0)
+		return 0;
+
+	t.Contract (Remove, Map);
+	std::vector<double> value (t.GetNumNodes(), -1.0);
+	NumValues = 0;
+	for (int i = 0; i < n; i++)
+	{
+		if (Map[i] != -1)
+		{
+			value[Map[i]] = Value[i];
+			if (Value[i] >= 0.0)
+				NumValues++;
+		}
+	}
+	Value.swap (value);
+	return removed;
+}
+
+//------------------------------------------------------------------------------
+int LabelSupport::Reroot (TreeIndex &t, const std::vector<bool> &outgroup)
+{
+	int result = t.Reroot (outgroup, Map);
+	if (result != rrRerooted)
+		return result;
+	std::vector<double> value (t.GetNumNodes(), -1.0);
+	NumValues = 0;
+	for (int i = 0; i < t.GetNumNodes(); i++)
+	{
+		if (Map[i] != -1)
+		{
+			value[i] = Value[Map[i]];
+			if (value[i] >= 0.0)
+				NumValues++;
+		}
+	}
+	Value.swap (value);
+	return result;
+}
+
+//------------------------------------------------------------------------------
+void LabelSupport::GetWeights (std::vector<double> &w) const
+{
+	w.resize (Value.size());
+	for (int i = 0; i < (int)Value.size(); i++)
+		w[i] = (Value[i] >= 0.0) ? Value[i] : 1.0;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file labelsupport.h
+ *
+ * Support values (bootstrap proportions or posterior probabilities) read
+ * from the internal node labels of input trees.
+ *
+ */
+
+#ifndef LABELSUPPORTH
+#define LABELSUPPORTH
+
+#include <string>
+#include <vector>
+
+#include "TreeLib.h"
+#include "treeindex.h"
+
+/**
+ * @class LabelSupport
+ * The support values of the internal nodes of one input tree, parsed
+ * once from the labels that Tree::Parse stores for them, and indexed like
+ * the TreeIndex built from the same tree.
+ *
+ * A label is a value if it starts with a non-negative number, which must
+ * either be the whole label or be followed by '/' (as in "95/0.99", where
+ * the first value is taken). Other labels are taken as names and the node
+ * has no value. Values are scaled to lie between 0 and 1: if any value in
+ * a tree exceeds 1 they are all taken as percentages, so thresholds and
+ * weights mean the same for bootstrap and posterior values.
+ */
+class LabelSupport
+{
+public:
+	LabelSupport () { NumValues = 0; };
+	virtual ~LabelSupport () {};
+
+	/**
+	 * Read the values of the internal nodes of t, whose node list must have
+	 * been made.
+	 */
+	virtual void Read (Tree &t);
+	/**
+	 * Contract the edges above the internal nodes of t, other than the
+	 * root, whose value is below threshold, removing their clusters. Nodes
+	 * without a value are kept. The values follow the remaining nodes to
+	 * their new indices. Call before t.BuildLCA.
+	 * @param t the index of the tree that was read
+	 * @return the number of nodes removed
+	 */
+	virtual int Collapse (TreeIndex &t, double threshold);
+	/**
+	 * Root t on the edge separating an outgroup, as TreeIndex::Reroot, with
+	 * each value following its edge. Call before Collapse.
+	 * @param t the index of the tree that was read
+	 * @param outgroup true for each taxon in the outgroup
+	 * @return rrRerooted, rrMissing or rrNotMonophyletic
+	 */
+	virtual int Reroot (TreeIndex &t, const std::vector<bool> &outgroup);
+	/**
+	 * Weight of each node, as passed to SupportEngine::AddTree: its value,
+	 * or 1 if it has none.
+	 */
+	virtual void GetWeights (std::vector<double> &w) const;
+
+	/**
+	 * @return the number of nodes with a value
+	 */
+	int GetNumValues () const { return NumValues; };
+	bool HasValue (int i) const { return Value[i] >= 0.0; };
+	double GetValue (int i) const { return Value[i]; };
+
+	/**
+	 * @return the value of a label, or -1 if it has none
+	 */
+	static double Parse (const std::string &s);
+
+protected:
+	int NumValues;
+	/**
+	 * Value of each node, or -1
+	 */
+	std::vector<double> Value;
+	std::vector<bool> Remove;
+	std::vector<int> Map;
+};
+
+#endif
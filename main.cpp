@@ -14,6 +14,21 @@
 #include "profile.h"
 #include "nodeiterator.h"
 #include "quartet.h"
+#include "treeindex.h"
+#include "support.h"
+#include "rootings.h"
+#include "jackknife.h"
+#include "mast.h"
+#include "transfer.h"
+#include "reconcile.h"
+#include "coverage.h"
+#include "compatibility.h"
+#include "nj.h"
+#include "supertree.h"
+#include "treefileindex.h"
+#include "labelsupport.h"
+#include "charstore.h"
+#include "prune.h"
 
 //addede JAC 18/03/04 for Support
 #include <iterator>
@@ -22,6 +37,8 @@
 #include <fstream>
 #include <algorithm>
 #include <numeric>
+#include <map>
+#include <cctype>
 
 #ifdef __GNUC__
 	#include <strstream>
@@ -60,6 +77,41 @@
 static struct opt_s OPTIONS[] = {
 
 	{ "-b", true, ARG_INT },
+	{ "-r", true, ARG_STRING },
+	{ "-j", true, ARG_STRING },
+	{ "-w", true, ARG_STRING },
+	{ "-d", true, ARG_STRING },
+	{ "-c", true, ARG_NONE },
+	{ "-m", true, ARG_STRING },
+	{ "-g", true, ARG_STRING },
+	{ "-t", true, ARG_STRING },
+	{ "--overlap", false, ARG_INT },
+	{ "--replicates", false, ARG_INT },
+	{ "--delete", false, ARG_FLOAT },
+	{ "--seed", false, ARG_INT },
+	{ "--index", false, ARG_NONE },
+	{ "--trees", false, ARG_STRING },
+	{ "--batch", false, ARG_STRING },
+	{ "--compatibility", false, ARG_STRING },
+	{ "--matrix", false, ARG_STRING },
+	{ "--nj", false, ARG_STRING },
+	{ "--bionj", false, ARG_STRING },
+	{ "--mrminus", false, ARG_STRING },
+	{ "--mrplus", false, ARG_STRING },
+	{ "--greedy", false, ARG_STRING },
+	{ "--rank", false, ARG_STRING },
+	{ "--scalar", false, ARG_NONE },
+	{ "--benchmark", false, ARG_NONE },
+	{ "--collapse", false, ARG_FLOAT },
+	{ "--weight", false, ARG_NONE },
+	{ "--charstore", false, ARG_STRING },
+	{ "--characters", false, ARG_STRING },
+	{ "--transfer", false, ARG_STRING },
+	{ "--outgroup", false, ARG_STRING },
+	{ "--prune", false, ARG_STRING },
+	{ "--keep", false, ARG_STRING },
+	{ "--taxset", false, ARG_STRING },
+	{ "--mintaxa", false, ARG_INT },
 	{ "-v", true, ARG_NONE },
 };
 
@@ -70,6 +122,71 @@ static char usage[] = "Usage: stsupport [-options] <tree-file> <outfile>\n\
   Available options: \n\
      -v             show version information\n\
      -b n           set verbosity level\n\
+     -r file        treat the supertree as unrooted and write statistics\n\
+                    for every rooting to file\n\
+     -j file        taxon jackknife: write the stability of each clade's\n\
+                    support to file\n\
+     --replicates n number of jackknife replicates (default 100)\n\
+     --delete x     fraction of taxa deleted in each replicate (default 0.1)\n\
+     --seed n       seed for the jackknife replicates (default 1)\n\
+     -w file        write a witness triplet for each conflict to file\n\
+     -d file        write which input trees the supertree displays to file\n\
+     -c             add input clade retention columns to the output\n\
+     -m file        write the maximum agreement subtree of the supertree\n\
+                    and each input tree to file\n\
+     -g file        reconcile the input trees (as gene trees) with the\n\
+                    supertree and write duplications and losses to file\n\
+     -t file        write taxon coverage, overlap and decisiveness to file\n\
+     --overlap n    taxa two trees must share to overlap (default 2)\n\
+     --index        write an index of the trees in <tree-file> to\n\
+                    <tree-file>.idx and stop (no <outfile> needed)\n\
+     --trees list   use only the listed input trees (e.g. 1-100,250),\n\
+                    read via the index, which is built if need be\n\
+     --batch file   run each analysis listed in the manifest file, one\n\
+                    command line per line (no <tree-file> or <outfile>)\n\
+     --compatibility file\n\
+                    write the number of binary characters compatible with\n\
+                    each to file, using the CHARACTERS block if there is\n\
+                    one, otherwise the MRP coding of the input trees\n\
+     --matrix file  also write the compatibility matrix to file\n\
+     --nj file      write the neighbour-joining tree for the DISTANCES\n\
+                    block in <tree-file> to file and stop (no <outfile>)\n\
+     --bionj file   as --nj, but build a BIONJ tree\n\
+     --mrminus file write the MR(-) supertree of all the trees in\n\
+                    <tree-file>, followed by those trees, to file and stop\n\
+                    (no <outfile>)\n\
+     --mrplus file  as --mrminus, but build the MR(+) supertree\n\
+     --greedy file  as --mrminus, but build the greedy supertree of the\n\
+                    input clusters, and write those rejected to file.rejected\n\
+     --rank v|sq    order the clusters for --greedy by V (default) or S-Q\n\
+     --scalar       classify every input tree on its own, rather than small\n\
+                    trees in blocks of 64 (same results, for timing)\n\
+     --benchmark    also time classifying the input trees one at a time with\n\
+                    the kernel compiled for the options used against the\n\
+                    generic one, which tests them for every clade\n\
+     --collapse x   collapse input clades whose support (the internal node\n\
+                    label, as a proportion) is below x before classifying\n\
+     --weight       weight S and Q by the support of the input clades\n\
+     --charstore file\n\
+                    write the CHARACTERS block of <tree-file> to file as a\n\
+                    binary store, time loading it against parsing the\n\
+                    NEXUS file, and stop (no <outfile> needed)\n\
+     --characters file\n\
+                    use the binary store in file for --compatibility\n\
+     --transfer file\n\
+                    write the transfer support index of each clade (the\n\
+                    taxa to move for it to match an input clade) to file\n\
+     --outgroup list\n\
+                    root each input tree on the edge separating the taxa\n\
+                    in list (e.g. a,b,c, or @file to read them from file)\n\
+                    from the rest, reporting trees where it can't be done\n\
+     --prune file   restrict every tree in <tree-file> to the taxa given by\n\
+                    --keep or --taxset, reading and writing one tree at a\n\
+                    time, write them to file and stop (no <outfile>)\n\
+     --keep list    taxa kept by --prune (e.g. a,b,c, or @file)\n\
+     --taxset name  keep the taxa in a TAXSET of the ASSUMPTIONS block\n\
+     --mintaxa n    drop pruned trees with fewer than n taxa (default 2,\n\
+                    the least allowed)\n\
    	 ";
 
 
@@ -80,6 +197,90 @@ static char usage[] = "Usage: stsupport [-options] <tree-file> <outfile>\n\
 bool bAll				= false; //Invesigates all splits, not just on the STree
 bool bVerbose			= false; // Write Verbose junk to cout
 
+/**
+ * @class SupportOptions
+ * Settings for one analysis, taken from the command line or from one line
+ * of a batch manifest.
+ */
+class SupportOptions
+{
+public:
+	bool bAllRootings;		// Score every rooting of the supertree
+	bool bJackknife;		// Taxon jackknife of clade support
+	bool bWitnesses;		// Explain each conflict with a triplet
+	bool bDisplayed;		// Report the input trees displayed by the supertree
+	bool bRetention;		// Classify the input clades against the supertree
+	bool bMast;				// Maximum agreement subtree with each input tree
+	bool bTransfer;			// Transfer support index of each clade
+	bool bOutgroup;			// Root the input trees on an outgroup
+	bool bPrune;			// Just restrict the trees to some taxa
+	bool bTaxSet;			// ... those of a TAXSET rather than a list
+	bool bReconcile;		// Gene tree/species tree reconciliation
+	bool bCoverage;			// Taxon coverage and decisiveness
+	bool bCompatibility;	// Pairwise character compatibility
+	bool bMatrix;			// ... and the full compatibility matrix
+	bool bNJ;				// Just build a tree from the distances
+	bool bBIONJ;			// ... using BIONJ
+	bool bMR;				// Just build a majority-rule supertree
+	bool bMRPlus;			// ... the MR(+) rather than MR(-) one
+	bool bGreedy;			// Just build a greedy supertree
+	int greedyOrder;		// ... ranking the clusters by V or S - Q
+	bool bScalar;			// No bit-sliced blocks of small trees
+	bool bBenchmark;		// Time the classification kernels
+	bool bCollapse;			// Collapse poorly supported input clades
+	double collapseThreshold;	// ... those with support below this
+	bool bWeight;			// Weight S and Q by input clade support
+	bool bCharStore;		// Just convert the characters to a binary store
+	bool bCharFile;			// Read the characters from a binary store
+	bool bIndexOnly;		// Just index the tree file
+	bool bTreeList;			// Read selected input trees using the index
+	bool bBatch;			// Run the analyses listed in a manifest
+	int support_verbose;
+	int jackknifeReplicates;
+	double jackknifeFraction;
+	unsigned long jackknifeSeed;
+	int minOverlap;
+	int minTaxa;
+	char fname[FILENAME_SIZE];
+	char ofname[FILENAME_SIZE];
+	char rootingsfname[FILENAME_SIZE];
+	char jackknifefname[FILENAME_SIZE];
+	char witnessfname[FILENAME_SIZE];
+	char displayfname[FILENAME_SIZE];
+	char mastfname[FILENAME_SIZE];
+	char transferfname[FILENAME_SIZE];
+	string outgroup;
+	char prunefname[FILENAME_SIZE];
+	string keep;
+	char reconcilefname[FILENAME_SIZE];
+	char coveragefname[FILENAME_SIZE];
+	char compatibilityfname[FILENAME_SIZE];
+	char matrixfname[FILENAME_SIZE];
+	char njfname[FILENAME_SIZE];
+	char supertreefname[FILENAME_SIZE];
+	string treelist;
+	char manifestfname[FILENAME_SIZE];
+	char charstorefname[FILENAME_SIZE];
+
+	SupportOptions ()
+	{
+		bAllRootings = bJackknife = bWitnesses = bDisplayed = bRetention = false;
+		bMast = bReconcile = bCoverage = bIndexOnly = bTreeList = bBatch = false;
+		bCompatibility = bMatrix = bNJ = bBIONJ = bMR = bMRPlus = bGreedy = false;
+		bScalar = bBenchmark = bCollapse = bWeight = bCharStore = bCharFile = bTransfer = bOutgroup = false;
+		bPrune = bTaxSet = false;
+		collapseThreshold = 0.0;
+		greedyOrder = goV;
+		support_verbose = 0;
+		jackknifeReplicates = 100;
+		jackknifeFraction = 0.1;
+		jackknifeSeed = 1;
+		minOverlap = 2;
+		minTaxa = 2;
+		fname[0] = ofname[0] = manifestfname[0] = '\0';
+	};
+};
+
 /**
  * @var  vector <NTree> NTreeVector
  * @brief A vector of NTree's, used to store the input trees
@@ -119,6 +320,39 @@ string GetCladeStrForNode( NodePtr n )
 	return result;
 }
 
+/**
+ * Parse a list of input trees such as "1-100,250". Input trees are
+ * numbered from 1, and are appended as positions in the tree file (where
+ * the supertree is 0).
+ */
+bool ParseTreeList (const char *s, vector<int> &trees)
+{
+	const char *q = s;
+	while (*q)
+	{
+		char *end;
+		long lo = strtol (q, &end, 10);
+		if ((end == q) || (lo < 1))
+			return false;
+		long hi = lo;
+		q = end;
+		if (*q == '-')
+		{
+			hi = strtol (q + 1, &end, 10);
+			if ((end == q + 1) || (hi < lo))
+				return false;
+			q = end;
+		}
+		for (long k = lo; k <= hi; k++)
+			trees.push_back ((int)k);
+		if (*q == ',')
+			q++;
+		else if (*q)
+			return false;
+	}
+	return true;
+}
+
 void ShowSplit(IntegerSet* ingroup, IntegerSet* outgroup, Profile<NTree>* p, ostream& os)
 {
     os << "{";
@@ -140,34 +374,347 @@ void ShowSplit(IntegerSet* ingroup, IntegerSet* outgroup, Profile<NTree>* p, ost
     os << "}";
 }
 
+/**
+ * @class VerboseObserver
+ * Writes each verdict as it is found, for verbosity levels above 2.
+ * The supertree must have label clusters.
+ */
+class VerboseObserver : public SupportObserver
+{
+public:
+	VerboseObserver (NTree *supertree, Profile<NTree> *profile, ostream *f) { t = supertree; p = profile; os = f; };
+	virtual void Classified (int tree, int node, int verdict)
+	{
+		NNodePtr np = (NNodePtr) (*t)[node];
+		NNodePtr root = (NNodePtr) t->GetRoot();
+		IntegerSet np_outgroup;
+		set_difference(root->Cluster.begin(),root->Cluster.end(),np->Cluster.begin(),np->Cluster.end(),insert_iterator<IntegerSet>(np_outgroup,np_outgroup.begin()));
+		switch (verdict)
+		{
+			case svSupport:
+				*os << "TREE " << tree << " SUPPORTS ";
+				ShowSplit(&(np->Cluster),&np_outgroup,p,*os);
+				*os << endl;
+				break;
+			case svConflict:
+				*os << " TREE " << tree << " CONFLICTS WITH ";
+				ShowSplit(&(np->Cluster),&np_outgroup,p,*os);
+				*os << endl;
+				break;
+			case svIrrelevant:
+				*os << "tree " << tree << " is IRRELEVANT TO " << endl;
+				ShowSplit(&(np->Cluster),&np_outgroup,p,*os);
+				*os << endl;
+				break;
+		}
+	};
+protected:
+	NTree *t;
+	Profile<NTree> *p;
+	ostream *os;
+};
 
+/**
+ * @class WitnessWriter
+ * Writes one line per conflict: the number of the clade (in the order
+ * the clades are listed on standard output), the input tree, and a
+ * triplet ab|c displayed by that tree which the clade contradicts.
+ */
+class WitnessWriter : public WitnessObserver
+{
+public:
+	WitnessWriter (ostream *f, int numLeaves, Profile<NTree> *profile) { os = f; n = numLeaves; p = profile; };
+	virtual void Witnessed (int tree, int node, int a, int b, int c)
+	{
+		*os << node - n + 1 << "\t" << tree << "\t" << p->GetLabelFromIndex (a) << ","
+			<< p->GetLabelFromIndex (b) << "|" << p->GetLabelFromIndex (c) << endl;
+	};
+protected:
+	ostream *os;
+	int n;
+	Profile<NTree> *p;
+};
 
 //------------------------------------------------------------------------------
-int main (int argc, char **argv)
+/**
+ * Read a list of taxon labels separated by commas, or, if the list is
+ * "@file", separated by commas or white space in that file.
+ */
+void ReadTaxonList (const string &list, vector<string> &labels)
 {
+	string text (list);
+	if (!text.empty() && (text[0] == '@'))
+	{
+		ifstream lf (text.c_str() + 1);
+		text.assign ((istreambuf_iterator<char>(lf)), istreambuf_iterator<char>());
+	}
+	text += ",";
+	string label;
+	labels.clear ();
+	for (unsigned int i = 0; i < text.size(); i++)
+	{
+		if ((text[i] != ',') && !isspace ((unsigned char)text[i]))
+			label += text[i];
+		else if (!label.empty())
+		{
+			labels.push_back (label);
+			label.clear ();
+		}
+	}
+}
+
+/**
+ * @class OutgroupRooting
+ * Roots each input tree on the edge separating an outgroup from the rest
+ * as the tree is indexed, so unrooted trees with a known outgroup need no
+ * separate rooting pass. Trees that can't be rooted that way (the
+ * outgroup is not monophyletic, or the tree has none or only outgroup
+ * taxa) are left as they were read, and listed by Report.
+ */
+class OutgroupRooting
+{
+public:
+	/**
+	 * @param list the outgroup taxa, separated by commas, or "@file" to read
+	 * them from a file, separated by commas or white space
+	 * @param profile the profile, in which the labels are looked up
+	 * @param f stream for warnings about unknown labels
+	 */
+	OutgroupRooting (const string &list, Profile<NTree> *profile, ostream *f)
+	{
+		NumTaxa = 0;
+		NumRerooted = 0;
+		Outgroup.assign (profile->GetNumLabels(), false);
+		vector<string> labels;
+		ReadTaxonList (list, labels);
+		for (unsigned int i = 0; i < labels.size(); i++)
+		{
+			LabelMap::iterator it = profile->Labels.find (labels[i]);
+			if (it == profile->Labels.end())
+				*f << "outgroup taxon \"" << labels[i] << "\" is not in any tree" << endl;
+			else if (!Outgroup[it->second])
+			{
+				Outgroup[it->second] = true;
+				NumTaxa++;
+			}
+		}
+	};
+
+	/**
+	 * Root input tree number k, keeping the support values in labels (if
+	 * not NULL, and read from the same tree) in step.
+	 */
+	void Reroot (int k, TreeIndex &t, LabelSupport *labels)
+	{
+		int result = labels ? labels->Reroot (t, Outgroup) : t.Reroot (Outgroup, Edge);
+		if (result == rrRerooted)
+			NumRerooted++;
+		else if (result == rrMissing)
+			Missing.push_back (k);
+		else
+			NotMonophyletic.push_back (k);
+	};
+
+	/**
+	 * Write the number of trees rooted on the outgroup and list the others.
+	 */
+	void Report (ostream &f) const
+	{
+		f << "rooted " << NumRerooted << " input trees on the " << NumTaxa << " outgroup taxa" << endl;
+		Report (f, NotMonophyletic, "outgroup not monophyletic");
+		Report (f, Missing, "no outgroup taxa, or only outgroup taxa");
+	};
+
+protected:
+	vector<bool> Outgroup;
+	int NumTaxa;
+	int NumRerooted;
+	vector<int> Edge;
+	vector<int> Missing;
+	vector<int> NotMonophyletic;
+
+	void Report (ostream &f, const vector<int> &trees, const char *reason) const
+	{
+		if (trees.empty())
+			return;
+		f << reason << " in " << trees.size() << " tree(s), left as read: ";
+		for (unsigned int i = 0; i < trees.size(); i++)
+		{
+			if (i > 0)
+				f << ",";
+			f << trees[i];
+		}
+		f << endl;
+	};
+};
+
 
-#if __MWERKS__
-#if macintosh
-    argc = ccommand(&argv);
-#endif
-#endif
 
+//------------------------------------------------------------------------------
+/**
+ * Read the options and file names in argv into o.
+ * @return false if the number of file names is wrong
+ */
+bool ParseOptions (int argc, char **argv, SupportOptions &o)
+{
     // Parse options
     // Heavily borrowed from the squid library
     char *optname;
     char *optarg;
     int   optind;
 
-   
-	bVerbose			= false; // Write Verbose junk to cout
-	bAll				= false;
-	int support_verbose = 0;
-	
+	ResetGetopt ();
 	while (Getopt(argc, argv, OPTIONS, NOPTIONS, usage,
                   &optind, &optname, &optarg))
     {
-        if (strcmp(optname, "-b") == 0) {  support_verbose = atoi(optarg);
-            if (support_verbose > 2) cout << "Writing verbose information" << endl;}
+        if (strcmp(optname, "-b") == 0) {  o.support_verbose = atoi(optarg);
+            if (o.support_verbose > 2) cout << "Writing verbose information" << endl;}
+		if (strcmp(optname, "-r") == 0)
+		{
+			o.bAllRootings = true;
+			strcpy (o.rootingsfname, optarg);
+		}
+		if (strcmp(optname, "-j") == 0)
+		{
+			o.bJackknife = true;
+			strcpy (o.jackknifefname, optarg);
+		}
+		if (strcmp(optname, "-w") == 0)
+		{
+			o.bWitnesses = true;
+			strcpy (o.witnessfname, optarg);
+		}
+		if (strcmp(optname, "-d") == 0)
+		{
+			o.bDisplayed = true;
+			strcpy (o.displayfname, optarg);
+		}
+		if (strcmp(optname, "-c") == 0)
+			o.bRetention = true;
+		if (strcmp(optname, "-m") == 0)
+		{
+			o.bMast = true;
+			strcpy (o.mastfname, optarg);
+		}
+		if (strcmp(optname, "-g") == 0)
+		{
+			o.bReconcile = true;
+			strcpy (o.reconcilefname, optarg);
+		}
+		if (strcmp(optname, "-t") == 0)
+		{
+			o.bCoverage = true;
+			strcpy (o.coveragefname, optarg);
+		}
+		if (strcmp(optname, "--overlap") == 0)
+			o.minOverlap = atoi(optarg);
+		if (strcmp(optname, "--replicates") == 0)
+			o.jackknifeReplicates = atoi(optarg);
+		if (strcmp(optname, "--delete") == 0)
+			o.jackknifeFraction = atof(optarg);
+		if (strcmp(optname, "--seed") == 0)
+			o.jackknifeSeed = (unsigned long) atol(optarg);
+		if (strcmp(optname, "--index") == 0)
+			o.bIndexOnly = true;
+		if (strcmp(optname, "--trees") == 0)
+		{
+			o.bTreeList = true;
+			o.treelist = optarg;
+		}
+		if (strcmp(optname, "--batch") == 0)
+		{
+			o.bBatch = true;
+			strcpy (o.manifestfname, optarg);
+		}
+		if (strcmp(optname, "--compatibility") == 0)
+		{
+			o.bCompatibility = true;
+			strcpy (o.compatibilityfname, optarg);
+		}
+		if (strcmp(optname, "--matrix") == 0)
+		{
+			o.bMatrix = true;
+			strcpy (o.matrixfname, optarg);
+		}
+		if (strcmp(optname, "--nj") == 0)
+		{
+			o.bNJ = true;
+			strcpy (o.njfname, optarg);
+		}
+		if (strcmp(optname, "--bionj") == 0)
+		{
+			o.bNJ = o.bBIONJ = true;
+			strcpy (o.njfname, optarg);
+		}
+		if (strcmp(optname, "--mrminus") == 0)
+		{
+			o.bMR = true;
+			strcpy (o.supertreefname, optarg);
+		}
+		if (strcmp(optname, "--mrplus") == 0)
+		{
+			o.bMR = o.bMRPlus = true;
+			strcpy (o.supertreefname, optarg);
+		}
+		if (strcmp(optname, "--greedy") == 0)
+		{
+			o.bGreedy = true;
+			strcpy (o.supertreefname, optarg);
+		}
+		if (strcmp(optname, "--rank") == 0)
+		{
+			if (strcmp(optarg, "sq") == 0)
+				o.greedyOrder = goNetSupport;
+			else if (strcmp(optarg, "v") == 0)
+				o.greedyOrder = goV;
+			else
+				return false;
+		}
+		if (strcmp(optname, "--scalar") == 0)
+			o.bScalar = true;
+		if (strcmp(optname, "--benchmark") == 0)
+			o.bBenchmark = true;
+		if (strcmp(optname, "--collapse") == 0)
+		{
+			o.bCollapse = true;
+			o.collapseThreshold = atof(optarg);
+		}
+		if (strcmp(optname, "--weight") == 0)
+			o.bWeight = true;
+		if (strcmp(optname, "--charstore") == 0)
+		{
+			o.bCharStore = true;
+			strcpy (o.charstorefname, optarg);
+		}
+		if (strcmp(optname, "--characters") == 0)
+		{
+			o.bCharFile = true;
+			strcpy (o.charstorefname, optarg);
+		}
+		if (strcmp(optname, "--transfer") == 0)
+		{
+			o.bTransfer = true;
+			strcpy (o.transferfname, optarg);
+		}
+		if (strcmp(optname, "--outgroup") == 0)
+		{
+			o.bOutgroup = true;
+			o.outgroup = optarg;
+		}
+		if (strcmp(optname, "--prune") == 0)
+		{
+			o.bPrune = true;
+			strcpy (o.prunefname, optarg);
+		}
+		if (strcmp(optname, "--keep") == 0)
+			o.keep = optarg;
+		if (strcmp(optname, "--taxset") == 0)
+		{
+			o.bTaxSet = true;
+			o.keep = optarg;
+		}
+		if (strcmp(optname, "--mintaxa") == 0)
+			o.minTaxa = atoi(optarg);
 		if (strcmp(optname, "-v") == 0)
         {
             cout << "STSSupport " << MAJOR_VERSION << "." MINOR_VERSION << "." << MINI_VERSION << endl;
@@ -177,72 +724,135 @@ int main (int argc, char **argv)
         }
 	}
 	
-    if (argc - optind != 2)
-    {
-        cerr << "Incorrect number of arguments:" << usage << endl;
-        exit (0);
-    }
-	
-	
-    // Get options from command line
-    char fname[FILENAME_SIZE];
-    strcpy( fname, argv[optind++] );
-	
-	char ofname[FILENAME_SIZE];
-	strcpy( ofname, argv[optind++] );
-	
-    // Check file exists
-    FILE* file = fopen( fname, "r" );
-    if( file != NULL )
-    {
-        fclose(file);
-        file = NULL;
-    }
-    else
-    {
-        cerr << "File \"" << fname << "\" does not exist." << endl;
-        exit (0);
-    }
-	
-	
-   // cout << "STSupport " << MAJOR_VERSION << "." MINOR_VERSION << "." << MINI_VERSION << endl;
+	int files = o.bBatch ? 0 : ((o.bIndexOnly || o.bNJ || o.bMR || o.bGreedy || o.bCharStore || o.bPrune) ? 1 : 2);
+    if (argc - optind != files)
+		return false;
+	if (files > 0)
+		strcpy (o.fname, argv[optind++]);
+	if (files > 1)
+		strcpy (o.ofname, argv[optind++]);
+	return true;
+}
 
-    ifstream f (fname);
+//------------------------------------------------------------------------------
+/**
+ * Read the trees for an analysis, through the index of the tree file if
+ * only some of the input trees are wanted.
+ * @return true if successful
+ */
+bool ReadProfile (const SupportOptions &o, Profile<NTree> &p)
+{
+	vector<int> selected;
+	TreeFileIndex index;
+	if (o.bTreeList)
+	{
+		// The supertree, then the listed input trees
+		selected.push_back (0);
+		if (!ParseTreeList (o.treelist.c_str(), selected))
+		{
+			cerr << "Bad list of trees \"" << o.treelist << "\"" << endl;
+			return false;
+		}
+		if (!index.Open (o.fname))
+		{
+			cerr << "Failed to index trees" << endl;
+			return false;
+		}
+	}
 
-	ofstream of (ofname);
+    ifstream f (o.fname, o.bTreeList ? (ios::in | ios::binary) : ios::in);
+	bool ok = o.bTreeList ? p.ReadIndexedTrees (f, index, selected) : p.ReadTrees (f);
+	f.close();
+	if (ok)
+		p.MakeLabelFreqList ();
+	return ok;
+}
 
-    Profile<NTree> p;
+/**
+ * @class DiscardWitnesses
+ * Takes the witnesses found by a SupportEngine and does nothing with
+ * them, so the kernels that find witnesses can be timed on their own.
+ */
+class DiscardWitnesses : public WitnessObserver
+{
+public:
+	virtual void Witnessed (int tree, int node, int a, int b, int c) {};
+};
 
-    if (!p.ReadTrees (f))
-    {
-        cerr << "Failed to read trees, bailing out" << endl;
-        exit(0);
-    }
+//------------------------------------------------------------------------------
+/**
+ * Time classifying the input trees one at a time with the kernels compiled
+ * for the options of the analysis against the generic kernel, and check
+ * that the counts agree.
+ * @param st the indexed supertree
+ * @param trees the indexed input trees, with BuildLCA called if witnesses
+ * are wanted
+ * @param weights weights of the nodes of each input tree, or empty
+ */
+void BenchmarkKernels (const TreeIndex &st, const vector<TreeIndex> &trees,
+	const vector< vector<double> > &weights, const SupportOptions &o, ostream &os)
+{
+	double seconds[2];
+	vector<double> counts[2];
+	DiscardWitnesses discard;
+	for (int k = 0; k < 2; k++)
+	{
+		SupportEngine engine (&st);
+		engine.SetBothSides (o.bAllRootings);
+		engine.SetRetention (o.bRetention);
+		engine.SetBitSliced (false);
+		engine.SetSpecialised (k == 0);
+		if (o.bWitnesses)
+			engine.SetWitnessObserver (&discard);
+		clock_t start = clock ();
+		for (int j = 0; j < (int)trees.size(); j++)
+			engine.AddTree (trees[j], j + 1, weights.empty() ? NULL : &weights[j]);
+		engine.Finish ();
+		seconds[k] = (double)(clock () - start) / CLOCKS_PER_SEC;
 
-    p.MakeLabelFreqList ();
-	
-	 // Create initial multiset of trees T
-  	
-		  //
-    // Retrieve all tokens for this command, stopping only in the event
-    // of a semicolon or an unrecognized keyword
-       
-	cout << "read " << p.GetNumTrees() << endl;
+		for (int u = 0; u < st.GetNumNodes(); u++)
+		{
+			for (int v = svIrrelevant; v <= svPermit; v++)
+			{
+				counts[k].push_back (engine.GetWeightedCount (u, v));
+				if (o.bAllRootings)
+					counts[k].push_back (engine.GetComplementCount (u, v));
+			}
+		}
+		for (int j = 0; j < engine.GetNumTrees(); j++)
+		{
+			counts[k].push_back (engine.GetNumUndisplayed (j));
+			counts[k].push_back (engine.GetNumInputConflicts (j));
+		}
+	}
+	os << endl << "Classified " << trees.size() << " input trees in " << seconds[0] << " s with the specialised kernel, "
+		<< seconds[1] << " s with the generic one (counts " << ((counts[0] == counts[1]) ? "agree" : "differ") << ")" << endl;
+}
+
+//------------------------------------------------------------------------------
+/**
+ * Classify the clades of the supertree (the first tree in p) against the
+ * input trees and run the analyses selected in o. The summary line is
+ * written to the output file o.ofname and everything else to os.
+ */
+void Analyse (Profile<NTree> &p, const SupportOptions &o, ostream &os)
+{
+	ofstream of (o.ofname);
+
+	os << "read " << p.GetNumTrees() << endl;
     int StTax,StClades;
 	if( p.GetNumTrees() > 1 )
     {
        
-        if (support_verbose > 2)
-            p.ShowTrees (cout);
+        if (o.support_verbose > 2)
+            p.ShowTrees (os);
       
 		int i = 0;  // the tree to be tested!  -the supertree
 		
-		//these are now in terms of input TREES supporting/conflicting/etc. each node.
-		 map<NNodePtr,int > support_count_per_STnode;
-        map<NNodePtr,int > conflict_count_per_STnode;
-        map<NNodePtr,int> consistent_count_per_STnode;
-        map<NNodePtr,int> irrelevant_count_per_STnode;
-		
+		vector<string> taxonLabels;
+		for (int k = 0; k < p.GetNumLabels(); k++)
+			taxonLabels.push_back (p.GetLabelFromIndex (k));
+
 		NTree t1 = p.GetIthTree (i);
         t1.MakeNodeList();
         StTax = t1.GetNumLeaves();
@@ -252,41 +862,53 @@ int main (int argc, char **argv)
         {
             t1[jset]->SetLabelNumber (p.GetIndexOfLabel (t1[jset]->GetLabel()) + 1);
         }
-        for (int t1_cl = t1.GetNumLeaves(); t1_cl != t1.GetNumNodes(); t1_cl++)
-        {
-            NNodePtr insertp = (NNodePtr) t1[t1_cl];
-            
-            if (insertp != t1.GetRoot() )
-            {
-                support_count_per_STnode.insert( pair<NNodePtr,int> (insertp,0));
-                conflict_count_per_STnode.insert( pair<NNodePtr,int> (insertp,0));
-                consistent_count_per_STnode.insert( pair<NNodePtr,int> (insertp,0));
-                irrelevant_count_per_STnode.insert( pair<NNodePtr,int> (insertp,0));
-            }
-        }
 
+		TreeIndex t1_index;
+		t1_index.Build (t1, p.GetNumLabels());
+		t1_index.BuildLCA ();
+
+		//these are now in terms of input TREES supporting/conflicting/etc. each node.
+		SupportEngine engine (&t1_index);
+		engine.SetBothSides (o.bAllRootings);
+		engine.SetRetention (o.bRetention);
+		engine.SetBitSliced (!o.bScalar);
+
+		VerboseObserver observer (&t1, &p, &os);
+		if (o.support_verbose > 2)
+		{
 			t1.BuildLabelClusters ();
-        t1.Update();
-        IntegerSet t1_leafset;
-        NNodePtr t1root = (NNodePtr) t1.GetRoot(); 
-        
-        copy(t1root->Cluster.begin(),t1root->Cluster.end(),insert_iterator<IntegerSet>(t1_leafset,t1_leafset.end()));
-        vector<int> t1_leafsetv;
-        copy(t1root->Cluster.begin(),t1root->Cluster.end(),insert_iterator<vector<int> > (t1_leafsetv,t1_leafsetv.end()));
-        vector<int> t1_ingroup;
+			engine.SetObserver (&observer);
+		}
 		
+		ofstream wf;
+		WitnessWriter witnesses (&wf, t1.GetNumLeaves(), &p);
+		if (o.bWitnesses)
+		{
+			wf.open (o.witnessfname);
+			engine.SetWitnessObserver (&witnesses);
+		}
+
+		TaxonCoverage coverage (&t1_index);
+		CharacterCompatibility compatibility (p.GetNumLabels());
+		bool mrp = o.bCompatibility && !p.GetCharacters() && !o.bCharFile;
+
 		multiset<double> treecompleteness;
+		vector<TreeIndex> inputIndex; // kept only for the jackknife, MAST, reconciliation, transfer index and benchmark
+		vector< vector<double> > inputWeights; // kept only for the benchmark
+		LabelSupport labelSupport;
+		vector<double> weights;
+		int collapsed = 0;
+		OutgroupRooting rooting (o.outgroup, &p, &os);
 		
 		for (int j = 1; j != p.GetNumTrees(); j++) //p.GetNumTrees()
 		{
 			
-			if (support_verbose > 2)
+			if (o.support_verbose > 2)
 			{
-				cout << "-----------------------------------------" << endl;
-				cout << "Looking at tree " << j  << endl;
-				cout << "-----------------------------------------" << endl;
+				os << "-----------------------------------------" << endl;
+				os << "Looking at tree " << j  << endl;
+				os << "-----------------------------------------" << endl;
 			}
-			//generate the clusters of each tree..
 			NTree t2 = p.GetIthTree(j);
 			t2.MakeNodeList();
 			//set the bits right.
@@ -294,231 +916,680 @@ int main (int argc, char **argv)
 			{
 				t2[jset]->SetLabelNumber (p.GetIndexOfLabel (t2[jset]->GetLabel()) + 1);
 			}
-			t2.BuildLabelClusters ();
-			t2.Update();
 			
 			treecompleteness.insert( (double) t2.GetNumLeaves() /  (double) StTax );
 			
-			IntegerSet t2_leafset;
-			NNodePtr t2root = (NNodePtr) t2.GetRoot();
-			copy(t2root->Cluster.begin(),t2root->Cluster.end(),insert_iterator<IntegerSet>(t2_leafset,t2_leafset.end()));
-			
-			for (int t1_cl = t1.GetNumLeaves(); t1_cl != t1.GetNumNodes(); t1_cl++)
+			TreeIndex t2_index;
+			t2_index.Build (t2, p.GetNumLabels());
+			if (o.bCollapse || o.bWeight)
+				labelSupport.Read (t2);
+			if (o.bOutgroup)
+				rooting.Reroot (j, t2_index, (o.bCollapse || o.bWeight) ? &labelSupport : NULL);
+			if (o.bCollapse || o.bWeight)
 			{
-				//cout << "Looking at ST clade ";
-				NNodePtr np = (NNodePtr) t1[t1_cl];
-				if (np != t1.GetRoot())
-				{
-					IntegerSet np_outgroup;
-					set_difference(t1_leafset.begin(),t1_leafset.end(),np->Cluster.begin(),np->Cluster.end(),insert_iterator<set<int> >(np_outgroup,np_outgroup.begin()));
-									
-					//CHECK IF T2 IS RELEVANT TO CLADE..
-					IntegerSet i12,o12;
-					set_intersection(np->Cluster.begin(),np->Cluster.end(),t2_leafset.begin(),t2_leafset.end(),insert_iterator<IntegerSet>(i12,i12.end()));
-					set_intersection(np_outgroup.begin(),np_outgroup.end(),t2_leafset.begin(),t2_leafset.end(),insert_iterator<IntegerSet>(o12,o12.end()));
-					if (i12.size() > 0 && o12.size() > 0) 
-					{
-						//T2 IS RELEVANT.. NEED TO CHECK ALL CLADES IN T2 TO FIND A CONFLICT OR SUPPORT.. IF NEITHER, CONSISTENT
-						//CAN BREAK OUT OF t2 NODES LOOP AS SOON AS I GET A SUPPORT OR CONFLICT..
-						int t2_cl = t2.GetNumLeaves();
-						bool found_conflict = false;
-						bool found_support = false;
-						while (t2_cl != t2.GetNumNodes() && !found_conflict && !found_support)
-						{
-							NNodePtr np2 = (NNodePtr) t2[t2_cl];
-							if ( np2 != t2.GetRoot())
-							{
-								IntegerSet np2_outgroup;
-								set_difference(t2_leafset.begin(),t2_leafset.end(),np2->Cluster.begin(),np2->Cluster.end(),insert_iterator<set<int> >(np2_outgroup,np2_outgroup.begin()));
-					
-								//DO THEY SUPPORT?
-								IntegerSet ingroupresult;
-								IntegerSet outgroupresult;
-								set_difference(np2->Cluster.begin(),np2->Cluster.end(),np->Cluster.begin(),np->Cluster.end(),insert_iterator<IntegerSet>(ingroupresult,ingroupresult.end()));
-								set_difference(np2_outgroup.begin(),np2_outgroup.end(),np_outgroup.begin(),np_outgroup.end(),insert_iterator<IntegerSet>(outgroupresult,outgroupresult.end()));
-								if (ingroupresult.size () == 0 && outgroupresult.size() == 0)
-								{
-									if (support_verbose > 2)
-									{
-										cout << "TREE " << j << " SUPPORTS ";
-										ShowSplit(&(np->Cluster),&np_outgroup,&p,cout);
-										cout << endl;
-										
-									}
-									//add this to the supported nodes statistics
-									found_support = true;
-								}
-								else 
-								{       
-									//do they conflict?
-									IntegerSet i1i2,i1o2,o1i2,o1o2;
-									set_intersection(np->Cluster.begin(),np->Cluster.end(),np2->Cluster.begin(),np2->Cluster.end(),insert_iterator<IntegerSet>(i1i2,i1i2.end()));
-									set_intersection(np->Cluster.begin(),np->Cluster.end(),np2_outgroup.begin(),np2_outgroup.end(),insert_iterator<IntegerSet>(i1o2,i1o2.end()));
-									set_intersection(np_outgroup.begin(),np_outgroup.end(),np2->Cluster.begin(),np2->Cluster.end(),insert_iterator<IntegerSet>(o1i2,o1i2.end()));
-									// set_intersection(np_outgroup.begin(),np_outgroup.end(),np2_outgroup.begin(),np2_outgroup.end(),insert_iterator<IntegerSet>(o1o2,o1o2.end()));
-									if ( (i1i2.size() > 0) && (i1o2.size() > 0) && (o1i2.size() > 0))// && (o1o2.size() > 0))
-									{
-										if (support_verbose > 2)
-										{
-											cout << " TREE " << j << " CONFLICTS WITH ";
-											ShowSplit(&(np->Cluster),&np_outgroup,&p,cout);
-											cout << endl;
-										}
-										found_conflict = true;
-									} //not conflict
-                                } // not support
-                            } // tree 2 node not root
-							t2_cl++;
-                        } //tree 2 nodes loop 
-						
-						if (found_support && found_conflict) 
-						{
-							cout << "ERROR - CLADE IS SUPPORTED AND CONFLICTED.. AMBIGUOUS" << endl;
-						}
-						else if (found_support)
-						{   
-							map<NNodePtr,int>::iterator i = support_count_per_STnode.find(np);
-									if (i != support_count_per_STnode.end())
-										(*i).second++;
-									else if (support_verbose) cout << "WE HAVE A PROBLEM - CONTACT AUTHOR AND SAY SUPPORT FAIL 1" << endl;
-									
-						}
-						else if (found_conflict)
-						{
-							map<NNodePtr,int>::iterator i = conflict_count_per_STnode.find(np);
-										if (i != conflict_count_per_STnode.end()) 
-											(*i).second++;
-										else if (support_verbose) cout << "WE HAVE A PROBLEM" << endl;
-						}
-						else 
-						{
-							map<NNodePtr,int>::iterator i = consistent_count_per_STnode.find(np);
-							if (i != conflict_count_per_STnode.end()) 
-								(*i).second++;
-							else if (support_verbose) cout << "WE HAVE A PROBLEM" << endl;
-						}
-					}
-					else
-					{
-						//T2 is IRRELEVANT TO CLADE.. NO NEED TO LOOP 
-						
-						if (support_verbose > 2)
-						{
-							
-							cout << "tree " << j << " is IRRELEVANT TO " << endl;
-							ShowSplit(&(np->Cluster),&np_outgroup,&p,cout);
-							cout << endl;
-							
-						}
-						map<NNodePtr,int>::iterator i = irrelevant_count_per_STnode.find(np);
-						if (i != irrelevant_count_per_STnode.end()) 
-							(*i).second++;
-						else if (support_verbose) cout << "WE HAVE A PROBLEM" << endl;
-					}   
-					
-				} //tree1 node not root
-			} //tree1 nodes loop
-		
-			
+				if (o.bCollapse)
+					collapsed += labelSupport.Collapse (t2_index, o.collapseThreshold);
+				if (o.bWeight)
+					labelSupport.GetWeights (weights);
+			}
+			if (o.bWitnesses || o.bMast || o.bReconcile || o.bTransfer)
+				t2_index.BuildLCA ();
+			engine.AddTree (t2_index, j, o.bWeight ? &weights : NULL);
+			if (o.bCoverage)
+				coverage.AddTree (t2_index);
+			if (mrp)
+				compatibility.AddTree (t2_index, j);
+			if (o.bJackknife || o.bMast || o.bReconcile || o.bTransfer || o.bBenchmark)
+				inputIndex.push_back (t2_index);
+			if (o.bBenchmark && o.bWeight)
+				inputWeights.push_back (weights);
         } //loop through trees
+		engine.Finish ();
+		if (o.bWitnesses)
+			wf.close ();
+		if (o.bOutgroup)
+			rooting.Report (os);
+		if (o.bCollapse)
+			os << "collapsed " << collapsed << " input clades with support below " << o.collapseThreshold << endl;
 		
 		//NOW READY TO OUTPUT SOME INFORMATION
 		//IN THE FORMAT NTREES(tab)
-		//cout << "MINIMUM COMPLETENESS IS " << *(min_element(treecompleteness.begin(),treecompleteness.end())) << endl;
-		//cout << "MAX COMPLETENESS IS " << *(max_element(treecompleteness.begin(),treecompleteness.end())) << endl;
 		double meancompleteness = 0;
 		for (multiset<double>::iterator k = treecompleteness.begin(); k != treecompleteness.end(); k++) meancompleteness += *k;
 		meancompleteness = meancompleteness / treecompleteness.size();
-		int u1 = 0,u2 = 0,u3 = 0,u4 = 0,u5 = 0;
-		multiset<double> v1vals,v2vals,v3vals;
-		for (map<NNodePtr,int>::iterator k = support_count_per_STnode.begin(); k != support_count_per_STnode.end(); k++)
-		{
-		//	cout << "Ks=" << (*k).second << endl;
-				double v1 = 0;
-				double v2 = 0;
-				double v3 = 0;
-		//		cout << "Kf=" << (*k).first << endl;
-				int s = (*k).second;
-				int t = p.GetNumTrees() - 1;
-				int q,r,p;
-				string cladestr = GetCladeStrForNode( (*k).first );
-				map<NNodePtr,int>::iterator srch = conflict_count_per_STnode.find( (*k).first );
-				if (srch != conflict_count_per_STnode.end() )
-				{
-					q = (*srch).second;
-				}
-				else cout << "ERROR PROBLEM MATCHING SUPPORT AND CONFLICT IN u" << endl;
-				srch = consistent_count_per_STnode.find( (*k).first );
-				if (srch != consistent_count_per_STnode.end() )
+		SupportSummary summary;
+		for (int t1_cl = t1.GetNumLeaves(); t1_cl != t1.GetNumNodes(); t1_cl++)
+		{
+			NNodePtr np = (NNodePtr) t1[t1_cl];
+			if (np == t1.GetRoot())
+				continue;
+			double s = engine.GetWeightedCount (t1_cl, svSupport);
+			double q = engine.GetWeightedCount (t1_cl, svConflict);
+			int p = engine.GetCount (t1_cl, svPermit);
+			int r = engine.GetCount (t1_cl, svIrrelevant);
+			summary.AddClade (s, q, p, r, engine.GetNumTrees());
+
+			double v1, v2, v3;
+			SupportSummary::Indices (s, q, p, v1, v2, v3);
+			os << GetCladeStrForNode (np);
+			os << "\tS=" << s << " Q=" << q << " P=" << p; //<< " S+Q=" << s+q << " s-q=" << s-q << " s-q+p=" << (s-q)+p << " s-q-p=" << (s-q)-p << " s+q+p=" << s+q+p;
+			os << " v1=" << v1 << " v2=" << v2 << " v3=" << v3 << endl;
+		}
+		of <<  p.GetNumTrees()-1 << "\t" << StTax << "\t";
+		of << meancompleteness << " (" <<  *(min_element(treecompleteness.begin(),treecompleteness.end())) << "," <<  *(max_element(treecompleteness.begin(),treecompleteness.end())) << ")" << "\t";
+		of  << StClades-1 << "\t";
+		summary.Write (of);
+		os <<  p.GetNumTrees()-1 << "\t" << StTax << "\t";
+		os << meancompleteness << " (" <<  *(min_element(treecompleteness.begin(),treecompleteness.end())) << "," <<  *(max_element(treecompleteness.begin(),treecompleteness.end())) << ")" << "\t";
+		os  << StClades-1 << "\t";
+		summary.Write (os);
+
+		if (o.bRetention)
+		{
+			// Input clades retained by, in conflict with, or merely
+			// permitted by the supertree restricted to each tree's taxa
+			int clusters = 0, retained = 0, conflicts = 0;
+			os << endl << "Input clade retention" << endl;
+			for (int k = 0; k < engine.GetNumTrees(); k++)
+			{
+				int c = engine.GetNumInputClusters (k);
+				int r = c - engine.GetNumUndisplayed (k);
+				int q = engine.GetNumInputConflicts (k);
+				os << k + 1 << "\t" << c << "\t" << r << "\t" << q << "\t" << c - r - q << "\t";
+				if (c > 0)
+					os << (double) r / (double) c;
+				else
+					os << "-";
+				os << endl;
+				clusters += c;
+				retained += r;
+				conflicts += q;
+			}
+			double rate = (clusters > 0) ? (double) retained / (double) clusters : 0.0;
+			of << clusters << "\t" << retained << "\t" << conflicts << "\t" << clusters - retained - conflicts << "\t" << rate << "\t";
+			os << "total\t" << clusters << "\t" << retained << "\t" << conflicts << "\t" << clusters - retained - conflicts << "\t" << rate << "\t";
+		}
+
+		if (o.bDisplayed)
+		{
+			// One line per input tree: its number of clusters (restricted
+			// to taxa in the supertree), how many of these the supertree
+			// lacks, and whether the tree is displayed
+			ofstream df (o.displayfname);
+			int ndisplayed = 0;
+			for (int k = 0; k < engine.GetNumTrees(); k++)
+			{
+				df << k + 1 << "\t" << engine.GetNumInputClusters (k) << "\t" << engine.GetNumUndisplayed (k)
+					<< "\t" << (engine.IsDisplayed (k) ? "displayed" : "not displayed") << endl;
+				if (engine.IsDisplayed (k))
+					ndisplayed++;
+			}
+			df << "Displayed\t" << ndisplayed << "\t" << engine.GetNumTrees() << "\t";
+			for (int k = 0, cnt = 0; k < engine.GetNumTrees(); k++)
+			{
+				if (engine.IsDisplayed (k))
 				{
-					p = (*srch).second;
+					if (cnt++ > 0)
+						df << ",";
+					df << k + 1;
 				}
-				else cout << "ERROR PROBLEM MATCHING SUPPORT AND CONSISTENT IN u" << endl;
-				srch = irrelevant_count_per_STnode.find( (*k).first );
-				if (srch != irrelevant_count_per_STnode.end() )
+			}
+			df << endl;
+			df.close ();
+			os << endl << "Supertree displays " << ndisplayed << " of " << engine.GetNumTrees() << " input trees" << endl;
+		}
+
+		if (o.bMast)
+		{
+			AgreementSubtrees mast (&t1_index);
+			mast.Compute (inputIndex);
+			ofstream mf (o.mastfname);
+			mast.Report (mf, taxonLabels);
+			mf.close ();
+		}
+
+		if (o.bBenchmark)
+			BenchmarkKernels (t1_index, inputIndex, inputWeights, o, os);
+
+		if (o.bTransfer)
+		{
+			TransferSupport transfer (&t1_index);
+			transfer.Compute (inputIndex);
+			ofstream xf (o.transferfname);
+			transfer.Report (xf, taxonLabels);
+			xf.close ();
+			os << endl << "Mean transfer support index " << transfer.GetMeanIndex () << endl;
+		}
+
+		if (o.bReconcile)
+		{
+			Reconciliation reconciliation (&t1_index, &engine);
+			reconciliation.Compute (inputIndex);
+			ofstream gf (o.reconcilefname);
+			reconciliation.Report (gf, taxonLabels);
+			gf.close ();
+		}
+
+		if (o.bCoverage)
+		{
+			coverage.Finish (o.minOverlap);
+			ofstream tf (o.coveragefname);
+			coverage.Report (tf, taxonLabels);
+			tf.close ();
+			os << endl << "Overlap graph has " << coverage.GetNumComponents() << " component(s); "
+				<< coverage.GetNumDistinguished() << " of " << coverage.GetNumEdges()
+				<< " internal edges distinguished" << endl;
+		}
+
+		if (o.bCompatibility)
+		{
+			if (o.bCharFile)
+			{
+				CharacterStore store;
+				if (store.Load (o.charstorefname))
 				{
-					r = (*srch).second;
+					int skipped = compatibility.AddCharacters (store, p.Labels);
+					if (skipped > 0)
+						os << endl << skipped << " character(s) with more than two states skipped" << endl;
 				}
-				else cout << "ERROR PROBLEM MATCHING SUPPORT AND IRRELEVANT IN u" << endl;
-				
-			if (s == 0) 
-			{  
-				u1++;
-				if ( q > 0) u2++;
-			//	cout <<  "We have " << q << " conflict and " << (double) (t - r - p) / 2 << " " << ( t - r - p)  << " " << t << " " << r << " " << p << endl;
-				if ( !(q < (double)  (t - r ) / 2 ) ) u3++;
-				if ( q == ( t - r ) ) u4++;
-				if ( q == t) u5++;
+				else
+					os << endl << "Failed to read character store \"" << o.charstorefname << "\"" << endl;
 			}
-			cout << cladestr;
-			cout << "\tS=" << s << " Q=" << q << " P=" << p; //<< " S+Q=" << s+q << " s-q=" << s-q << " s-q+p=" << (s-q)+p << " s-q-p=" << (s-q)-p << " s+q+p=" << s+q+p;
-			if (s+q != 0)
+			else if (!mrp)
 			{
-				v1 =  double (s-q) / double (s+q);
-				
-			} else v1 = 0;
-			if (s + q + p != 0)
+				int skipped = compatibility.AddCharacters (*p.GetCharacters(), p.Labels);
+				if (skipped > 0)
+					os << endl << skipped << " character(s) with more than two states skipped" << endl;
+			}
+			compatibility.Compute (o.bMatrix);
+			ofstream kf (o.compatibilityfname);
+			compatibility.Report (kf);
+			kf.close ();
+			if (o.bMatrix)
 			{
-				v2 = double (( s- q) + p) / double (s+q+p);
-				v3 = double ((s - q) - p) / double (s+q+p);
-			} else { v2 = 0; v3 = 0; }
-			cout << " v1=" << v1 << " v2=" << v2 << " v3=" << v3 << endl;
-			v1vals.insert(v1);
-			v2vals.insert(v2);
-			v3vals.insert(v3);
-		}
-		double meanv1 = 0;
-		for (multiset<double>::iterator k = v1vals.begin(); k != v1vals.end(); k++) meanv1 += *k;
-		meanv1 = meanv1 / v1vals.size();
-		double meanv2 = 0;
-		for (multiset<double>::iterator k = v2vals.begin(); k != v2vals.end(); k++) meanv2 += *k;
-		meanv2 = meanv2 / v2vals.size();
-		double meanv3 = 0;
-		for (multiset<double>::iterator k = v3vals.begin(); k != v3vals.end(); k++) meanv3 += *k;
-		meanv3 = meanv3 / v3vals.size();
-	//cout << "TESTIN TESINT" << endl;
-		of <<  p.GetNumTrees()-1 << "\t" << StTax << "\t";
-		of << meancompleteness << " (" <<  *(min_element(treecompleteness.begin(),treecompleteness.end())) << "," <<  *(max_element(treecompleteness.begin(),treecompleteness.end())) << ")" << "\t";
-		of  << StClades-1 << "\t" << u1 << "\t" << u2 << "\t" << u3 << "\t" << u4 << "\t" << u5 << "\t";
-		of << meanv1 << " (" << *(min_element(v1vals.begin(),v1vals.end())) << "," << *(max_element(v1vals.begin(),v1vals.end())) << ")" << "\t";
-		of << meanv2 << " (" << *(min_element(v2vals.begin(),v2vals.end())) << "," << *(max_element(v2vals.begin(),v2vals.end())) << ")" << "\t";
-		of << meanv3 << " (" << *(min_element(v3vals.begin(),v3vals.end())) << "," << *(max_element(v3vals.begin(),v3vals.end())) << ")" << "\t";
-		cout <<  p.GetNumTrees()-1 << "\t" << StTax << "\t";
-		cout << meancompleteness << " (" <<  *(min_element(treecompleteness.begin(),treecompleteness.end())) << "," <<  *(max_element(treecompleteness.begin(),treecompleteness.end())) << ")" << "\t";
-		cout  << StClades-1 << "\t" << u1 << "\t" << u2 << "\t" << u3 << "\t" << u4 << "\t" << u5 << "\t";
-		cout << meanv1 << " (" << *(min_element(v1vals.begin(),v1vals.end())) << "," << *(max_element(v1vals.begin(),v1vals.end())) << ")" << "\t";
-		cout << meanv2 << " (" << *(min_element(v2vals.begin(),v2vals.end())) << "," << *(max_element(v2vals.begin(),v2vals.end())) << ")" << "\t";
-		cout << meanv3 << " (" << *(min_element(v3vals.begin(),v3vals.end())) << "," << *(max_element(v3vals.begin(),v3vals.end())) << ")" << "\t";
+				ofstream xf (o.matrixfname);
+				compatibility.WriteMatrix (xf);
+				xf.close ();
+			}
+			os << endl << compatibility.GetNumCompatiblePairs() << " of "
+				<< (long long)compatibility.GetNumCharacters() * (compatibility.GetNumCharacters() - 1) / 2
+				<< " pairs of " << (mrp ? "MRP " : "") << "characters compatible" << endl;
+		}
+
+		if (o.bAllRootings)
+		{
+			AllRootings rootings (&t1_index, &engine);
+			rootings.Compute ();
+			ofstream rf (o.rootingsfname);
+			rootings.Report (rf, taxonLabels);
+			rf.close ();
+			os << endl;
+			rootings.Report (os, taxonLabels);
+		}
+
+		if (o.bJackknife)
+		{
+			TaxonJackknife jackknife (&t1_index, &engine);
+			jackknife.SetReplicates (o.jackknifeReplicates);
+			jackknife.SetFraction (o.jackknifeFraction);
+			jackknife.SetSeed (o.jackknifeSeed);
+			jackknife.Compute (inputIndex);
+			ofstream jf (o.jackknifefname);
+			jackknife.Report (jf, taxonLabels);
+			jf.close ();
+			os << endl;
+			jackknife.Report (os, taxonLabels);
+		}
 	}
     else
     {
-        cout << "Needs at least 2 trees - a supertree and at least one input tree" << endl;
+        os << "Needs at least 2 trees - a supertree and at least one input tree" << endl;
     }	
 	
-	f.close();
 	of.close();
-  
+}
+
+//------------------------------------------------------------------------------
+/**
+ * Run every analysis listed in a manifest, one per line in the form of a
+ * command line ([-options] <tree-file> <outfile>); blank lines and lines
+ * starting with # are ignored. Each distinct tree file, identified by its
+ * contents and the trees selected from it, is read only once, and the
+ * analyses are shared between threads if compiled with OpenMP. The screen
+ * output of each analysis is written to <outfile>.log.
+ * @return the exit status
+ */
+int RunBatch (const char *manifestfname)
+{
+	ifstream mf (manifestfname);
+	if (!mf)
+	{
+		cerr << "Manifest \"" << manifestfname << "\" does not exist." << endl;
+		return 1;
+	}
+
+	vector<SupportOptions> jobs;
+	string line;
+	int lineno = 0;
+	while (getline (mf, line))
+	{
+		lineno++;
+		// Split into words, allowing double quotes around words
+		vector<string> words;
+		for (unsigned int i = 0; i < line.size(); )
+		{
+			if (isspace (line[i]))
+			{
+				i++;
+				continue;
+			}
+			string word;
+			if (line[i] == '"')
+			{
+				for (i++; (i < line.size()) && (line[i] != '"'); i++)
+					word += line[i];
+				i++;
+			}
+			else
+			{
+				for (; (i < line.size()) && !isspace (line[i]); i++)
+					word += line[i];
+			}
+			words.push_back (word);
+		}
+		if (words.empty() || (words[0][0] == '#'))
+			continue;
+
+		vector<char *> args;
+		args.push_back ((char *)"stsupport");
+		for (unsigned int i = 0; i < words.size(); i++)
+			args.push_back (&words[i][0]);
+		SupportOptions o;
+		if (!ParseOptions ((int)args.size(), &args[0], o) || o.bBatch || o.bIndexOnly || o.bNJ || o.bMR || o.bGreedy || o.bCharStore || o.bPrune)
+		{
+			cerr << "Line " << lineno << " of manifest: incorrect arguments" << endl << usage << endl;
+			return 1;
+		}
+		jobs.push_back (o);
+	}
+
+	// Read each distinct profile once
+	map<string, unsigned long long> hashOfFile;
+	map<string, int> profileOfKey;
+	vector<Profile<NTree> *> profiles;
+	vector<int> profileOfJob;
+	for (unsigned int k = 0; k < jobs.size(); k++)
+	{
+		if (hashOfFile.find (jobs[k].fname) == hashOfFile.end())
+			hashOfFile[jobs[k].fname] = TreeFileIndex::FileHash (jobs[k].fname);
+		char hash[32];
+		sprintf (hash, "%016llx", hashOfFile[jobs[k].fname]);
+		string key = string (hash) + " " + (jobs[k].bTreeList ? jobs[k].treelist : string ("*"));
+		if (profileOfKey.find (key) == profileOfKey.end())
+		{
+			Profile<NTree> *p = new Profile<NTree>;
+			if (!ReadProfile (jobs[k], *p))
+			{
+				cerr << "Failed to read trees from \"" << jobs[k].fname << "\", bailing out" << endl;
+				delete p;
+				for (unsigned int i = 0; i < profiles.size(); i++)
+					delete profiles[i];
+				return 1;
+			}
+			profileOfKey[key] = (int)profiles.size();
+			profiles.push_back (p);
+		}
+		profileOfJob.push_back (profileOfKey[key]);
+	}
+	cout << "read " << profiles.size() << " tree file(s) for " << jobs.size() << " analyses" << endl;
+
+	int njobs = (int)jobs.size();
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic, 1)
+#endif
+	for (int k = 0; k < njobs; k++)
+	{
+		char logfname[FILENAME_SIZE + 4];
+		sprintf (logfname, "%s.log", jobs[k].ofname);
+		ofstream log (logfname);
+		Analyse (*profiles[profileOfJob[k]], jobs[k], log);
+		log.close ();
+	}
+
+	for (unsigned int i = 0; i < profiles.size(); i++)
+		delete profiles[i];
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+int main (int argc, char **argv)
+{
+
+#if __MWERKS__
+#if macintosh
+    argc = ccommand(&argv);
+#endif
+#endif
+
+	bVerbose			= false; // Write Verbose junk to cout
+	bAll				= false;
+
+	SupportOptions o;
+    if (!ParseOptions (argc, argv, o))
+    {
+        cerr << "Incorrect number of arguments:" << usage << endl;
+        exit (0);
+    }
+
+	if (o.bBatch)
+		return RunBatch (o.manifestfname);
+
+    // Check file exists
+    FILE* file = fopen( o.fname, "r" );
+    if( file != NULL )
+    {
+        fclose(file);
+        file = NULL;
+    }
+    else
+    {
+        cerr << "File \"" << o.fname << "\" does not exist." << endl;
+        exit (0);
+    }
+	
+	
+   // cout << "STSupport " << MAJOR_VERSION << "." MINOR_VERSION << "." << MINI_VERSION << endl;
+
+	if (o.bIndexOnly)
+	{
+		// Index of the tree file, kept beside it
+		char indexfname[FILENAME_SIZE + 4];
+		sprintf (indexfname, "%s.idx", o.fname);
+		TreeFileIndex index;
+		if (!index.Build (o.fname) || !index.Save (indexfname))
+		{
+			cerr << "Failed to index trees, bailing out" << endl;
+			exit(0);
+		}
+		cout << "indexed " << index.GetNumTrees() << " trees in " << indexfname << endl;
+		exit(EXIT_SUCCESS);
+	}
+
+	if (o.bPrune)
+	{
+		// Every tree restricted to the taxa kept, read and written one at a
+		// time. A TAXSET is read from the ASSUMPTIONS block with the TREES
+		// block skipped, so the trees aren't held in memory.
+		vector<string> keep;
+		if (o.bTaxSet)
+		{
+			TaxaBlock *taxa = new TaxaBlock ();
+			AssumptionsBlock *assumptions = new AssumptionsBlock (*taxa);
+			MyNexus nexus;
+			nexus.Add (taxa);
+			nexus.Add (assumptions);
+			ifstream f (o.fname);
+			NexusToken token (f);
+			try
+			{
+				nexus.Execute (token);
+			}
+			catch (XNexus x)
+			{
+				cout << x.msg << " (line " << x.line << ", column " << x.col << ")" << endl;
+			}
+			f.close ();
+			LabelList names;
+			assumptions->GetTaxSetNames (names);
+			for (int k = 0; k < (int)names.size(); k++)
+			{
+				string a (names[k]), b (o.keep);
+				transform (a.begin(), a.end(), a.begin(), ::toupper);
+				transform (b.begin(), b.end(), b.begin(), ::toupper);
+				if (a != b)
+					continue;
+				IntSet &s = assumptions->GetTaxSet (names[k]);
+				for (IntSet::const_iterator it = s.begin(); it != s.end(); it++)
+					keep.push_back (taxa->GetTaxonLabel (*it));
+			}
+		}
+		else
+			ReadTaxonList (o.keep, keep);
+		if (keep.empty())
+		{
+			cerr << "No taxa to keep, bailing out" << endl;
+			exit(0);
+		}
+
+		TreeFileIndex index;
+		if (!index.Open (o.fname))
+		{
+			cerr << "Failed to index trees, bailing out" << endl;
+			exit(0);
+		}
+		TaxonPruner pruner;
+		pruner.SetTaxa (keep);
+		pruner.SetMinTaxa (o.minTaxa);
+		clock_t start = clock ();
+		if (!pruner.Run (index, o.fname, o.prunefname))
+		{
+			cerr << "Failed to prune trees, bailing out" << endl;
+			exit(0);
+		}
+		double seconds = (double)(clock () - start) / CLOCKS_PER_SEC;
+		cout << "kept " << pruner.GetNumTaxa() << " taxa; wrote " << pruner.GetNumWritten() << " of "
+			<< pruner.GetNumRead() << " trees to " << o.prunefname << " (" << pruner.GetNumRead() - pruner.GetNumWritten()
+			<< " with fewer than " << pruner.GetMinTaxa() << " taxa dropped) in " << seconds << " s" << endl;
+		exit(EXIT_SUCCESS);
+	}
+
+	if (o.bCharStore)
+	{
+		// Binary store of the characters, timing the parse of the NEXUS file
+		// (CharactersBlock::Read) against mapping the store
+		clock_t start = clock ();
+		TaxaBlock *taxa = new TaxaBlock ();
+		AssumptionsBlock *assumptions = new AssumptionsBlock (*taxa);
+		DataBlock *data = new DataBlock (*taxa, *assumptions);
+		CharactersBlock *characters = new CharactersBlock (*taxa, *assumptions);
+		MyNexus nexus;
+		nexus.Add (taxa);
+		nexus.Add (assumptions);
+		nexus.Add (data);
+		nexus.Add (characters);
+		ifstream f (o.fname);
+		NexusToken token (f);
+		try
+		{
+			nexus.Execute (token);
+		}
+		catch (XNexus x)
+		{
+			cout << x.msg << " (line " << x.line << ", column " << x.col << ")" << endl;
+		}
+		f.close ();
+		double parsed = (double)(clock () - start) / CLOCKS_PER_SEC;
+		CharactersBlock *c = (characters->GetNChar() > 0) ? characters : data;
+		if (!nexus.GetIsOK() || (c->GetNChar() == 0))
+		{
+			cerr << "No CHARACTERS block in \"" << o.fname << "\", bailing out" << endl;
+			exit(0);
+		}
+		CharacterStore store;
+		if (!store.Build (*c, assumptions) || !store.Save (o.charstorefname))
+		{
+			cerr << "Failed to write character store, bailing out" << endl;
+			exit(0);
+		}
+
+		start = clock ();
+		CharacterStore mapped;
+		if (!mapped.Load (o.charstorefname))
+		{
+			cerr << "Failed to read character store back, bailing out" << endl;
+			exit(0);
+		}
+		double loaded = (double)(clock () - start) / CLOCKS_PER_SEC;
+
+		// Visit every cell of each, counting the missing ones as a check
+		start = clock ();
+		long long missing = 0;
+		for (int j = 0; j < c->GetNChar(); j++)
+			for (int i = 0; i < c->GetNTax(); i++)
+				if (c->IsMissingState (i, j))
+					missing++;
+		double scanned = (double)(clock () - start) / CLOCKS_PER_SEC;
+		start = clock ();
+		long long mappedMissing = 0;
+		for (int j = 0; j < mapped.GetNumCharacters(); j++)
+		{
+			StateView column = mapped.GetColumn (j);
+			for (int i = 0; i < column.GetSize(); i++)
+				if (column[i] & csMissing)
+					mappedMissing++;
+		}
+		double mappedScanned = (double)(clock () - start) / CLOCKS_PER_SEC;
+
+		cout << "stored " << mapped.GetNumTaxa() << " taxa by " << mapped.GetNumCharacters() << " characters ("
+			<< mapped.GetCellBytes() << " byte(s) per cell, " << mapped.GetNumCharSets() << " character set(s)) in "
+			<< o.charstorefname << endl;
+		cout << "load: " << parsed << " s parsing the NEXUS file, " << loaded << " s mapping the store" << endl;
+		cout << "scan: " << scanned << " s over the block, " << mappedScanned << " s over the store ("
+			<< missing << " and " << mappedMissing << " missing cells)" << endl;
+		exit(EXIT_SUCCESS);
+	}
+
+	if (o.bNJ)
+	{
+		// Tree from the distance matrix
+		Profile<NTree> d;
+		ifstream f (o.fname);
+		d.ReadTrees (f);
+		f.close ();
+		if (!d.GetDistances())
+		{
+			cerr << "No DISTANCES block in \"" << o.fname << "\", bailing out" << endl;
+			exit(0);
+		}
+		vector<string> labels;
+		for (int i = 0; i < d.GetTaxa()->GetNumTaxonLabels(); i++)
+			labels.push_back (d.GetTaxa()->GetTaxonLabel (i));
+		NeighbourJoining nj;
+		nj.SetBIONJ (o.bBIONJ);
+		if (!nj.ReadDistances (*d.GetDistances(), labels))
+		{
+			cerr << "Distances missing, bailing out" << endl;
+			exit(0);
+		}
+		nj.Compute ();
+		ofstream tf (o.njfname);
+		tf << "#nexus" << endl << endl << "begin trees;" << endl;
+		tf << "\ttree " << (o.bBIONJ ? "bionj" : "nj") << " = [&U] ";
+		nj.WriteNewick (tf);
+		tf << endl << "end;" << endl;
+		tf.close ();
+		cout << "joined " << nj.GetNumTaxa() << " taxa, tree written to " << o.njfname << endl;
+		exit(EXIT_SUCCESS);
+	}
+
+    Profile<NTree> p;
+    if (!ReadProfile (o, p))
+    {
+        cerr << "Failed to read trees, bailing out" << endl;
+        exit(0);
+    }
+
+	if (o.bMR || o.bGreedy)
+	{
+		// Supertree built from the clusters of all the trees read
+		CandidateClusters candidates (p.GetNumLabels());
+		LabelSupport labelSupport;
+		OutgroupRooting rooting (o.outgroup, &p, &cout);
+		for (int j = 0; j < p.GetNumTrees(); j++)
+		{
+			NTree t = p.GetIthTree (j);
+			t.MakeNodeList ();
+			for (int jset = 0; jset < t.GetNumLeaves(); jset++)
+				t[jset]->SetLabelNumber (p.GetIndexOfLabel (t[jset]->GetLabel()) + 1);
+			TreeIndex t_index;
+			t_index.Build (t, p.GetNumLabels());
+			if (o.bCollapse)
+				labelSupport.Read (t);
+			if (o.bOutgroup)
+				rooting.Reroot (j + 1, t_index, o.bCollapse ? &labelSupport : NULL);
+			if (o.bCollapse)
+				labelSupport.Collapse (t_index, o.collapseThreshold);
+			candidates.AddTree (t_index);
+		}
+		candidates.Count ();
+		if (o.bOutgroup)
+			rooting.Report (cout);
+
+		vector<string> taxonLabels;
+		for (int k = 0; k < p.GetNumLabels(); k++)
+			taxonLabels.push_back (p.GetLabelFromIndex (k));
+		TreeIndex st_index;
+		vector<int> node;
+		const char *name;
+		if (o.bMR)
+		{
+			MajorityRuleSupertree mr (&candidates);
+			mr.Compute (o.bMRPlus);
+			mr.BuildIndex (st_index, node);
+			name = o.bMRPlus ? "mr_plus" : "mr_minus";
+			cout << candidates.GetNumCandidates() << " candidate clusters, " << mr.GetNumMajority()
+				<< " with S > Q (" << mr.GetNumContested() << " contested); "
+				<< (o.bMRPlus ? "MR(+)" : "MR(-)") << " supertree has " << mr.GetNumClusters()
+				<< " clusters, written to " << o.supertreefname << endl;
+		}
+		else
+		{
+			GreedySupertree greedy (&candidates);
+			greedy.SetOrder (o.greedyOrder);
+			greedy.Compute ();
+			greedy.BuildIndex (st_index, node);
+			name = "greedy";
+			char rejectedfname[FILENAME_SIZE + 9];
+			sprintf (rejectedfname, "%s.rejected", o.supertreefname);
+			ofstream rf (rejectedfname);
+			greedy.Report (rf, taxonLabels);
+			rf.close ();
+			cout << candidates.GetNumCandidates() << " candidate clusters; greedy supertree has "
+				<< greedy.GetNumClusters() << " clusters, written to " << o.supertreefname << "; "
+				<< greedy.GetNumRejected() << " rejected, listed in " << rejectedfname << endl;
+		}
+
+		// The supertree followed by the input trees, ready to be scored
+		ofstream tf (o.supertreefname);
+		BufferedTreeWriter w (&tf);
+		w.SetLabels (taxonLabels);
+		w.Write ("#nexus\n\nbegin trees;\n\ttree ");
+		w.Write (name);
+		w.Write (" = [&R] ");
+		w.WriteTree (st_index);
+		w.Write ('\n');
+		for (int j = 0; j < p.GetNumTrees(); j++)
+		{
+			NTree t = p.GetIthTree (j);
+			w.Write ("\ttree ");
+			if (t.GetName() != "")
+				w.Write (NEXUSString (t.GetName()));
+			else
+			{
+				w.Write ("input_");
+				w.WriteInteger (j + 1);
+			}
+			w.Write (t.IsRooted() ? " = [&R] " : " = [&U] ");
+			w.WriteTree (t);
+			w.Write ('\n');
+		}
+		w.Write ("end;\n");
+		w.Flush ();
+		tf.close ();
+		exit(EXIT_SUCCESS);
+	}
 
+	Analyse (p, o, cout);
   
     return 0;
 }
@@ -0,0 +1,303 @@
+#include "mast.h"
+
+#include <algorithm>
+#include <climits>
+
+/**
+ * @class AgreementTree
+ * An induced subtree with its children stored contiguously and its leaves
+ * labelled by their position in the sorted list of shared taxa.
+ */
+class AgreementTree
+{
+public:
+	int NumNodes;
+	std::vector<int> Leaf;
+	std::vector<int> ChildStart;
+	std::vector<int> Children;
+
+	AgreementTree (const TreeIndex &host, const InducedSubtree &s, const std::vector<int> &taxa)
+	{
+		NumNodes = s.GetNumNodes ();
+		Leaf.assign (NumNodes, -1);
+		ChildStart.assign (NumNodes + 1, 0);
+		for (int r = 0; r < NumNodes; r++)
+		{
+			int h = s.Host[r];
+			if (host.IsLeaf (h))
+				Leaf[r] = (int)(std::lower_bound (taxa.begin(), taxa.end(), host.GetTaxon (h)) - taxa.begin());
+			if (s.Parent[r] != -1)
+				ChildStart[s.Parent[r] + 1]++;
+		}
+		for (int r = 0; r < NumNodes; r++)
+			ChildStart[r + 1] += ChildStart[r];
+		Children.resize (ChildStart[NumNodes]);
+		std::vector<int> next (ChildStart.begin(), ChildStart.end() - 1);
+		for (int r = 0; r < NumNodes; r++)
+			if (s.Parent[r] != -1)
+				Children[next[s.Parent[r]]++] = r;
+	}
+	int GetDegree (int r) const { return ChildStart[r + 1] - ChildStart[r]; };
+	int GetChild (int r, int i) const { return Children[ChildStart[r] + i]; };
+};
+
+//------------------------------------------------------------------------------
+// Maximum weight matching in a rows x cols matrix (rows <= cols) of
+// non-negative weights, using the Hungarian algorithm with potentials
+// (Kuhn 1955; Munkres 1957). Every row is matched, which does not change
+// the maximum as the weights are non-negative.
+static int MaxWeightMatching (const std::vector<int> &w, int rows, int cols, std::vector<int> &match)
+{
+	std::vector<int> u (rows + 1, 0), v (cols + 1, 0), p (cols + 1, 0), way (cols + 1, 0);
+	for (int i = 1; i <= rows; i++)
+	{
+		p[0] = i;
+		int j0 = 0;
+		std::vector<int> minv (cols + 1, INT_MAX);
+		std::vector<bool> used (cols + 1, false);
+		do
+		{
+			used[j0] = true;
+			int i0 = p[j0], delta = INT_MAX, j1 = 0;
+			for (int j = 1; j <= cols; j++)
+			{
+				if (used[j])
+					continue;
+				int cur = -w[(i0 - 1) * cols + (j - 1)] - u[i0] - v[j];
+				if (cur < minv[j])
+				{
+					minv[j] = cur;
+					way[j] = j0;
+				}
+				if (minv[j] < delta)
+				{
+					delta = minv[j];
+					j1 = j;
+				}
+			}
+			for (int j = 0; j <= cols; j++)
+			{
+				if (used[j])
+				{
+					u[p[j]] += delta;
+					v[j] -= delta;
+				}
+				else
+					minv[j] -= delta;
+			}
+			j0 = j1;
+		} while (p[j0] != 0);
+		do
+		{
+			int j1 = way[j0];
+			p[j0] = p[j1];
+			j0 = j1;
+		} while (j0 != 0);
+	}
+
+	int total = 0;
+	match.assign (rows, -1);
+	for (int j = 1; j <= cols; j++)
+	{
+		if (p[j] != 0)
+		{
+			match[p[j] - 1] = j - 1;
+			total += w[(p[j] - 1) * cols + (j - 1)];
+		}
+	}
+	return total;
+}
+
+//------------------------------------------------------------------------------
+// Best matching of the children of a (in A) and b (in B), given the MAST
+// table M. On return pairs holds the matched (child of a, child of b).
+static int MatchChildren (const AgreementTree &A, const AgreementTree &B, const std::vector<int> &M,
+	int a, int b, std::vector<int> *pairs)
+{
+	int da = A.GetDegree (a);
+	int db = B.GetDegree (b);
+	int nb = B.NumNodes;
+	if ((da == 2) && (db == 2))
+	{
+		int a1 = A.GetChild (a, 0), a2 = A.GetChild (a, 1);
+		int b1 = B.GetChild (b, 0), b2 = B.GetChild (b, 1);
+		int straight = M[a1 * nb + b1] + M[a2 * nb + b2];
+		int crossed = M[a1 * nb + b2] + M[a2 * nb + b1];
+		if (pairs)
+		{
+			pairs->clear ();
+			pairs->push_back (a1);
+			pairs->push_back ((straight >= crossed) ? b1 : b2);
+			pairs->push_back (a2);
+			pairs->push_back ((straight >= crossed) ? b2 : b1);
+		}
+		return std::max (straight, crossed);
+	}
+
+	// Put the side with fewer children on the rows
+	bool flip = (da > db);
+	int rows = flip ? db : da;
+	int cols = flip ? da : db;
+	std::vector<int> w (rows * cols);
+	for (int i = 0; i < da; i++)
+		for (int j = 0; j < db; j++)
+		{
+			int m = M[A.GetChild (a, i) * nb + B.GetChild (b, j)];
+			if (flip)
+				w[j * cols + i] = m;
+			else
+				w[i * cols + j] = m;
+		}
+	std::vector<int> match;
+	int total = MaxWeightMatching (w, rows, cols, match);
+	if (pairs)
+	{
+		pairs->clear ();
+		for (int i = 0; i < rows; i++)
+		{
+			pairs->push_back (A.GetChild (a, flip ? match[i] : i));
+			pairs->push_back (B.GetChild (b, flip ? i : match[i]));
+		}
+	}
+	return total;
+}
+
+//------------------------------------------------------------------------------
+int AgreementSubtrees::ComputeTree (const TreeIndex &t, int &shared, std::vector<int> &pruned) const
+{
+	// Taxa in both trees
+	std::vector<int> taxa;
+	for (int k = 0; k < t.GetNumLeaves(); k++)
+	{
+		int x = t.GetTaxon (t.GetLeafAtRank (k));
+		if ((x >= 0) && (x < ST->GetNumTaxa()) && (ST->GetLeafOfTaxon (x) != -1))
+			taxa.push_back (x);
+	}
+	std::sort (taxa.begin(), taxa.end());
+	taxa.erase (std::unique (taxa.begin(), taxa.end()), taxa.end());
+	shared = (int)taxa.size();
+	pruned.clear ();
+	if (shared == 0)
+		return 0;
+
+	std::vector<int> leaves1, leaves2;
+	for (int k = 0; k < shared; k++)
+	{
+		leaves1.push_back (t.GetLeafOfTaxon (taxa[k]));
+		leaves2.push_back (ST->GetLeafOfTaxon (taxa[k]));
+	}
+	InducedSubtree s1, s2;
+	t.Induce (leaves1, s1);
+	ST->Induce (leaves2, s2);
+	AgreementTree A (t, s1, taxa);
+	AgreementTree B (*ST, s2, taxa);
+
+	// M[a * nb + b] is the size of the MAST of the subtrees below a and b.
+	// Both trees are in postorder, so children are done before parents.
+	int na = A.NumNodes;
+	int nb = B.NumNodes;
+	std::vector<int> M (na * nb, 0);
+	for (int a = 0; a < na; a++)
+	{
+		for (int b = 0; b < nb; b++)
+		{
+			int best = 0;
+			if ((A.Leaf[a] != -1) && (B.Leaf[b] != -1))
+				best = (A.Leaf[a] == B.Leaf[b]) ? 1 : 0;
+			else
+			{
+				for (int j = 0; j < B.GetDegree (b); j++)
+					best = std::max (best, M[a * nb + B.GetChild (b, j)]);
+				for (int i = 0; i < A.GetDegree (a); i++)
+					best = std::max (best, M[A.GetChild (a, i) * nb + b]);
+				if ((A.Leaf[a] == -1) && (B.Leaf[b] == -1))
+					best = std::max (best, MatchChildren (A, B, M, a, b, NULL));
+			}
+			M[a * nb + b] = best;
+		}
+	}
+	int size = M[na * nb - 1];
+
+	// Trace back the taxa in one MAST
+	std::vector<bool> kept (shared, false);
+	std::vector<int> stack, pairs;
+	stack.push_back (na - 1);
+	stack.push_back (nb - 1);
+	while (!stack.empty())
+	{
+		int b = stack.back ();
+		stack.pop_back ();
+		int a = stack.back ();
+		stack.pop_back ();
+		int m = M[a * nb + b];
+		if (m == 0)
+			continue;
+		if ((A.Leaf[a] != -1) && (B.Leaf[b] != -1))
+		{
+			kept[A.Leaf[a]] = true;
+			continue;
+		}
+		bool found = false;
+		for (int j = 0; (j < B.GetDegree (b)) && !found; j++)
+			if (M[a * nb + B.GetChild (b, j)] == m)
+			{
+				stack.push_back (a);
+				stack.push_back (B.GetChild (b, j));
+				found = true;
+			}
+		for (int i = 0; (i < A.GetDegree (a)) && !found; i++)
+			if (M[A.GetChild (a, i) * nb + b] == m)
+			{
+				stack.push_back (A.GetChild (a, i));
+				stack.push_back (b);
+				found = true;
+			}
+		if (!found)
+		{
+			MatchChildren (A, B, M, a, b, &pairs);
+			for (int k = 0; k < (int)pairs.size(); k += 2)
+			{
+				stack.push_back (pairs[k]);
+				stack.push_back (pairs[k + 1]);
+			}
+		}
+	}
+	for (int k = 0; k < shared; k++)
+		if (!kept[k])
+			pruned.push_back (taxa[k]);
+	return size;
+}
+
+//------------------------------------------------------------------------------
+void AgreementSubtrees::Compute (const std::vector<TreeIndex> &trees)
+{
+	int n = (int)trees.size();
+	Shared.assign (n, 0);
+	Size.assign (n, 0);
+	Pruned.assign (n, std::vector<int>());
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic)
+#endif
+	for (int k = 0; k < n; k++)
+		Size[k] = ComputeTree (trees[k], Shared[k], Pruned[k]);
+}
+
+//------------------------------------------------------------------------------
+void AgreementSubtrees::Report (std::ostream &f, const std::vector<std::string> &labels) const
+{
+	int shared = 0, size = 0;
+	for (int k = 0; k < GetNumTrees(); k++)
+	{
+		f << k + 1 << "\t" << Shared[k] << "\t" << Size[k] << "\t";
+		for (int i = 0; i < (int)Pruned[k].size(); i++)
+		{
+			if (i > 0)
+				f << ",";
+			f << labels[Pruned[k][i]];
+		}
+		f << std::endl;
+		shared += Shared[k];
+		size += Size[k];
+	}
+	f << "Total\t" << shared << "\t" << size << "\t" << shared - size << std::endl;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file mast.h
+ *
+ * Maximum agreement subtree of the supertree and each input tree.
+ *
+ */
+
+#ifndef MASTH
+#define MASTH
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "treeindex.h"
+
+/**
+ * @class AgreementSubtrees
+ * For each input tree, finds the maximum agreement subtree (MAST) of that
+ * tree and the supertree, both restricted to the taxa they share, and so
+ * the smallest set of taxa that must be pruned from the input tree for
+ * it to agree with the supertree.
+ *
+ * Uses the dynamic programming algorithm of Steel and Warnow (1993, Inf.
+ * Process. Lett. 48:77-82) on the two induced subtrees. The MAST of the
+ * subtrees below nodes a and b is the largest of the MASTs of a with a
+ * child of b, of b with a child of a, and of a maximum weight matching
+ * between the children of a and of b. For binary trees the matching is a
+ * choice between two pairings, giving O(n^2) time and space for trees
+ * with n shared taxa; for polytomies the matching is solved with the
+ * Hungarian algorithm, which is cheap when the degree is bounded.
+ *
+ * Input trees must have had BuildLCA called. If compiled with OpenMP the
+ * input trees are shared between threads.
+ */
+class AgreementSubtrees
+{
+public:
+	/**
+	 * @param supertree the indexed supertree. BuildLCA must have been called.
+	 */
+	AgreementSubtrees (const TreeIndex *supertree) { ST = supertree; };
+	virtual ~AgreementSubtrees () {};
+
+	/**
+	 * Compute the MAST of the supertree and each input tree.
+	 * @param trees the indexed input trees
+	 */
+	virtual void Compute (const std::vector<TreeIndex> &trees);
+
+	int GetNumTrees () const { return (int)Size.size(); };
+	/**
+	 * @return the number of taxa the kth input tree shares with the supertree
+	 */
+	int GetNumShared (int k) const { return Shared[k]; };
+	/**
+	 * @return the number of leaves in the MAST for the kth input tree
+	 */
+	int GetSize (int k) const { return Size[k]; };
+	/**
+	 * @return the shared taxa not in the MAST for the kth input tree
+	 */
+	const std::vector<int> &GetPruned (int k) const { return Pruned[k]; };
+
+	/**
+	 * Write one line per input tree: the tree number, the number of shared
+	 * taxa, the MAST size and the pruned taxa, followed by the totals.
+	 * @param f output stream
+	 * @param labels taxon labels, indexed by taxon
+	 */
+	virtual void Report (std::ostream &f, const std::vector<std::string> &labels) const;
+
+protected:
+	const TreeIndex *ST;
+	std::vector<int> Shared;
+	std::vector<int> Size;
+	std::vector< std::vector<int> > Pruned;
+
+	/**
+	 * Compute the MAST of the supertree and input tree t.
+	 * @param t the input tree
+	 * @param shared number of taxa in both trees
+	 * @param pruned the shared taxa not in the MAST, in increasing order
+	 * @return the size of the MAST
+	 */
+	virtual int ComputeTree (const TreeIndex &t, int &shared, std::vector<int> &pruned) const;
+};
+
+#endif
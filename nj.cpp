@@ -0,0 +1,366 @@
+#include "nj.h"
+#include "treebuffer.h"
+
+// NCL includes
+#include "nexusdefs.h"
+#include "xnexus.h"
+#include "nexustoken.h"
+#include "nexus.h"
+#include "taxablock.h"
+#include "distancedatum.h"
+#include "distancesblock.h"
+
+#include <algorithm>
+#include <sstream>
+
+/**
+ * @class DistanceLess
+ * Orders the columns of a row by distance, then by column.
+ */
+class DistanceLess
+{
+public:
+	DistanceLess (const std::vector<float> *r) { row = r; };
+	bool operator() (int a, int b) const
+	{
+		if ((*row)[a] != (*row)[b])
+			return (*row)[a] < (*row)[b];
+		return a < b;
+	};
+protected:
+	const std::vector<float> *row;
+};
+
+//------------------------------------------------------------------------------
+void NeighbourJoining::Assign (const std::vector<std::string> &labels, const std::vector<float> &distances)
+{
+	NumTaxa = (int)labels.size();
+	Labels = labels;
+	int total = (NumTaxa > 2) ? 2 * NumTaxa - 2 : NumTaxa + 1;
+	D.assign (total, std::vector<float>());
+	V.assign (BIONJ ? total : 0, std::vector<float>());
+	for (int i = 0; i < NumTaxa; i++)
+	{
+		D[i].assign (distances.begin() + (size_t)i * (i - 1) / 2, distances.begin() + (size_t)i * (i + 1) / 2);
+		if (BIONJ)
+			V[i] = D[i];
+	}
+}
+
+//------------------------------------------------------------------------------
+bool NeighbourJoining::ReadDistances (DistancesBlock &d, const std::vector<std::string> &labels)
+{
+	int n = d.GetNtax ();
+	std::vector<float> distances ((size_t)n * (n - 1) / 2);
+	for (int i = 0; i < n; i++)
+	{
+		for (int j = 0; j < i; j++)
+		{
+			if (!d.IsMissing (i, j))
+				distances[(size_t)i * (i - 1) / 2 + j] = (float)d.GetDistance (i, j);
+			else if (!d.IsMissing (j, i))
+				distances[(size_t)i * (i - 1) / 2 + j] = (float)d.GetDistance (j, i);
+			else
+				return false;
+		}
+	}
+	std::vector<std::string> l (labels);
+	l.resize (n);
+	Assign (l, distances);
+	return true;
+}
+
+//------------------------------------------------------------------------------
+void NeighbourJoining::SortRow (int a)
+{
+	std::vector<int> &s = Sorted[a];
+	s.clear ();
+	for (int k = 0; k < a; k++)
+		if (Active[k])
+			s.push_back (k);
+	std::sort (s.begin(), s.end(), DistanceLess (&D[a]));
+}
+
+//------------------------------------------------------------------------------
+void NeighbourJoining::Compute ()
+{
+	int n = NumTaxa;
+	int total = (int)D.size();
+	Parent.assign (total, -1);
+	Length.assign (total, 0.0);
+	Active.assign (total, false);
+	Sorted.assign (total, std::vector<int>());
+	Sum.assign (total, 0.0);
+	if (n < 2)
+		return;
+	if (n == 2)
+	{
+		Parent[0] = Parent[1] = 2;
+		Length[0] = Length[1] = 0.5 * D[1][0];
+		return;
+	}
+
+	std::vector<int> active;
+	for (int i = 0; i < n; i++)
+	{
+		Active[i] = true;
+		active.push_back (i);
+		for (int j = 0; j < i; j++)
+		{
+			Sum[i] += D[i][j];
+			Sum[j] += D[i][j];
+		}
+	}
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic, 16)
+#endif
+	for (int i = 0; i < n; i++)
+		SortRow (i);
+
+	std::vector<double> u (total, 0.0);
+	int r = n;
+	int compacted = n;
+	while (r > 3)
+	{
+		// Net divergence of each row
+		double umax = -1e300;
+		for (int t = 0; t < r; t++)
+		{
+			int k = active[t];
+			u[k] = Sum[k] / (double)(r - 2);
+			if (u[k] > umax)
+				umax = u[k];
+		}
+
+		// Minimise Q = d(a,b) - u(a) - u(b) over pairs, row a after b.
+		// Ties go to the lowest (a, b) so the tree doesn't depend on the
+		// number of threads.
+		double bestQ = 1e300;
+		int bestA = -1, bestB = -1;
+#ifdef _OPENMP
+		#pragma omp parallel
+#endif
+		{
+			double q = 1e300;
+			int qa = -1, qb = -1;
+#ifdef _OPENMP
+			#pragma omp for schedule(dynamic, 16)
+#endif
+			for (int t = 0; t < r; t++)
+			{
+				int a = active[t];
+				const std::vector<float> &row = D[a];
+				const std::vector<int> &s = Sorted[a];
+				double ua = u[a];
+				for (int k = 0; k < (int)s.size(); k++)
+				{
+					int b = s[k];
+					if (!Active[b])
+						continue;
+					double d = row[b];
+					if (d - ua - umax > q)
+						break;
+					double x = d - ua - u[b];
+					if ((x < q) || ((x == q) && ((a < qa) || ((a == qa) && (b < qb)))))
+					{
+						q = x;
+						qa = a;
+						qb = b;
+					}
+				}
+			}
+#ifdef _OPENMP
+			#pragma omp critical
+#endif
+			{
+				if ((qa != -1) && ((q < bestQ) || ((q == bestQ) && ((qa < bestA) || ((qa == bestA) && (qb < bestB))))))
+				{
+					bestQ = q;
+					bestA = qa;
+					bestB = qb;
+				}
+			}
+		}
+
+		Join (bestA, bestB, r, active);
+		int c = n + (n - r);
+		for (int t = 0; t < (int)active.size(); )
+		{
+			if ((active[t] == bestA) || (active[t] == bestB))
+			{
+				active[t] = active.back();
+				active.pop_back();
+			}
+			else
+				t++;
+		}
+		active.push_back (c);
+		r--;
+
+		// Drop the entries for joined rows once half the rows have gone
+		if (2 * r < compacted)
+		{
+#ifdef _OPENMP
+			#pragma omp parallel for schedule(dynamic, 16)
+#endif
+			for (int t = 0; t < r; t++)
+			{
+				std::vector<int> &s = Sorted[active[t]];
+				int m = 0;
+				for (int k = 0; k < (int)s.size(); k++)
+					if (Active[s[k]])
+						s[m++] = s[k];
+				s.resize (m);
+			}
+			compacted = r;
+		}
+	}
+
+	// Join the last three rows at the root
+	int a = active[0], b = active[1], c = active[2];
+	int root = total - 1;
+	Length[a] = 0.5 * (Distance (a, b) + Distance (a, c) - Distance (b, c));
+	Length[b] = 0.5 * (Distance (a, b) + Distance (b, c) - Distance (a, c));
+	Length[c] = 0.5 * (Distance (a, c) + Distance (b, c) - Distance (a, b));
+	Parent[a] = Parent[b] = Parent[c] = root;
+}
+
+//------------------------------------------------------------------------------
+void NeighbourJoining::Join (int a, int b, int r, const std::vector<int> &active)
+{
+	int c = NumTaxa + (NumTaxa - r);
+	double dab = Distance (a, b);
+	double la = 0.5 * dab + (Sum[a] - Sum[b]) / (2.0 * (r - 2));
+	double lb = dab - la;
+
+	double lambda = 0.5;
+	double vab = 0.0;
+	if (BIONJ)
+	{
+		vab = Variance (a, b);
+		if (vab > 0.0)
+		{
+			double s = 0.0;
+			for (int t = 0; t < r; t++)
+			{
+				int k = active[t];
+				if ((k != a) && (k != b))
+					s += Variance (b, k) - Variance (a, k);
+			}
+			lambda = 0.5 + s / (2.0 * (r - 2) * vab);
+			if (lambda < 0.0)
+				lambda = 0.0;
+			if (lambda > 1.0)
+				lambda = 1.0;
+		}
+		V[c].assign (c, 0.0f);
+	}
+
+	D[c].assign (c, 0.0f);
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(static)
+#endif
+	for (int t = 0; t < r; t++)
+	{
+		int k = active[t];
+		if ((k == a) || (k == b))
+			continue;
+		double dak = Distance (a, k);
+		double dbk = Distance (b, k);
+		double dck;
+		if (BIONJ)
+		{
+			dck = lambda * (dak - la) + (1.0 - lambda) * (dbk - lb);
+			V[c][k] = (float)(lambda * Variance (a, k) + (1.0 - lambda) * Variance (b, k) - lambda * (1.0 - lambda) * vab);
+		}
+		else
+			dck = 0.5 * (dak + dbk - dab);
+		D[c][k] = (float)dck;
+		Sum[k] += D[c][k] - dak - dbk;
+	}
+	for (int t = 0; t < r; t++)
+	{
+		int k = active[t];
+		if ((k != a) && (k != b))
+			Sum[c] += D[c][k];
+	}
+
+	Parent[a] = Parent[b] = c;
+	Length[a] = la;
+	Length[b] = lb;
+	Active[a] = Active[b] = false;
+	Active[c] = true;
+	std::vector<float>().swap (D[a]);
+	std::vector<float>().swap (D[b]);
+	if (BIONJ)
+	{
+		std::vector<float>().swap (V[a]);
+		std::vector<float>().swap (V[b]);
+	}
+	std::vector<int>().swap (Sorted[a]);
+	std::vector<int>().swap (Sorted[b]);
+	SortRow (c);
+}
+
+//------------------------------------------------------------------------------
+void NeighbourJoining::WriteSubtree (BufferedTreeWriter &w, int root)
+{
+	std::vector< std::vector<int> > children (Parent.size());
+	for (int k = 0; k < (int)Parent.size(); k++)
+		if (Parent[k] != -1)
+			children[Parent[k]].push_back (k);
+
+	// Depth first, with the next child of each node on the path
+	std::vector<int> path, next;
+	path.push_back (root);
+	next.push_back (0);
+	while (!path.empty())
+	{
+		int p = path.back();
+		if (p < NumTaxa)
+		{
+			w.Write (NEXUSString (Labels[p]));
+			next.back() = 1;
+		}
+		else if (next.back() < (int)children[p].size())
+		{
+			w.Write (next.back() == 0 ? '(' : ',');
+			path.push_back (children[p][next.back()++]);
+			next.push_back (0);
+			continue;
+		}
+		else
+			w.Write (')');
+		if (p != root)
+		{
+			w.Write (':');
+			w.WriteReal (Length[p]);
+		}
+		path.pop_back ();
+		next.pop_back ();
+	}
+	w.Write (';');
+}
+
+//------------------------------------------------------------------------------
+void NeighbourJoining::WriteNewick (std::ostream &f)
+{
+	BufferedTreeWriter w (&f);
+	if (NumTaxa == 1)
+	{
+		w.Write (NEXUSString (Labels[0]));
+		w.Write (';');
+	}
+	else if (NumTaxa > 1)
+		WriteSubtree (w, (int)Parent.size() - 1);
+	w.Flush ();
+}
+
+//------------------------------------------------------------------------------
+void NeighbourJoining::GetTree (Tree &t)
+{
+	std::ostringstream s;
+	WriteNewick (s);
+	t.Parse (s.str().c_str());
+	t.SetRooted (false);
+}
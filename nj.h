@@ -0,0 +1,124 @@
+/**
+ * @file nj.h
+ *
+ * Neighbour-joining and BIONJ trees from distance matrices.
+ *
+ */
+
+#ifndef NJH
+#define NJH
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "TreeLib.h"
+
+class DistancesBlock;
+class BufferedTreeWriter;
+
+/**
+ * @class NeighbourJoining
+ * Builds a neighbour-joining tree (Saitou and Nei 1987, Mol. Biol. Evol.
+ * 4:406-425) or a BIONJ tree (Gascuel 1997, Mol. Biol. Evol. 14:685-695)
+ * from a matrix of distances between taxa.
+ *
+ * The pair to join is found as in RapidNJ (Simonsen et al. 2008, LNBI
+ * 5251:113-122). Each row of the distance matrix keeps its columns sorted
+ * by distance, so the search of a row can stop as soon as the distance
+ * minus the row's own divergence and the largest divergence of any row
+ * exceeds the best value found so far, which usually happens after a few
+ * columns. A joined pair becomes a new row after all the existing ones,
+ * so every pair lies in the row of its later member and each row need
+ * only hold the distances to the rows before it. Rows are searched in
+ * parallel if compiled with OpenMP.
+ *
+ * Distances are stored as floats, so the matrix for n taxa takes about
+ * 4n^2 bytes (8n^2 for BIONJ, which also keeps the variances).
+ */
+class NeighbourJoining
+{
+public:
+	NeighbourJoining () { BIONJ = false; NumTaxa = 0; };
+	virtual ~NeighbourJoining () {};
+
+	/**
+	 * Use the BIONJ reduction of the distances rather than the
+	 * neighbour-joining one.
+	 */
+	virtual void SetBIONJ (bool on) { BIONJ = on; };
+	/**
+	 * Set the distances.
+	 * @param labels the taxa
+	 * @param distances the distance between taxa i and j (i > j) at
+	 * i(i - 1)/2 + j
+	 */
+	virtual void Assign (const std::vector<std::string> &labels, const std::vector<float> &distances);
+	/**
+	 * Read the distances of a DISTANCES block. If the distance from i to j
+	 * is missing that from j to i is used.
+	 * @param d the block
+	 * @param labels the taxa, in the order of the block
+	 * @return false if a distance is missing both ways
+	 */
+	virtual bool ReadDistances (DistancesBlock &d, const std::vector<std::string> &labels);
+
+	/**
+	 * Join the taxa. The tree is unrooted, i.e. has three subtrees at its
+	 * root.
+	 */
+	virtual void Compute ();
+	/**
+	 * Build the tree, with edge lengths.
+	 */
+	virtual void GetTree (Tree &t);
+	/**
+	 * Write the tree in Newick format, ending in ";".
+	 */
+	virtual void WriteNewick (std::ostream &f);
+
+	int GetNumTaxa () const { return NumTaxa; };
+
+protected:
+	bool BIONJ;
+	int NumTaxa;
+	std::vector<std::string> Labels;
+	/**
+	 * For each row (taxa first, then joined pairs in order) the distances to
+	 * all earlier rows, and for BIONJ the variances
+	 */
+	std::vector< std::vector<float> > D;
+	std::vector< std::vector<float> > V;
+	/**
+	 * Earlier rows in order of increasing distance
+	 */
+	std::vector< std::vector<int> > Sorted;
+	/**
+	 * Sum of the distances from each row to the other active rows
+	 */
+	std::vector<double> Sum;
+	std::vector<bool> Active;
+	/**
+	 * The tree: parent of each row, and length of the edge above it
+	 */
+	std::vector<int> Parent;
+	std::vector<double> Length;
+
+	float Distance (int a, int b) const { return (a > b) ? D[a][b] : D[b][a]; };
+	float Variance (int a, int b) const { return (a > b) ? V[a][b] : V[b][a]; };
+	/**
+	 * Sort the entries of row a for the active rows before it.
+	 */
+	virtual void SortRow (int a);
+	/**
+	 * Add a row for the join of rows a and b, which have r - 2 other
+	 * active rows
+	 */
+	virtual void Join (int a, int b, int r, const std::vector<int> &active);
+	/**
+	 * Write the description of the subtree rooted at row a.
+	 */
+	virtual void WriteSubtree (BufferedTreeWriter &w, int a);
+};
+
+#endif
@@ -45,6 +45,8 @@
 
 #include "treereader.h"
 #include "treewriter.h"
+#include "treefileindex.h"
+#include "treebuffer.h"
 
 // NCL includes
 #include "nexusdefs.h"
@@ -58,6 +60,8 @@
 #include "discretematrix.h"
 #include "charactersblock.h"
 #include "datablock.h"
+#include "distancedatum.h"
+#include "distancesblock.h"
 
 #if USE_VC2
 	#include "VMsg.h"
@@ -100,7 +104,7 @@ public:
 	/**
 	 * Constructor
 	 */
-	Profile () {};
+	Profile () { Taxa = NULL; Characters = NULL; Distances = NULL; };
 	/**
 	 * Destructor
 	 */
@@ -124,6 +128,20 @@ public:
 	 * @return The number of labels in the profile
 	 */
 	virtual int GetNumLabels () { return Labels.size(); };
+	/**
+	 * @return The CHARACTERS (or DATA) block read with the trees, or NULL
+	 * if the file had no characters
+	 */
+	virtual CharactersBlock *GetCharacters () { return Characters; };
+	/**
+	 * @return The DISTANCES block read with the trees, or NULL if the file
+	 * had no distances
+	 */
+	virtual DistancesBlock *GetDistances () { return Distances; };
+	/**
+	 * @return The TAXA block of the last NEXUS file read, or NULL
+	 */
+	virtual TaxaBlock *GetTaxa () { return Taxa; };
 	/**
 	 * @return The number of trees in the profile
 	 */
@@ -176,6 +194,18 @@ public:
 	 * @return true if successful
 	 */
 	virtual bool ReadTrees (istream &f);
+	/**
+	 * @brief Read selected trees from a file, seeking straight to each using
+	 * an index of the file
+	 *
+	 * Leaf labels are indexed by Profile::MakeLabelList, in the order they
+	 * occur in the trees read.
+	 * @param f input stream of the indexed file
+	 * @param index the index of the file
+	 * @param which the trees to read, numbered from 0 in the file
+	 * @return true if successful
+	 */
+	virtual bool ReadIndexedTrees (istream &f, TreeFileIndex &index, const vector<int> &which);
 	/**
 	 * @brief Output leaf labels.
 	 *
@@ -192,7 +222,8 @@ public:
 	/**
 	 * @brief Write a set of trees to an output stream
 	 * @param f output stream 
-	 * @param format file format to use (at present nexus only)
+	 * @param format file format to use (at present nexus only): 0 writes
+	 * leaf labels in full, 1 writes a TRANSLATE command and leaf numbers
 	 * @return true if successful
 	 */
 	virtual bool WriteTrees (ostream &f, const int format = 0, const char *endOfLine = "\n");
@@ -208,6 +239,13 @@ protected:
 	 *
 	 */
 	vector <string> LabelIndex;
+	/**
+	 * Taxa, character data and distances read with the trees. Like the
+	 * other NEXUS blocks they are not freed.
+	 */
+	TaxaBlock *Taxa;
+	CharactersBlock *Characters;
+	DistancesBlock *Distances;
 };
 
 
@@ -380,18 +418,21 @@ template <class T> bool Profile<T>::ReadNEXUS (istream &f)
 	CharactersBlock *characters;
 	AssumptionsBlock *assumptions;
 	TreesBlock *trees;
+	DistancesBlock *distances;
 
 	taxa = new TaxaBlock();
 	assumptions = new AssumptionsBlock (*taxa);
 	data = new DataBlock (*taxa, *assumptions);
 	characters = new CharactersBlock (*taxa, *assumptions);
 	trees = new TreesBlock (*taxa);
+	distances = new DistancesBlock (*taxa);
 
 	MyNexus nexus;
 	nexus.Add( taxa );
 	nexus.Add( data );
 	nexus.Add( characters );
 	nexus.Add( trees );
+	nexus.Add( distances );
     
 
 
@@ -412,6 +453,17 @@ template <class T> bool Profile<T>::ReadNEXUS (istream &f)
 		cout << x.msg << " (line " << x.line << ", column " << x.col << ")" << endl;
 	}    	
 
+	if (nexus.GetIsOK())
+	{
+		Taxa = taxa;
+		if (characters->GetNChar() > 0)
+			Characters = characters;
+		else if (data->GetNChar() > 0)
+			Characters = data;
+		if (distances->GetNtax() > 0)
+			Distances = distances;
+	}
+
 	if (nexus.GetIsOK() && (trees->GetNumTrees() > 0))
 	{
 
@@ -495,6 +547,39 @@ template <class T> bool Profile<T>::ReadTrees (istream &f)
 	return result;
 }
 
+//------------------------------------------------------------------------------
+template <class T> bool Profile<T>::ReadIndexedTrees (istream &f, TreeFileIndex &index, const vector<int> &which)
+{
+	for (unsigned int i = 0; i < which.size(); i++)
+	{
+		int k = which[i];
+		if ((k < 0) || (k >= index.GetNumTrees()))
+		{
+			cerr << "No tree " << (k + 1) << " in file" << endl;
+			return false;
+		}
+		std::string tstr;
+		if (!index.ReadTree (f, k, tstr))
+		{
+			cerr << "Error reading tree " << (k + 1) << endl;
+			return false;
+		}
+		T t;
+		if (t.Parse (tstr.c_str()) != 0)
+		{
+			cerr << "Error in tree description " << (k + 1) << t.GetErrorMsg() << endl;
+			return false;
+		}
+		t.SetName (index.GetName (k));
+		t.SetRooted (index.GetRooted (k) == 1);
+		Trees.push_back (t);
+	}
+	bool result = (Trees.size() > 0);
+	if (result)
+		MakeLabelList ();
+	return result;
+}
+
 //------------------------------------------------------------------------------
 template <class T> bool Profile<T>::ReadPHYLIP (istream &f)
 {
@@ -564,15 +649,16 @@ template <class T> void Profile<T>::ShowTrees (ostream &f)
 //------------------------------------------------------------------------------
 template <class T> bool Profile<T>::WriteTrees (ostream &f, const int format, const char *endOfLine)
 {
-	
+	BufferedTreeWriter tw (&f);
 	
 	// Simple nexus tree file
-	f << "#nexus" << endOfLine;
-	f << endOfLine;
-	f << "begin trees;";
+	tw.Write ("#nexus");
+	tw.Write (endOfLine);
+	tw.Write (endOfLine);
+	tw.Write ("begin trees;");
 		
 	// Date the file
-	f << " [Treefile written ";
+	tw.Write (" [Treefile written ");
 	time_t timer = time(NULL);
 	struct tm* tblock = localtime(&timer);
 	char time_buf[64];
@@ -580,31 +666,42 @@ template <class T> bool Profile<T>::WriteTrees (ostream &f, const int format, co
 	char *q = strrchr (time_buf, '\n');
 	if (q)
 		*q = '\0';
-	f << time_buf << "]" << endOfLine;
+	tw.Write (time_buf);
+	tw.Write ("]");
+	tw.Write (endOfLine);
+
+	if (format == 1)
+	{
+		if (LabelIndex.empty())
+			MakeLabelList ();
+		tw.SetLabels (LabelIndex);
+		tw.WriteTranslate (endOfLine);
+	}
 
 	for (unsigned int i = 0; i < Trees.size(); i++)
 	{
-		T t = Trees[i];
-		f << "\ttree ";
+		T &t = Trees[i];
+		tw.Write ("\ttree ");
 		if (t.GetName() != "")
-			f << NEXUSString (t.GetName());
+			tw.Write (NEXUSString (t.GetName()));
 		else
-			f << "tree_" << (i+1);
-		f << " = ";
+		{
+			tw.Write ("tree_");
+			tw.WriteInteger (i + 1);
+		}
+		tw.Write (" = ");
 		if (t.IsRooted())
-			f << "[&R] ";
+			tw.Write ("[&R] ");
 		else
-			f << "[&U] ";
+			tw.Write ("[&U] ");
 			
 		// Tree
-		NewickTreeWriter tw (&t);
-		tw.SetStream (&f);
-		tw.Write();	
-		f << endOfLine;		
-			
-//		f << t << endOfLine;
+		tw.WriteTree (t);
+		tw.Write (endOfLine);
 	}
-	f << "end;" << endOfLine;
+	tw.Write ("end;");
+	tw.Write (endOfLine);
+	tw.Flush ();
 	
 	return true;
 }
@@ -0,0 +1,110 @@
+#include "prune.h"
+#include "treebuffer.h"
+#include "treefileindex.h"
+
+#include <fstream>
+#include <iostream>
+
+//------------------------------------------------------------------------------
+TaxonPruner::TaxonPruner ()
+{
+	MinTaxa = 2;
+	NumRead = NumWritten = 0;
+}
+
+//------------------------------------------------------------------------------
+void TaxonPruner::SetTaxa (const std::vector<std::string> &labels)
+{
+	Labels.clear ();
+	TaxonOfLabel.clear ();
+	for (int k = 0; k < (int)labels.size(); k++)
+	{
+		if (TaxonOfLabel.find (labels[k]) == TaxonOfLabel.end())
+		{
+			TaxonOfLabel[labels[k]] = (int)Labels.size();
+			Labels.push_back (labels[k]);
+		}
+	}
+	Seen.assign (Labels.size(), false);
+}
+
+//------------------------------------------------------------------------------
+int TaxonPruner::Mark (Tree &t)
+{
+	t.MakeNodeList ();
+	int n = t.GetNumNodes ();
+	Kept.assign (n, 0);
+	SeenList.clear ();
+	for (int i = 0; i < t.GetNumLeaves(); i++)
+	{
+		std::map<std::string, int>::const_iterator there = TaxonOfLabel.find (t[i]->GetLabel());
+		if (there == TaxonOfLabel.end())
+			continue;
+		Kept[i] = 1;
+		if (!Seen[there->second])
+		{
+			Seen[there->second] = true;
+			SeenList.push_back (there->second);
+		}
+	}
+	for (int k = 0; k < (int)SeenList.size(); k++)
+		Seen[SeenList[k]] = false;
+
+	// Leaves come first and internal nodes follow in postorder
+	for (int i = 0; i < n; i++)
+		if (t[i]->GetAnc())
+			Kept[t[i]->GetAnc()->GetIndex()] += Kept[i];
+	return (int)SeenList.size();
+}
+
+//------------------------------------------------------------------------------
+bool TaxonPruner::Run (TreeFileIndex &index, const char *infile, const char *outfile)
+{
+	NumRead = NumWritten = 0;
+	std::ifstream f (infile, std::ios::in | std::ios::binary);
+	std::ofstream of (outfile);
+	if (!f || !of)
+		return false;
+
+	BufferedTreeWriter w (&of);
+	w.SetLabels (Labels);
+	w.Write ("#nexus\n\nbegin trees;\n");
+	w.WriteTranslate ();
+	std::string description;
+	bool ok = true;
+	for (int k = 0; k < index.GetNumTrees(); k++)
+	{
+		if (!index.ReadTree (f, k, description))
+		{
+			std::cerr << "Error reading tree " << (k + 1) << std::endl;
+			ok = false;
+			break;
+		}
+		Tree t;
+		if (t.Parse (description.c_str()) != 0)
+		{
+			std::cerr << "Error in tree description " << (k + 1) << t.GetErrorMsg() << std::endl;
+			ok = false;
+			break;
+		}
+		NumRead++;
+		if (Mark (t) < MinTaxa)
+			continue;
+		w.Write ("\ttree ");
+		if (index.GetName (k) != "")
+			w.Write (NEXUSString (index.GetName (k)));
+		else
+		{
+			w.Write ("tree_");
+			w.WriteInteger (k + 1);
+		}
+		w.Write ((index.GetRooted (k) == 1) ? " = [&R] " : " = [&U] ");
+		w.WriteTree (t, Kept);
+		w.Write ('\n');
+		NumWritten++;
+	}
+	w.Write ("end;\n");
+	w.Flush ();
+	of.close ();
+	return ok && !of.fail();
+}
@@ -0,0 +1,92 @@
+/**
+ * @file prune.h
+ *
+ * Restrict every tree in a file to a set of taxa, one tree at a time.
+ *
+ */
+
+#ifndef PRUNEH
+#define PRUNEH
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "TreeLib.h"
+
+class TreeFileIndex;
+
+/**
+ * @class TaxonPruner
+ * Restricts trees to a set of taxa and writes them out, reading the tree
+ * file one tree at a time through its TreeFileIndex, so memory use doesn't
+ * grow with the number of trees (beyond the index's offsets) and each tree
+ * is parsed once.
+ *
+ * The taxa kept are flagged by number, and each leaf's label is looked up
+ * once. Counting the leaves kept below each node in one pass over the node
+ * list (children come before parents) is enough for BufferedTreeWriter to
+ * write the restricted tree directly from the parsed one, skipping the
+ * subtrees with no leaves kept and suppressing nodes left with one child,
+ * so a tree of n nodes is pruned in O(n) time and nothing is copied or
+ * deleted. Trees with fewer than a given number of taxa left are dropped.
+ */
+class TaxonPruner
+{
+public:
+	TaxonPruner ();
+	virtual ~TaxonPruner () {};
+
+	/**
+	 * Set the taxa to keep, by label.
+	 */
+	virtual void SetTaxa (const std::vector<std::string> &labels);
+	/**
+	 * Drop trees with fewer than k taxa left (default 2). Trees are never
+	 * written with fewer than two, which a tree file can't hold, so smaller
+	 * values are taken as 2.
+	 */
+	virtual void SetMinTaxa (int k) { MinTaxa = (k < 2) ? 2 : k; };
+	int GetMinTaxa () const { return MinTaxa; };
+
+	/**
+	 * Count the leaves kept below each node of t.
+	 * @param t the tree, whose node list is made
+	 * @return the number of distinct taxa kept in t
+	 */
+	virtual int Mark (Tree &t);
+	/**
+	 * @return the number of leaves kept below each node of the tree last
+	 * marked, indexed by Node::GetIndex
+	 */
+	const std::vector<int> &GetKept () const { return Kept; };
+
+	/**
+	 * Restrict every tree in a file, writing those with at least MinTaxa
+	 * taxa left to a NEXUS file, with a TRANSLATE command for the taxa kept.
+	 * @param index the index of the tree file
+	 * @param infile the tree file
+	 * @param outfile the file written
+	 * @return false if a file can't be opened or a tree can't be read
+	 */
+	virtual bool Run (TreeFileIndex &index, const char *infile, const char *outfile);
+
+	int GetNumTaxa () const { return (int)Labels.size(); };
+	int GetNumRead () const { return NumRead; };
+	int GetNumWritten () const { return NumWritten; };
+
+protected:
+	std::vector<std::string> Labels;
+	std::map<std::string, int> TaxonOfLabel;
+	int MinTaxa;
+	int NumRead;
+	int NumWritten;
+	std::vector<int> Kept;
+	/**
+	 * Taxa seen in the current tree, so repeated leaves are counted once
+	 */
+	std::vector<bool> Seen;
+	std::vector<int> SeenList;
+};
+
+#endif
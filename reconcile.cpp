@@ -0,0 +1,171 @@
+#include "reconcile.h"
+
+//------------------------------------------------------------------------------
+void Reconciliation::ReconcileTree (int k, const TreeIndex &t, std::vector<int> &speciesIndex,
+	std::vector<int> &dup, std::vector<int> &loss, std::vector<int> &dc)
+{
+	TreeDuplications[k] = TreeLosses[k] = TreeDeepCoalescences[k] = 0;
+
+	// Leaves of the input tree whose taxa are in the supertree, and the
+	// supertree leaves for those taxa
+	std::vector<int> geneLeaves, speciesLeaves;
+	for (int i = 0; i < t.GetNumLeaves(); i++)
+	{
+		int x = t.GetTaxon (i);
+		if ((x >= 0) && (x < ST->GetNumTaxa()) && (ST->GetLeafOfTaxon (x) != -1))
+		{
+			geneLeaves.push_back (i);
+			speciesLeaves.push_back (ST->GetLeafOfTaxon (x));
+		}
+	}
+	if (geneLeaves.empty())
+		return;
+	InducedSubtree g, s;
+	t.Induce (geneLeaves, g);
+	ST->Induce (speciesLeaves, s);
+
+	int ns = s.GetNumNodes ();
+	std::vector<int> depth (ns, 0);
+	for (int x = ns - 1; x >= 0; x--)
+	{
+		speciesIndex[s.Host[x]] = x;
+		if (s.Parent[x] != -1)
+			depth[x] = depth[s.Parent[x]] + 1;
+	}
+
+	// LCA mapping, children before parents
+	int ng = g.GetNumNodes ();
+	std::vector<int> map (ng, -1);
+	for (int r = 0; r < ng; r++)
+	{
+		if (t.IsLeaf (g.Host[r]))
+			map[r] = ST->GetLeafOfTaxon (t.GetTaxon (g.Host[r]));
+		int p = g.Parent[r];
+		if (p != -1)
+			map[p] = (map[p] == -1) ? map[r] : ST->LCA (map[p], map[r]);
+	}
+	std::vector<bool> isdup (ng, false);
+	for (int r = 0; r < ng - 1; r++)
+		if (map[r] == map[g.Parent[r]])
+			isdup[g.Parent[r]] = true;
+
+	// Losses on the path between the images of the ends of each edge, and
+	// lineages in each edge of the restricted supertree, as differences
+	// summed over subtrees. Position ns collects differences above the root.
+	std::vector<int> lossdiff (ns + 1, 0), lineages (ns + 1, 0);
+	for (int r = 0; r < ng; r++)
+	{
+		int sr = speciesIndex[map[r]];
+		if (g.Parent[r] == -1)
+		{
+			lineages[sr]++;
+			continue;
+		}
+		int p = g.Parent[r];
+		int sp = speciesIndex[map[p]];
+		lineages[sr]++;
+		lineages[sp]--;
+		if (sr != sp)
+		{
+			lossdiff[s.Parent[sr]]++;
+			if (!isdup[p])
+				lossdiff[sp]--;
+			else
+				lossdiff[(s.Parent[sp] == -1) ? ns : s.Parent[sp]]--;
+		}
+	}
+	for (int r = 0; r < ng; r++)
+	{
+		if (isdup[r])
+		{
+			TreeDuplications[k]++;
+			dup[map[r]]++;
+		}
+	}
+	for (int x = 0; x < ns; x++)
+	{
+		int a = s.Parent[x];
+		if (a != -1)
+		{
+			lossdiff[a] += lossdiff[x];
+			lineages[a] += lineages[x];
+			if (lineages[x] > 1)
+			{
+				TreeDeepCoalescences[k] += lineages[x] - 1;
+				dc[s.Host[x]] += lineages[x] - 1;
+			}
+		}
+		TreeLosses[k] += lossdiff[x];
+		loss[s.Host[x]] += lossdiff[x];
+	}
+
+	for (int x = 0; x < ns; x++)
+		speciesIndex[s.Host[x]] = -1;
+}
+
+//------------------------------------------------------------------------------
+void Reconciliation::Compute (const std::vector<TreeIndex> &trees)
+{
+	int n = (int)trees.size();
+	int nodes = ST->GetNumNodes ();
+	TreeDuplications.assign (n, 0);
+	TreeLosses.assign (n, 0);
+	TreeDeepCoalescences.assign (n, 0);
+	NodeDuplications.assign (nodes, 0);
+	NodeLosses.assign (nodes, 0);
+	NodeDeepCoalescences.assign (nodes, 0);
+
+#ifdef _OPENMP
+	#pragma omp parallel
+#endif
+	{
+		std::vector<int> speciesIndex (nodes, -1);
+		std::vector<int> dup (nodes, 0), loss (nodes, 0), dc (nodes, 0);
+#ifdef _OPENMP
+		#pragma omp for schedule(dynamic, 16)
+#endif
+		for (int k = 0; k < n; k++)
+			ReconcileTree (k, trees[k], speciesIndex, dup, loss, dc);
+#ifdef _OPENMP
+		#pragma omp critical
+#endif
+		{
+			for (int u = 0; u < nodes; u++)
+			{
+				NodeDuplications[u] += dup[u];
+				NodeLosses[u] += loss[u];
+				NodeDeepCoalescences[u] += dc[u];
+			}
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+void Reconciliation::Report (std::ostream &f, const std::vector<std::string> &labels) const
+{
+	int d = 0, l = 0, c = 0;
+	for (int k = 0; k < GetNumTrees(); k++)
+	{
+		f << k + 1 << "\t" << TreeDuplications[k] << "\t" << TreeLosses[k] << "\t" << TreeDeepCoalescences[k] << std::endl;
+		d += TreeDuplications[k];
+		l += TreeLosses[k];
+		c += TreeDeepCoalescences[k];
+	}
+	f << "Total\t" << d << "\t" << l << "\t" << c << std::endl;
+
+	for (int k = 0; k < ST->GetNumNodes(); k++)
+	{
+		int u = ST->GetNodeAtPreorder (k);
+		f << "(";
+		for (int i = ST->GetLeafLo (u); i <= ST->GetLeafHi (u); i++)
+		{
+			if (i != ST->GetLeafLo (u))
+				f << ",";
+			f << labels[ST->GetTaxon (ST->GetLeafAtRank (i))];
+		}
+		f << ")\t" << NodeDuplications[u] << "\t" << NodeLosses[u] << "\t" << NodeDeepCoalescences[u];
+		if (!ST->IsLeaf (u) && (u != ST->GetRoot()))
+			f << "\tS=" << Engine->GetCount (u, svSupport) << " Q=" << Engine->GetCount (u, svConflict);
+		f << std::endl;
+	}
+}
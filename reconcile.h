@@ -0,0 +1,103 @@
+/**
+ * @file reconcile.h
+ *
+ * Reconciliation of the input trees, treated as gene trees, with the
+ * supertree, treated as a species tree.
+ *
+ */
+
+#ifndef RECONCILEH
+#define RECONCILEH
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "treeindex.h"
+#include "support.h"
+
+/**
+ * @class Reconciliation
+ * Maps each node of each input tree onto the supertree by LCA mapping
+ * (Page 1994, Syst. Biol. 43:58-77): a leaf maps to the supertree leaf
+ * with the same taxon, and an internal node to the LCA of the images of
+ * its children. A node is a duplication if it has the same image as one
+ * of its children.
+ *
+ * Each input tree is compared with the supertree restricted to the taxa
+ * they share (taxa not in the supertree are ignored). Losses are counted
+ * along each input tree edge as the number of supertree nodes skipped
+ * (including the upper node if it is a duplication), and deep coalescence
+ * as the number of extra lineages, i.e. the sum over the edges of the
+ * restricted supertree of the number of input lineages in that edge less
+ * one (Maddison 1997, Syst. Biol. 46:523-536). Losses and lineages are
+ * assigned to supertree nodes with difference arrays over the restricted
+ * supertree, so each input tree costs time linear in its size after the
+ * induced subtrees are built. Losses are counted as for a binary
+ * supertree; a polytomy is treated as one node.
+ *
+ * Input trees must have had BuildLCA called. If compiled with OpenMP the
+ * input trees are shared between threads.
+ */
+class Reconciliation
+{
+public:
+	/**
+	 * @param supertree the indexed supertree. BuildLCA must have been called.
+	 * @param engine engine with the support counts, reported alongside
+	 */
+	Reconciliation (const TreeIndex *supertree, const SupportEngine *engine) { ST = supertree; Engine = engine; };
+	virtual ~Reconciliation () {};
+
+	/**
+	 * Reconcile each input tree with the supertree.
+	 * @param trees the indexed input trees
+	 */
+	virtual void Compute (const std::vector<TreeIndex> &trees);
+
+	int GetNumTrees () const { return (int)TreeDuplications.size(); };
+	int GetTreeDuplications (int k) const { return TreeDuplications[k]; };
+	int GetTreeLosses (int k) const { return TreeLosses[k]; };
+	int GetTreeDeepCoalescences (int k) const { return TreeDeepCoalescences[k]; };
+	/**
+	 * @return the number of input tree nodes mapped to supertree node u
+	 * that are duplications, summed over all input trees
+	 */
+	int GetNodeDuplications (int u) const { return NodeDuplications[u]; };
+	int GetNodeLosses (int u) const { return NodeLosses[u]; };
+	/**
+	 * @return the extra lineages in the edge above supertree node u,
+	 * summed over all input trees
+	 */
+	int GetNodeDeepCoalescences (int u) const { return NodeDeepCoalescences[u]; };
+
+	/**
+	 * Write one line per input tree (tree number, duplications, losses and
+	 * deep coalescences) and the totals, then one line per supertree node
+	 * with the same counts summed over input trees, with S and Q for
+	 * clades.
+	 * @param f output stream
+	 * @param labels taxon labels, indexed by taxon
+	 */
+	virtual void Report (std::ostream &f, const std::vector<std::string> &labels) const;
+
+protected:
+	const TreeIndex *ST;
+	const SupportEngine *Engine;
+	std::vector<int> TreeDuplications;
+	std::vector<int> TreeLosses;
+	std::vector<int> TreeDeepCoalescences;
+	std::vector<int> NodeDuplications;
+	std::vector<int> NodeLosses;
+	std::vector<int> NodeDeepCoalescences;
+
+	/**
+	 * Reconcile input tree k, adding the counts for each supertree node to
+	 * the arrays dup, loss and dc.
+	 * @param speciesIndex scratch array, one entry per supertree node, all -1
+	 */
+	virtual void ReconcileTree (int k, const TreeIndex &t, std::vector<int> &speciesIndex,
+		std::vector<int> &dup, std::vector<int> &loss, std::vector<int> &dc);
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "rootings.h"
+
+//------------------------------------------------------------------------------
+AllRootings::AllRootings (const TreeIndex *supertree, const SupportEngine *engine)
+{
+	ST = supertree;
+	Engine = engine;
+	Merged = -1;
+}
+
+//------------------------------------------------------------------------------
+void AllRootings::Compute ()
+{
+	int n = ST->GetNumNodes ();
+	int root = ST->GetRoot ();
+	int t = Engine->GetNumTrees ();
+
+	Merged = -1;
+	if (ST->GetDegree (root) == 2)
+		Merged = ST->GetSibling (ST->GetChild (root));
+
+	// Contribution of each side of each edge
+	Lower.assign (n, SupportSummary());
+	Upper.assign (n, SupportSummary());
+	SupportSummary base;
+	for (int u = 0; u < n; u++)
+	{
+		if ((u == root) || (u == Merged))
+			continue;
+		if (!ST->IsLeaf (u))
+			Lower[u].AddClade (Engine->GetCount (u, svSupport), Engine->GetCount (u, svConflict),
+				Engine->GetCount (u, svPermit), Engine->GetCount (u, svIrrelevant), t);
+		if (ST->GetNumLeaves() - ST->GetClusterSize (u) >= 2)
+			Upper[u].AddClade (Engine->GetComplementCount (u, svSupport), Engine->GetComplementCount (u, svConflict),
+				Engine->GetComplementCount (u, svPermit), Engine->GetComplementCount (u, svIrrelevant), t);
+		base.Add (Lower[u]);
+	}
+
+	// Change to the totals caused by reversing the edges on the path to
+	// the root, accumulated in preorder
+	std::vector<SupportSummary> delta (n);
+	for (int k = 1; k < n; k++)
+	{
+		int u = ST->GetNodeAtPreorder (k);
+		int a = ST->GetParent (u);
+		delta[u] = delta[a];
+		if ((a != root) && (a != Merged))
+		{
+			delta[u].Add (Upper[a]);
+			delta[u].Subtract (Lower[a]);
+		}
+	}
+
+	Edges.clear ();
+	Totals.clear ();
+	for (int k = 1; k < n; k++)
+	{
+		int u = ST->GetNodeAtPreorder (k);
+		if (u == Merged)
+			continue;
+		SupportSummary s = base;
+		s.Add (delta[u]);
+		s.Add (Upper[u]);
+		Edges.push_back (u);
+		Totals.push_back (s);
+	}
+}
+
+//------------------------------------------------------------------------------
+int AllRootings::GetBestByV () const
+{
+	int best = -1;
+	for (int k = 0; k < GetNumRootings(); k++)
+	{
+		if (Totals[k].Clades == 0)
+			continue;
+		if ((best == -1) || (Totals[k].MeanV() > Totals[best].MeanV()))
+			best = k;
+	}
+	return best;
+}
+
+//------------------------------------------------------------------------------
+int AllRootings::GetBestByU1 () const
+{
+	int best = -1;
+	for (int k = 0; k < GetNumRootings(); k++)
+	{
+		if (Totals[k].Clades == 0)
+			continue;
+		if ((best == -1) || (Totals[k].u1 < Totals[best].u1)
+			|| ((Totals[k].u1 == Totals[best].u1) && (Totals[k].MeanV() > Totals[best].MeanV())))
+			best = k;
+	}
+	return best;
+}
+
+//------------------------------------------------------------------------------
+void AllRootings::Summarise (int k, SupportSummary &s) const
+{
+	int e = Edges[k];
+	int t = Engine->GetNumTrees ();
+	s.Clear ();
+	for (int u = 0; u < ST->GetNumNodes(); u++)
+	{
+		if ((u == ST->GetRoot()) || (u == Merged))
+			continue;
+		bool lower = !Reversed (u, e);
+		bool upper = (u == e) || Reversed (u, e);
+		if (lower && !ST->IsLeaf (u))
+			s.AddClade (Engine->GetCount (u, svSupport), Engine->GetCount (u, svConflict),
+				Engine->GetCount (u, svPermit), Engine->GetCount (u, svIrrelevant), t);
+		if (upper && (ST->GetNumLeaves() - ST->GetClusterSize (u) >= 2))
+			s.AddClade (Engine->GetComplementCount (u, svSupport), Engine->GetComplementCount (u, svConflict),
+				Engine->GetComplementCount (u, svPermit), Engine->GetComplementCount (u, svIrrelevant), t);
+	}
+}
+
+//------------------------------------------------------------------------------
+std::string AllRootings::GetCladeString (int node, const std::vector<std::string> &labels) const
+{
+	std::string s;
+	if (ST->IsLeaf (node))
+		return labels[ST->GetTaxon (node)];
+	s = "(";
+	for (int k = ST->GetLeafLo (node); k <= ST->GetLeafHi (node); k++)
+	{
+		if (k != ST->GetLeafLo (node))
+			s += ",";
+		s += labels[ST->GetTaxon (ST->GetLeafAtRank (k))];
+	}
+	s += ")";
+	return s;
+}
+
+//------------------------------------------------------------------------------
+void AllRootings::WriteCounts (std::ostream &f, int node, bool complement) const
+{
+	if (complement)
+		f << "S=" << Engine->GetComplementCount (node, svSupport)
+			<< " Q=" << Engine->GetComplementCount (node, svConflict)
+			<< " P=" << Engine->GetComplementCount (node, svPermit)
+			<< " I=" << Engine->GetComplementCount (node, svIrrelevant);
+	else
+		f << "S=" << Engine->GetCount (node, svSupport)
+			<< " Q=" << Engine->GetCount (node, svConflict)
+			<< " P=" << Engine->GetCount (node, svPermit)
+			<< " I=" << Engine->GetCount (node, svIrrelevant);
+}
+
+//------------------------------------------------------------------------------
+void AllRootings::Report (std::ostream &f, const std::vector<std::string> &labels) const
+{
+	for (int k = 0; k < GetNumRootings(); k++)
+	{
+		const SupportSummary &s = Totals[k];
+		f << GetCladeString (Edges[k], labels) << "\t";
+		WriteCounts (f, Edges[k], false);
+		f << "\t";
+		WriteCounts (f, Edges[k], true);
+		f << "\t" << s.Clades << "\t" << s.u1 << "\t" << s.u2 << "\t" << s.u3 << "\t" << s.u4 << "\t" << s.u5;
+		f << "\t" << s.MeanV() << "\t" << s.MeanVPlus() << "\t" << s.MeanVMinus() << std::endl;
+	}
+
+	int best[2];
+	best[0] = GetBestByV ();
+	best[1] = GetBestByU1 ();
+	for (int i = 0; i < 2; i++)
+	{
+		if (best[i] == -1)
+			continue;
+		SupportSummary s;
+		Summarise (best[i], s);
+		f << ((i == 0) ? "Best rooting by mean V" : "Best rooting by u1") << "\t";
+		f << GetCladeString (Edges[best[i]], labels) << "\t" << s.Clades << "\t";
+		s.Write (f);
+		f << std::endl;
+	}
+}
@@ -0,0 +1,99 @@
+/**
+ * @file rootings.h
+ *
+ * Support statistics for every rooting of an unrooted supertree.
+ *
+ */
+
+#ifndef ROOTINGSH
+#define ROOTINGSH
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "treeindex.h"
+#include "support.h"
+
+/**
+ * @class AllRootings
+ * Computes the summary statistics of the supertree rooted on each of its
+ * edges in turn.
+ *
+ * Edge e is identified with the node below it (if the supertree root has
+ * degree two its two edges are one unrooted edge, represented by the root's
+ * first child). Rooting on e makes both sides of e clades; every other edge
+ * f contributes the side of f that does not contain e. That is the cluster
+ * below f, unless f lies on the path from e to the current root, in which
+ * case it is the complement. The verdicts for both sides of every edge come
+ * from a single SupportEngine run with SetBothSides (true), and the totals
+ * for each rooting are found by accumulating the differences along the
+ * root path in one preorder traversal.
+ */
+class AllRootings
+{
+public:
+	/**
+	 * @param supertree the indexed supertree
+	 * @param engine the engine holding the counts for both sides of every edge
+	 */
+	AllRootings (const TreeIndex *supertree, const SupportEngine *engine);
+	virtual ~AllRootings () {};
+
+	virtual void Compute ();
+
+	int GetNumRootings () const { return (int)Edges.size(); };
+	/**
+	 * @return the node below the kth rooting edge
+	 */
+	int GetEdge (int k) const { return Edges[k]; };
+	/**
+	 * @return the additive part of the summary for rooting k (the minima and
+	 * maxima are not valid; use Summarise)
+	 */
+	const SupportSummary &GetTotals (int k) const { return Totals[k]; };
+	/**
+	 * @return the rooting with the highest mean V
+	 */
+	int GetBestByV () const;
+	/**
+	 * @return the rooting with the fewest unsupported clades (u1), ties broken by mean V
+	 */
+	int GetBestByU1 () const;
+	/**
+	 * Compute the full summary (including ranges) for rooting k.
+	 */
+	virtual void Summarise (int k, SupportSummary &s) const;
+	/**
+	 * Write one line per rooting: the clade below the edge, S, Q, P and I for
+	 * each side of the edge, the number of clades and the summary statistics,
+	 * followed by the best rootings.
+	 * @param f output stream
+	 * @param labels taxon labels, indexed by taxon
+	 */
+	virtual void Report (std::ostream &f, const std::vector<std::string> &labels) const;
+	/**
+	 * @return the leaves below node as a string "(a,b,...)"
+	 */
+	virtual std::string GetCladeString (int node, const std::vector<std::string> &labels) const;
+
+protected:
+	const TreeIndex *ST;
+	const SupportEngine *Engine;
+	/**
+	 * The edge shared with Edges[0] when the root has degree two, otherwise -1
+	 */
+	int Merged;
+	std::vector<int> Edges;
+	std::vector<SupportSummary> Totals;
+	std::vector<SupportSummary> Lower;
+	std::vector<SupportSummary> Upper;
+
+	/**
+	 * @return true if the rooting clade of f is its complement when rooted on e
+	 */
+	bool Reversed (int f, int e) const { return (f != e) && ST->IsAncestor (f, e); };
+	virtual void WriteCounts (std::ostream &f, int node, bool complement) const;
+};
+
+#endif
@@ -0,0 +1,253 @@
+#include "succinct.h"
+
+#include "treeindex.h"
+
+//------------------------------------------------------------------------------
+static int PopCount (SuccinctWord w)
+{
+#ifdef __GNUC__
+	return __builtin_popcountll (w);
+#else
+	int n = 0;
+	while (w)
+	{
+		w &= w - 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+//------------------------------------------------------------------------------
+static SuccinctWord LowBits (int k)
+{
+	return (k >= 64) ? ~(SuccinctWord)0 : (((SuccinctWord)1 << k) - 1);
+}
+
+//------------------------------------------------------------------------------
+void SuccinctTree::Assign (const std::vector<SuccinctWord> &words, int length, const std::vector<int> &taxa)
+{
+	Words = words;
+	Length = length;
+	Taxa = taxa;
+	int nwords = (int)Words.size();
+	WordExcess.assign (nwords + 1, 0);
+	WordMin.assign (nwords, 0);
+	LeafBefore.assign (nwords + 1, 0);
+	for (int w = 0; w < nwords; w++)
+	{
+		int bits = (w == nwords - 1) ? Length - 64 * w : 64;
+		int e = 0, m = 0;
+		for (int b = 0; b < bits; b++)
+		{
+			e += ((Words[w] >> b) & 1) ? 1 : -1;
+			if (e < m)
+				m = e;
+		}
+		WordMin[w] = m;
+		WordExcess[w + 1] = WordExcess[w] + e;
+		LeafBefore[w + 1] = LeafBefore[w] + PopCount (LeafStarts (w));
+	}
+	NumLeaves = LeafBefore[nwords];
+}
+
+//------------------------------------------------------------------------------
+SuccinctWord SuccinctTree::LeafStarts (int w) const
+{
+	SuccinctWord next = (w + 1 < (int)Words.size()) ? Words[w + 1] : 0;
+	SuccinctWord closeAfter = ~((Words[w] >> 1) | (next << 63));
+	SuccinctWord starts = Words[w] & closeAfter;
+	if (w == (int)Words.size() - 1)
+		starts &= LowBits (Length - 64 * w);
+	return starts;
+}
+
+//------------------------------------------------------------------------------
+int SuccinctTree::Excess (int i) const
+{
+	int w = i / 64;
+	int b = i % 64;
+	if (b == 0)
+		return WordExcess[w];
+	return WordExcess[w] + 2 * PopCount (Words[w] & LowBits (b)) - b;
+}
+
+//------------------------------------------------------------------------------
+// The first position j > v at which the excess of the first j + 1
+// parentheses returns to that before v
+int SuccinctTree::FindClose (int v) const
+{
+	int target = Excess (v);
+	int e = target + 1;
+	int i = v + 1;
+	// Rest of the word containing v
+	while ((i < Length) && (i % 64 != 0))
+	{
+		e += IsOpen (i) ? 1 : -1;
+		if (e == target)
+			return i;
+		i++;
+	}
+	// Skip words that never fall as low as the target
+	int w = i / 64;
+	while ((w < (int)Words.size()) && (WordExcess[w] + WordMin[w] > target))
+		w++;
+	if (w >= (int)Words.size())
+		return -1;
+	e = WordExcess[w];
+	for (i = 64 * w; i < Length; i++)
+	{
+		e += IsOpen (i) ? 1 : -1;
+		if (e == target)
+			return i;
+	}
+	return -1;
+}
+
+//------------------------------------------------------------------------------
+// The last position j < v with the excess before j one less than before v
+int SuccinctTree::GetParent (int v) const
+{
+	if (v == 0)
+		return -1;
+	int target = Excess (v) - 1;
+	int e = Excess (v);
+	int i = v - 1;
+	// Rest of the word containing v
+	while ((i >= 0) && (i % 64 != 63))
+	{
+		e -= IsOpen (i) ? 1 : -1;
+		if (e == target)
+			return i;
+		i--;
+	}
+	// Skip words that never fall as low as the target
+	int w = (i + 1) / 64 - 1;
+	while ((w >= 0) && (WordExcess[w] + WordMin[w] > target))
+		w--;
+	if (w < 0)
+		return -1;
+	e = WordExcess[w + 1];
+	for (i = 64 * w + 63; i >= 64 * w; i--)
+	{
+		e -= IsOpen (i) ? 1 : -1;
+		if (e == target)
+			return i;
+	}
+	return -1;
+}
+
+//------------------------------------------------------------------------------
+int SuccinctTree::GetNextSibling (int v) const
+{
+	int c = FindClose (v);
+	if ((c + 1 < Length) && IsOpen (c + 1))
+		return c + 1;
+	return -1;
+}
+
+//------------------------------------------------------------------------------
+int SuccinctTree::GetLeafRank (int v) const
+{
+	int w = v / 64;
+	return LeafBefore[w] + PopCount (LeafStarts (w) & LowBits (v % 64));
+}
+
+//------------------------------------------------------------------------------
+void SuccinctTree::GetCluster (int v, std::vector<int> &taxa) const
+{
+	int lo = GetLeafRank (v);
+	int c = FindClose (v);
+	int hi = (c + 1 < Length) ? GetLeafRank (c + 1) : NumLeaves;
+	taxa.assign (Taxa.begin() + lo, Taxa.begin() + hi);
+}
+
+//------------------------------------------------------------------------------
+TreeCollection::TreeCollection (int numTaxa)
+{
+	NumTaxa = numTaxa;
+	// Labels are taxon + 1, with 0 for leaves not in the profile
+	LabelWidth = 1;
+	while ((LabelWidth < 32) && ((1LL << LabelWidth) <= (long long)numTaxa))
+		LabelWidth++;
+	Clear ();
+}
+
+//------------------------------------------------------------------------------
+void TreeCollection::Clear ()
+{
+	Bits.clear ();
+	Labels.clear ();
+	BitStart.assign (1, 0);
+	LabelStart.assign (1, 0);
+}
+
+//------------------------------------------------------------------------------
+void TreeCollection::PutBits (std::vector<SuccinctWord> &v, long long pos, SuccinctWord value, int width)
+{
+	while ((long long)v.size() * 64 < pos + width)
+		v.push_back (0);
+	int b = (int)(pos % 64);
+	long long w = pos / 64;
+	v[w] |= value << b;
+	if (b + width > 64)
+		v[w + 1] |= value >> (64 - b);
+}
+
+//------------------------------------------------------------------------------
+SuccinctWord TreeCollection::GetBits (const std::vector<SuccinctWord> &v, long long pos, int width)
+{
+	int b = (int)(pos % 64);
+	long long w = pos / 64;
+	SuccinctWord value = v[w] >> b;
+	if (b + width > 64)
+		value |= v[w + 1] << (64 - b);
+	return value & LowBits (width);
+}
+
+//------------------------------------------------------------------------------
+void TreeCollection::AddTree (const TreeIndex &t)
+{
+	long long pos = BitStart.back();
+	long long label = LabelStart.back();
+	int root = t.GetRoot ();
+	for (int k = 0; k < t.GetNumNodes(); k++)
+	{
+		int p = t.GetNodeAtPreorder (k);
+		PutBits (Bits, pos++, 1, 1);
+		if (!t.IsLeaf (p))
+			continue;
+		PutBits (Bits, pos++, 0, 1);
+		PutBits (Labels, label * LabelWidth, (SuccinctWord)(t.GetTaxon (p) + 1), LabelWidth);
+		label++;
+		// Close the ancestors whose last child this leaf ends
+		while ((p != root) && (t.GetSibling (p) == -1))
+		{
+			p = t.GetParent (p);
+			PutBits (Bits, pos++, 0, 1);
+		}
+	}
+	BitStart.push_back (pos);
+	LabelStart.push_back (label);
+}
+
+//------------------------------------------------------------------------------
+void TreeCollection::GetTree (int k, SuccinctTree &s) const
+{
+	long long start = BitStart[k];
+	int length = (int)(BitStart[k + 1] - start);
+	std::vector<SuccinctWord> words ((length + 63) / 64, 0);
+	for (int w = 0; w < (int)words.size(); w++)
+		words[w] = GetBits (Bits, start + 64 * w, (length - 64 * w < 64) ? length - 64 * w : 64);
+	std::vector<int> taxa (GetNumLeaves (k));
+	for (int i = 0; i < (int)taxa.size(); i++)
+		taxa[i] = (int)GetBits (Labels, (LabelStart[k] + i) * LabelWidth, LabelWidth) - 1;
+	s.Assign (words, length, taxa);
+}
+
+//------------------------------------------------------------------------------
+long long TreeCollection::GetBytes () const
+{
+	return (long long)(Bits.size() + Labels.size()) * sizeof (SuccinctWord)
+		+ (long long)(BitStart.size() + LabelStart.size()) * sizeof (long long);
+}
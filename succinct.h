@@ -0,0 +1,180 @@
+/**
+ * @file succinct.h
+ *
+ * Compact storage for large collections of trees.
+ *
+ */
+
+#ifndef SUCCINCTH
+#define SUCCINCTH
+
+#include <vector>
+
+/**
+ * @var typedef unsigned long long SuccinctWord
+ * @brief One word of a bit-packed parenthesis or label sequence
+ */
+typedef unsigned long long SuccinctWord;
+
+class TreeIndex;
+
+/**
+ * @class SuccinctTree
+ * One tree of a TreeCollection, as a sequence of balanced parentheses
+ * (bit 1 for "(", 0 for ")") listing the nodes in preorder, together with
+ * the taxa of the leaves in preorder. A node is identified by the position
+ * of its opening parenthesis, so the root is node 0 and a leaf is "()".
+ *
+ * Navigation uses the excess (opens minus closes) of each prefix of the
+ * sequence. A small directory holding the excess at the start of each
+ * word, the minimum excess within it and the number of leaves before it
+ * lets the matching and enclosing parentheses be found by skipping whole
+ * words, so the directory takes a few bytes per 64 nodes.
+ */
+class SuccinctTree
+{
+public:
+	SuccinctTree () { Length = 0; NumLeaves = 0; };
+	virtual ~SuccinctTree () {};
+
+	int GetNumNodes () const { return Length / 2; };
+	int GetNumLeaves () const { return NumLeaves; };
+	int GetRoot () const { return 0; };
+	bool IsOpen (int i) const { return (Words[i / 64] >> (i % 64)) & 1; };
+	bool IsLeaf (int v) const { return !IsOpen (v + 1); };
+	/**
+	 * @return the parent of v, or -1 if v is the root
+	 */
+	virtual int GetParent (int v) const;
+	/**
+	 * @return the first child of v, or -1 if v is a leaf
+	 */
+	int GetFirstChild (int v) const { return IsLeaf (v) ? -1 : v + 1; };
+	/**
+	 * @return the next sibling of v, or -1 if v is the last child
+	 */
+	virtual int GetNextSibling (int v) const;
+	/**
+	 * @return the number of nodes in the subtree rooted at v
+	 */
+	int GetSubtreeSize (int v) const { return (FindClose (v) - v + 1) / 2; };
+	/**
+	 * @return the position of the parenthesis closing v
+	 */
+	virtual int FindClose (int v) const;
+	/**
+	 * @return the number of leaves before v in preorder
+	 */
+	virtual int GetLeafRank (int v) const;
+	/**
+	 * @return the taxon of leaf v, or -1 if its label is not in the profile
+	 */
+	int GetTaxon (int v) const { return Taxa[GetLeafRank (v)]; };
+	/**
+	 * @return the taxon of the leaf with rank k
+	 */
+	int GetTaxonAtRank (int k) const { return Taxa[k]; };
+	/**
+	 * Extract the cluster of v.
+	 * @param v the node
+	 * @param taxa the taxa of the leaves below v, in preorder
+	 */
+	virtual void GetCluster (int v, std::vector<int> &taxa) const;
+
+	/**
+	 * Set the tree from its parentheses and leaf taxa, and build the
+	 * directory.
+	 * @param words the parentheses, packed 64 to a word starting at the
+	 * lowest bit
+	 * @param length the number of parentheses
+	 * @param taxa the taxon of each leaf in preorder
+	 */
+	virtual void Assign (const std::vector<SuccinctWord> &words, int length, const std::vector<int> &taxa);
+
+protected:
+	int Length;
+	int NumLeaves;
+	std::vector<SuccinctWord> Words;
+	std::vector<int> Taxa;
+	/**
+	 * Excess before each word
+	 */
+	std::vector<int> WordExcess;
+	/**
+	 * Minimum excess of the prefixes of each word (0 to 64 bits), relative
+	 * to the excess before it
+	 */
+	std::vector<int> WordMin;
+	/**
+	 * Leaves whose "()" begins before each word
+	 */
+	std::vector<int> LeafBefore;
+
+	/**
+	 * @return the word of leaf starts, i.e. the bits i of word w such that
+	 * i is "(" and i + 1 is ")"
+	 */
+	SuccinctWord LeafStarts (int w) const;
+	/**
+	 * @return the excess of the first i parentheses
+	 */
+	int Excess (int i) const;
+};
+
+/**
+ * @class TreeCollection
+ * Stores many trees in about 2n + n log2(taxa) bits per tree of n nodes,
+ * far less than NTree or TreeIndex, so that samples of millions of trees
+ * can be held in memory. The topologies are concatenated balanced
+ * parenthesis sequences and the leaf taxa are packed into the fewest bits
+ * that hold (number of taxa + 1) values.
+ *
+ * Trees are read back one at a time with GetTree, giving a SuccinctTree
+ * that can be navigated directly, or indexed with TreeIndex::Build for the
+ * support engine and the other analyses.
+ */
+class TreeCollection
+{
+public:
+	/**
+	 * @param numTaxa number of taxa in the profile
+	 */
+	TreeCollection (int numTaxa);
+	virtual ~TreeCollection () {};
+
+	virtual void Clear ();
+	/**
+	 * Append a tree. The order of children is preserved.
+	 */
+	virtual void AddTree (const TreeIndex &t);
+	/**
+	 * Unpack tree k.
+	 */
+	virtual void GetTree (int k, SuccinctTree &s) const;
+
+	int GetNumTaxa () const { return NumTaxa; };
+	int GetNumTrees () const { return (int)BitStart.size() - 1; };
+	int GetNumNodes (int k) const { return (int)(BitStart[k + 1] - BitStart[k]) / 2; };
+	int GetNumLeaves (int k) const { return (int)(LabelStart[k + 1] - LabelStart[k]); };
+	/**
+	 * @return the number of bytes used to store the trees
+	 */
+	long long GetBytes () const;
+
+protected:
+	int NumTaxa;
+	int LabelWidth;
+	std::vector<SuccinctWord> Bits;
+	std::vector<SuccinctWord> Labels;
+	/**
+	 * Position of the first parenthesis and label of each tree, with one
+	 * extra entry marking the end
+	 */
+	std::vector<long long> BitStart;
+	std::vector<long long> LabelStart;
+
+	static void PutBits (std::vector<SuccinctWord> &v, long long pos, SuccinctWord value, int width);
+	static SuccinctWord GetBits (const std::vector<SuccinctWord> &v, long long pos, int width);
+};
+
+#endif
@@ -0,0 +1,609 @@
+#include "supertree.h"
+#include "support.h"
+
+#include <algorithm>
+
+//------------------------------------------------------------------------------
+ClusterHierarchy::ClusterHierarchy (int numTaxa)
+{
+	NumTaxa = numTaxa;
+	Smallest.assign (numTaxa, 0);
+	Parent.assign (1, -1);
+	Size.assign (1, numTaxa);
+	Id.assign (1, -1);
+}
+
+//------------------------------------------------------------------------------
+bool ClusterHierarchy::Fits (const std::vector<int> &taxa) const
+{
+	if (taxa.empty())
+		return false;
+	int h = Smallest[taxa[0]];
+	if ((int)taxa.size() >= Size[h])
+		return false;
+	for (int i = 1; i < (int)taxa.size(); i++)
+		if (Smallest[taxa[i]] != h)
+			return false;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+void ClusterHierarchy::Add (const std::vector<int> &taxa, int id)
+{
+	int h = (int)Parent.size();
+	Parent.push_back (Smallest[taxa[0]]);
+	Size.push_back ((int)taxa.size());
+	Id.push_back (id);
+	for (int i = 0; i < (int)taxa.size(); i++)
+		Smallest[taxa[i]] = h;
+}
+
+//------------------------------------------------------------------------------
+void ClusterHierarchy::FindConflicts (const std::vector<int> &taxa, std::vector<int> &count, std::vector<int> &ids) const
+{
+	int n = GetNumNodes ();
+	int m = (int)taxa.size();
+	count.assign (n, 0);
+	for (int i = 0; i < m; i++)
+		count[Smallest[taxa[i]]]++;
+	// Clusters were added largest first, so children follow their parents
+	for (int h = n - 1; h > 0; h--)
+		count[Parent[h]] += count[h];
+	ids.clear ();
+	for (int h = 1; h < n; h++)
+		if ((count[h] > 0) && (count[h] < Size[h]) && (count[h] < m))
+			ids.push_back (Id[h]);
+}
+
+//------------------------------------------------------------------------------
+static void PutParenthesis (std::vector<SuccinctWord> &words, int &length, bool open)
+{
+	if (length % 64 == 0)
+		words.push_back (0);
+	if (open)
+		words.back() |= (SuccinctWord)1 << (length % 64);
+	length++;
+}
+
+//------------------------------------------------------------------------------
+void ClusterHierarchy::BuildIndex (TreeIndex &t, std::vector<int> &node) const
+{
+	int n = GetNumNodes ();
+	std::vector<int> firstChild (n, -1), nextSibling (n, -1);
+	std::vector<int> firstTaxon (n, -1), nextTaxon (NumTaxa, -1);
+	for (int h = n - 1; h > 0; h--)
+	{
+		nextSibling[h] = firstChild[Parent[h]];
+		firstChild[Parent[h]] = h;
+	}
+	for (int x = NumTaxa - 1; x >= 0; x--)
+	{
+		nextTaxon[x] = firstTaxon[Smallest[x]];
+		firstTaxon[Smallest[x]] = x;
+	}
+
+	// Balanced parentheses in preorder, each node's taxa before its
+	// clusters. Internal nodes are numbered as they close, after the
+	// leaves, as TreeIndex::Build does.
+	std::vector<SuccinctWord> words;
+	std::vector<int> leaves;
+	int length = 0, closed = 0;
+	node.assign (n, -1);
+	std::vector<int> path, next;
+	for (int h = 0; ; )
+	{
+		if (h != -1)
+		{
+			PutParenthesis (words, length, true);
+			for (int x = firstTaxon[h]; x != -1; x = nextTaxon[x])
+			{
+				PutParenthesis (words, length, true);
+				PutParenthesis (words, length, false);
+				leaves.push_back (x);
+			}
+			path.push_back (h);
+			next.push_back (firstChild[h]);
+		}
+		h = next.back();
+		if (h != -1)
+		{
+			next.back() = nextSibling[h];
+			continue;
+		}
+		PutParenthesis (words, length, false);
+		node[path.back()] = NumTaxa + closed++;
+		path.pop_back ();
+		next.pop_back ();
+		if (path.empty())
+			break;
+	}
+
+	SuccinctTree s;
+	s.Assign (words, length, leaves);
+	t.Build (s, NumTaxa);
+}
+
+//------------------------------------------------------------------------------
+CandidateClusters::CandidateClusters (int numTaxa)
+	: Trees (numTaxa), Keys (numTaxa)
+{
+	NumTaxa = numTaxa;
+	NumHierarchies = 0;
+	Cached = -1;
+}
+
+//------------------------------------------------------------------------------
+void CandidateClusters::AddTree (const TreeIndex &t)
+{
+	int k = Trees.GetNumTrees();
+	Trees.AddTree (t);
+	std::vector<Fingerprint> fp;
+	Keys.Compute (t, fp);
+	for (int p = 0; p < t.GetNumNodes(); p++)
+	{
+		int u = t.GetNodeAtPreorder (p);
+		int size = t.GetClusterSize (u);
+		if (t.IsLeaf (u) || (u == t.GetRoot()) || (size < 2) || (size >= t.GetNumLeaves()) || (size >= NumTaxa))
+			continue;
+		int entries = Table.GetNumEntries();
+		if (Table.Insert (fp[u]) < entries)
+			continue;
+		// A node's opening parenthesis follows those of the nodes before
+		// it in preorder and the closing ones of those that are not its
+		// ancestors
+		Tree.push_back (k);
+		Position.push_back (2 * p - t.GetDepth (u));
+		Size.push_back (size);
+	}
+}
+
+//------------------------------------------------------------------------------
+void CandidateClusters::GetCluster (int c, std::vector<int> &taxa)
+{
+	if (Cached != Tree[c])
+	{
+		Trees.GetTree (Tree[c], CachedTree);
+		Cached = Tree[c];
+	}
+	CachedTree.GetCluster (Position[c], taxa);
+}
+
+/**
+ * @class LargerCandidate
+ * Orders candidates by decreasing size, then by tree, so that clusters of
+ * the same tree are extracted together.
+ */
+class LargerCandidate
+{
+public:
+	LargerCandidate (const CandidateClusters *c) { candidates = c; };
+	bool operator() (int a, int b) const
+	{
+		if (candidates->GetSize (a) != candidates->GetSize (b))
+			return candidates->GetSize (a) > candidates->GetSize (b);
+		if (candidates->GetTree (a) != candidates->GetTree (b))
+			return candidates->GetTree (a) < candidates->GetTree (b);
+		return a < b;
+	};
+protected:
+	const CandidateClusters *candidates;
+};
+
+//------------------------------------------------------------------------------
+void CandidateClusters::Count ()
+{
+	int n = GetNumCandidates ();
+	std::vector<int> order (n);
+	for (int c = 0; c < n; c++)
+		order[c] = c;
+	std::sort (order.begin(), order.end(), LargerCandidate (this));
+
+	// First fit into hierarchies
+	std::vector<ClusterHierarchy> hierarchies;
+	std::vector<int> taxa;
+	for (int i = 0; i < n; i++)
+	{
+		int c = order[i];
+		GetCluster (c, taxa);
+		int k = 0;
+		while ((k < (int)hierarchies.size()) && !hierarchies[k].Fits (taxa))
+			k++;
+		if (k == (int)hierarchies.size())
+			hierarchies.push_back (ClusterHierarchy (NumTaxa));
+		hierarchies[k].Add (taxa, c);
+	}
+	NumHierarchies = (int)hierarchies.size();
+
+	Support.assign (n, 0);
+	Conflict.assign (n, 0);
+	Permit.assign (n, 0);
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic, 1)
+#endif
+	for (int k = 0; k < NumHierarchies; k++)
+	{
+		const ClusterHierarchy &h = hierarchies[k];
+		TreeIndex t;
+		std::vector<int> node;
+		h.BuildIndex (t, node);
+		t.BuildLCA ();
+		SupportEngine engine (&t);
+		engine.AddTrees (Trees, 0);
+		engine.Finish ();
+		for (int j = 1; j < h.GetNumNodes(); j++)
+		{
+			Support[h.GetId (j)] = engine.GetCount (node[j], svSupport);
+			Conflict[h.GetId (j)] = engine.GetCount (node[j], svConflict);
+			Permit[h.GetId (j)] = engine.GetCount (node[j], svPermit);
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+MajorityRuleSupertree::MajorityRuleSupertree (CandidateClusters *candidates)
+	: Tree (candidates->GetNumTaxa())
+{
+	Candidates = candidates;
+	NumMajority = NumContested = 0;
+}
+
+/**
+ * @class StrongerCandidate
+ * Orders positions in a list of candidates by decreasing S - Q, then S,
+ * then size.
+ */
+class StrongerCandidate
+{
+public:
+	StrongerCandidate (const CandidateClusters *c, const std::vector<int> *list) { candidates = c; ids = list; };
+	bool operator() (int i, int j) const
+	{
+		int a = (*ids)[i], b = (*ids)[j];
+		int na = candidates->GetSupport (a) - candidates->GetConflict (a);
+		int nb = candidates->GetSupport (b) - candidates->GetConflict (b);
+		if (na != nb)
+			return na > nb;
+		if (candidates->GetSupport (a) != candidates->GetSupport (b))
+			return candidates->GetSupport (a) > candidates->GetSupport (b);
+		if (candidates->GetSize (a) != candidates->GetSize (b))
+			return candidates->GetSize (a) > candidates->GetSize (b);
+		return i < j;
+	};
+protected:
+	const CandidateClusters *candidates;
+	const std::vector<int> *ids;
+};
+
+//------------------------------------------------------------------------------
+void MajorityRuleSupertree::Compute (bool plus)
+{
+	int numTaxa = Candidates->GetNumTaxa();
+	std::vector<int> majority;
+	for (int c = 0; c < Candidates->GetNumCandidates(); c++)
+		if (Candidates->GetSupport (c) > Candidates->GetConflict (c))
+			majority.push_back (c);
+	std::sort (majority.begin(), majority.end(), LargerCandidate (Candidates));
+	int m = (int)majority.size();
+	NumMajority = m;
+
+	// Pack the majority clusters, identified by their position in majority
+	std::vector< std::vector<int> > clusters (m);
+	std::vector<ClusterHierarchy> hierarchies;
+	std::vector<int> hierarchyOf (m);
+	for (int i = 0; i < m; i++)
+	{
+		Candidates->GetCluster (majority[i], clusters[i]);
+		int k = 0;
+		while ((k < (int)hierarchies.size()) && !hierarchies[k].Fits (clusters[i]))
+			k++;
+		if (k == (int)hierarchies.size())
+			hierarchies.push_back (ClusterHierarchy (numTaxa));
+		hierarchies[k].Add (clusters[i], i);
+		hierarchyOf[i] = k;
+	}
+
+	// Incompatible pairs, from both sides
+	std::vector< std::vector<int> > conflicts (m);
+	if (hierarchies.size() > 1)
+	{
+#ifdef _OPENMP
+		#pragma omp parallel
+#endif
+		{
+			std::vector<int> count, ids;
+#ifdef _OPENMP
+			#pragma omp for schedule(dynamic, 16)
+#endif
+			for (int i = 0; i < m; i++)
+			{
+				for (int k = 0; k < (int)hierarchies.size(); k++)
+				{
+					if (k == hierarchyOf[i])
+						continue;
+					hierarchies[k].FindConflicts (clusters[i], count, ids);
+					conflicts[i].insert (conflicts[i].end(), ids.begin(), ids.end());
+				}
+			}
+		}
+	}
+
+	std::vector<bool> kept (m, false);
+	NumContested = 0;
+	for (int i = 0; i < m; i++)
+	{
+		if (conflicts[i].empty())
+			kept[i] = true;
+		else
+			NumContested++;
+	}
+	if (plus)
+	{
+		std::vector<int> order (m);
+		for (int i = 0; i < m; i++)
+			order[i] = i;
+		std::sort (order.begin(), order.end(), StrongerCandidate (Candidates, &majority));
+		for (int j = 0; j < m; j++)
+		{
+			int i = order[j];
+			if (kept[i])
+				continue;
+			bool ok = true;
+			for (int q = 0; ok && (q < (int)conflicts[i].size()); q++)
+				ok = !kept[conflicts[i][q]];
+			kept[i] = ok;
+		}
+	}
+
+	// Kept clusters are compatible, and still largest first
+	Tree = ClusterHierarchy (numTaxa);
+	for (int i = 0; i < m; i++)
+		if (kept[i])
+			Tree.Add (clusters[i], majority[i]);
+}
+
+//------------------------------------------------------------------------------
+void MajorityRuleSupertree::BuildIndex (TreeIndex &t, std::vector<int> &node) const
+{
+	std::vector<int> h;
+	Tree.BuildIndex (t, h);
+	node.assign (h.begin() + 1, h.end());
+}
+
+//------------------------------------------------------------------------------
+GreedySupertree::GreedySupertree (CandidateClusters *candidates)
+{
+	Candidates = candidates;
+	Order = goV;
+}
+
+/**
+ * @class GreedyOrder
+ * Orders candidates by decreasing V or S - Q, then S - Q, then S, then
+ * size.
+ */
+class GreedyOrder
+{
+public:
+	GreedyOrder (const CandidateClusters *c, int order) { candidates = c; byV = (order == goV); };
+	bool operator() (int a, int b) const
+	{
+		int sa = candidates->GetSupport (a), qa = candidates->GetConflict (a);
+		int sb = candidates->GetSupport (b), qb = candidates->GetConflict (b);
+		if (byV)
+		{
+			// Compare (sa - qa) / (sa + qa) with (sb - qb) / (sb + qb)
+			long long l = (sa + qa > 0) ? (long long)(sa - qa) * (sb + qb > 0 ? sb + qb : 1) : 0;
+			long long r = (sb + qb > 0) ? (long long)(sb - qb) * (sa + qa > 0 ? sa + qa : 1) : 0;
+			if (l != r)
+				return l > r;
+		}
+		if (sa - qa != sb - qb)
+			return sa - qa > sb - qb;
+		if (sa != sb)
+			return sa > sb;
+		if (candidates->GetSize (a) != candidates->GetSize (b))
+			return candidates->GetSize (a) > candidates->GetSize (b);
+		return a < b;
+	};
+protected:
+	const CandidateClusters *candidates;
+	bool byV;
+};
+
+//------------------------------------------------------------------------------
+// True if every member of bitset a is in bitset b
+static inline bool IsSubset (const ClusterWord *a, const ClusterWord *b, int words)
+{
+	for (int w = 0; w < words; w++)
+		if (a[w] & ~b[w])
+			return false;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Position of the lowest set bit of w, which is not zero
+static inline int LowestBit (ClusterWord w)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll (w);
+#else
+	int i = 0;
+	while (!((w >> i) & 1))
+		i++;
+	return i;
+#endif
+}
+
+//------------------------------------------------------------------------------
+void GreedySupertree::Compute ()
+{
+	int numTaxa = Candidates->GetNumTaxa();
+	int n = Candidates->GetNumCandidates();
+	std::vector<int> order (n);
+	for (int c = 0; c < n; c++)
+		order[c] = c;
+	std::sort (order.begin(), order.end(), GreedyOrder (Candidates, Order));
+
+	Accepted.clear ();
+	Rejected.clear ();
+	Reason.clear ();
+	Witness.clear ();
+
+	// The tree of clusters added so far, node 0 being all the taxa
+	int words = (numTaxa + 63) / 64;
+	std::vector<ClusterWord> bits (words, 0);
+	for (int x = 0; x < numTaxa; x++)
+		bits[x / 64] |= (ClusterWord)1 << (x % 64);
+	std::vector<int> parent (1, -1);
+	std::vector<int> size (1, numTaxa);
+	std::vector<int> mark (1, -1);
+	std::vector<int> smallest (numTaxa, 0);
+
+	std::vector<ClusterWord> cluster (words, 0);
+	std::vector<int> taxa, inside;
+	for (int i = 0; i < n; i++)
+	{
+		int c = order[i];
+		for (int k = 0; k < (int)taxa.size(); k++)
+			cluster[taxa[k] / 64] = 0;
+		Candidates->GetCluster (c, taxa);
+		for (int k = 0; k < (int)taxa.size(); k++)
+			cluster[taxa[k] / 64] |= (ClusterWord)1 << (taxa[k] % 64);
+
+		// Walk up from each taxon through the clusters inside the
+		// candidate, stopping at one that contains it or conflicts
+		int above = 0, conflict = -1;
+		inside.clear ();
+		for (int k = 0; (k < (int)taxa.size()) && (conflict == -1); k++)
+		{
+			for (int u = smallest[taxa[k]]; (u != -1) && (mark[u] != i); u = parent[u])
+			{
+				mark[u] = i;
+				const ClusterWord *b = &bits[(size_t)u * words];
+				if ((size[u] < (int)taxa.size()) && IsSubset (b, &cluster[0], words))
+				{
+					inside.push_back (u);
+					continue;
+				}
+				if ((size[u] > (int)taxa.size()) && IsSubset (&cluster[0], b, words))
+				{
+					if (size[u] < size[above])
+						above = u;
+				}
+				else
+					conflict = u;
+				break;
+			}
+		}
+
+		if (conflict != -1)
+		{
+			const ClusterWord *b = &bits[(size_t)conflict * words];
+			int w[3] = { -1, -1, -1 };
+			for (int k = 0; k < words; k++)
+			{
+				ClusterWord part[3] = { cluster[k] & b[k], cluster[k] & ~b[k], b[k] & ~cluster[k] };
+				for (int j = 0; j < 3; j++)
+					if ((w[j] == -1) && part[j])
+						w[j] = 64 * k + LowestBit (part[j]);
+			}
+			Rejected.push_back (c);
+			Reason.push_back (Accepted[conflict - 1]);
+			Witness.insert (Witness.end(), w, w + 3);
+			continue;
+		}
+
+		// Add the candidate below the smallest cluster containing it,
+		// adopting that cluster's children inside it
+		int h = (int)parent.size();
+		parent.push_back (above);
+		size.push_back ((int)taxa.size());
+		mark.push_back (-1);
+		bits.insert (bits.end(), cluster.begin(), cluster.end());
+		for (int k = 0; k < (int)inside.size(); k++)
+			if (parent[inside[k]] == above)
+				parent[inside[k]] = h;
+		for (int k = 0; k < (int)taxa.size(); k++)
+			if (smallest[taxa[k]] == above)
+				smallest[taxa[k]] = h;
+		Accepted.push_back (c);
+	}
+}
+
+/**
+ * @class LargerCluster
+ * Orders positions in a list of candidates by decreasing size.
+ */
+class LargerCluster
+{
+public:
+	LargerCluster (const CandidateClusters *c, const std::vector<int> *list) { candidates = c; ids = list; };
+	bool operator() (int i, int j) const
+	{
+		int a = candidates->GetSize ((*ids)[i]), b = candidates->GetSize ((*ids)[j]);
+		if (a != b)
+			return a > b;
+		return i < j;
+	};
+protected:
+	const CandidateClusters *candidates;
+	const std::vector<int> *ids;
+};
+
+//------------------------------------------------------------------------------
+void GreedySupertree::BuildIndex (TreeIndex &t, std::vector<int> &node) const
+{
+	int m = (int)Accepted.size();
+	std::vector<int> order (m);
+	for (int k = 0; k < m; k++)
+		order[k] = k;
+	std::sort (order.begin(), order.end(), LargerCluster (Candidates, &Accepted));
+	ClusterHierarchy tree (Candidates->GetNumTaxa());
+	std::vector<int> taxa;
+	for (int k = 0; k < m; k++)
+	{
+		Candidates->GetCluster (Accepted[order[k]], taxa);
+		tree.Add (taxa, order[k]);
+	}
+	std::vector<int> h;
+	tree.BuildIndex (t, h);
+	node.assign (m, -1);
+	for (int j = 1; j < tree.GetNumNodes(); j++)
+		node[tree.GetId (j)] = h[j];
+}
+
+//------------------------------------------------------------------------------
+// Write a cluster as (a,b,c)
+static void WriteCluster (std::ostream &f, const std::vector<int> &taxa, const std::vector<std::string> &labels)
+{
+	f << "(";
+	for (int k = 0; k < (int)taxa.size(); k++)
+	{
+		if (k > 0)
+			f << ",";
+		f << labels[taxa[k]];
+	}
+	f << ")";
+}
+
+//------------------------------------------------------------------------------
+void GreedySupertree::Report (std::ostream &f, const std::vector<std::string> &labels)
+{
+	std::vector<int> taxa;
+	for (int k = 0; k < GetNumRejected(); k++)
+	{
+		int c = Rejected[k];
+		int s = Candidates->GetSupport (c), q = Candidates->GetConflict (c), p = Candidates->GetPermit (c);
+		double v, vplus, vminus;
+		SupportSummary::Indices (s, q, p, v, vplus, vminus);
+		Candidates->GetCluster (c, taxa);
+		WriteCluster (f, taxa, labels);
+		f << "\tS=" << s << " Q=" << q << " P=" << p << " v1=" << v << "\tconflicts with\t";
+		Candidates->GetCluster (Reason[k], taxa);
+		WriteCluster (f, taxa, labels);
+		int a, b, d;
+		GetWitness (k, a, b, d);
+		f << "\t" << labels[a] << " in both, " << labels[b] << " only in the first, "
+			<< labels[d] << " only in the second" << std::endl;
+	}
+}
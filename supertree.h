@@ -0,0 +1,313 @@
+/**
+ * @file supertree.h
+ *
+ * Supertrees assembled from the clusters of the input trees.
+ *
+ */
+
+#ifndef SUPERTREEH
+#define SUPERTREEH
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "treeindex.h"
+#include "succinct.h"
+#include "fingerprint.h"
+
+/**
+ * @class ClusterHierarchy
+ * A family of pairwise compatible clusters of taxa, stored as a tree whose
+ * root (node 0) is the set of all taxa and whose other nodes are the
+ * clusters, each below the smallest cluster containing it. Each taxon
+ * points to the smallest cluster that contains it.
+ *
+ * Clusters must be added in order of non-increasing size. A new cluster
+ * is then compatible with all the others if and only if its taxa all have
+ * the same smallest cluster, so the test takes O(|cluster|) time and
+ * usually stops at the second taxon if it fails.
+ */
+class ClusterHierarchy
+{
+public:
+	/**
+	 * @param numTaxa number of taxa in the profile
+	 */
+	ClusterHierarchy (int numTaxa = 0);
+	virtual ~ClusterHierarchy () {};
+
+	/**
+	 * @return true if the cluster is compatible with, and different from,
+	 * all the clusters so far. It must be no larger than any of them.
+	 */
+	bool Fits (const std::vector<int> &taxa) const;
+	/**
+	 * Add a cluster that fits.
+	 * @param taxa the cluster
+	 * @param id an identifier for the cluster
+	 */
+	virtual void Add (const std::vector<int> &taxa, int id);
+
+	int GetNumTaxa () const { return NumTaxa; };
+	/**
+	 * @return the number of nodes, one more than the number of clusters
+	 */
+	int GetNumNodes () const { return (int)Parent.size(); };
+	int GetId (int h) const { return Id[h]; };
+	int GetSize (int h) const { return Size[h]; };
+
+	/**
+	 * Find the clusters incompatible with a set of taxa, in O(number of
+	 * clusters + |taxa|) time.
+	 * @param taxa the set
+	 * @param count scratch space
+	 * @param ids the identifiers of the incompatible clusters
+	 */
+	virtual void FindConflicts (const std::vector<int> &taxa, std::vector<int> &count, std::vector<int> &ids) const;
+	/**
+	 * Build the tree, with every taxon as a leaf.
+	 * @param t the indexed tree
+	 * @param node the node of t for each node of the hierarchy
+	 */
+	virtual void BuildIndex (TreeIndex &t, std::vector<int> &node) const;
+
+protected:
+	int NumTaxa;
+	/**
+	 * Smallest cluster containing each taxon
+	 */
+	std::vector<int> Smallest;
+	std::vector<int> Parent;
+	std::vector<int> Size;
+	std::vector<int> Id;
+};
+
+/**
+ * @class CandidateClusters
+ * The distinct nontrivial clusters of a set of input trees, with the
+ * number of input trees that support, conflict with and permit each, in the
+ * sense of SupportEngine, when it is taken as a clade of a supertree on
+ * all the taxa.
+ *
+ * Clusters are identified by their fingerprints, and only the tree and
+ * node of the first occurrence of each is kept, the trees themselves
+ * being stored in a TreeCollection. To count support and conflict the
+ * candidates are packed, largest first, into as few ClusterHierarchy
+ * trees as first fit allows (one if the input trees are all compatible),
+ * and each of these is classified against every input tree by a
+ * SupportEngine, which handles the restriction of each clade to the
+ * taxa of an input tree. The hierarchies are classified in parallel if
+ * compiled with OpenMP.
+ */
+class CandidateClusters
+{
+public:
+	/**
+	 * @param numTaxa number of taxa in the profile
+	 */
+	CandidateClusters (int numTaxa);
+	virtual ~CandidateClusters () {};
+
+	/**
+	 * Add an input tree and any clusters of it not seen before.
+	 */
+	virtual void AddTree (const TreeIndex &t);
+	/**
+	 * Count the input trees supporting, conflicting with and permitting
+	 * each candidate. Call once all the trees have been added.
+	 */
+	virtual void Count ();
+
+	int GetNumTaxa () const { return NumTaxa; };
+	int GetNumTrees () const { return Trees.GetNumTrees(); };
+	const TreeCollection &GetTrees () const { return Trees; };
+	int GetNumCandidates () const { return (int)Size.size(); };
+	/**
+	 * @return the number of hierarchies used by Count
+	 */
+	int GetNumHierarchies () const { return NumHierarchies; };
+	int GetSize (int c) const { return Size[c]; };
+	int GetSupport (int c) const { return Support[c]; };
+	int GetConflict (int c) const { return Conflict[c]; };
+	int GetPermit (int c) const { return Permit[c]; };
+	/**
+	 * @return the first input tree (from 0) with cluster c
+	 */
+	int GetTree (int c) const { return Tree[c]; };
+	/**
+	 * Extract the taxa of cluster c.
+	 */
+	virtual void GetCluster (int c, std::vector<int> &taxa);
+
+protected:
+	int NumTaxa;
+	int NumHierarchies;
+	TreeCollection Trees;
+	ClusterFingerprints Keys;
+	FingerprintTable Table;
+	/**
+	 * Input tree and node (position of its opening parenthesis) of each
+	 * candidate
+	 */
+	std::vector<int> Tree;
+	std::vector<int> Position;
+	std::vector<int> Size;
+	std::vector<int> Support;
+	std::vector<int> Conflict;
+	std::vector<int> Permit;
+	/**
+	 * Last tree unpacked by GetCluster
+	 */
+	int Cached;
+	SuccinctTree CachedTree;
+};
+
+/**
+ * @class MajorityRuleSupertree
+ * Majority-rule supertrees (Cotton and Wilkinson 2007, Syst. Biol.
+ * 56:445-452), built from the candidate clusters supported by more input
+ * trees than conflict with them (S > Q). These need not be compatible
+ * with each other.
+ *
+ * - MR(-) keeps only the majority clusters compatible with all the other
+ * majority clusters.
+ *
+ * - MR(+) also resolves the conflicts between majority clusters, taking
+ * them in order of decreasing S - Q (then S, then size) and keeping each
+ * one compatible with those already kept.
+ *
+ * The incompatible pairs are found by packing the majority clusters into
+ * ClusterHierarchy trees, as CandidateClusters does, and testing each
+ * cluster against the hierarchies other than its own.
+ */
+class MajorityRuleSupertree
+{
+public:
+	/**
+	 * @param candidates the candidate clusters, after Count
+	 */
+	MajorityRuleSupertree (CandidateClusters *candidates);
+	virtual ~MajorityRuleSupertree () {};
+
+	/**
+	 * Choose the clusters.
+	 * @param plus build the MR(+) rather than the MR(-) supertree
+	 */
+	virtual void Compute (bool plus);
+
+	/**
+	 * @return the number of candidates with S > Q
+	 */
+	int GetNumMajority () const { return NumMajority; };
+	/**
+	 * @return the number of those incompatible with another
+	 */
+	int GetNumContested () const { return NumContested; };
+	int GetNumClusters () const { return Tree.GetNumNodes() - 1; };
+	/**
+	 * @return the candidate that is the kth cluster of the supertree
+	 */
+	int GetCluster (int k) const { return Tree.GetId (k + 1); };
+	/**
+	 * Build the supertree.
+	 * @param t the indexed tree
+	 * @param node the node of t for each cluster
+	 */
+	virtual void BuildIndex (TreeIndex &t, std::vector<int> &node) const;
+
+protected:
+	CandidateClusters *Candidates;
+	int NumMajority;
+	int NumContested;
+	ClusterHierarchy Tree;
+};
+
+/**
+ * Orders for GreedySupertree
+ */
+enum
+{
+	goV = 0,		// V = (S - Q) / (S + Q)
+	goNetSupport	// S - Q
+};
+
+/**
+ * @class GreedySupertree
+ * A supertree built by taking the candidate clusters in order of
+ * decreasing support, by V or by S - Q (ties going to the larger S - Q,
+ * then S, then size), and adding each one that is compatible with all
+ * those already added. Every candidate is considered, so the tree is as
+ * resolved as the candidates allow.
+ *
+ * The clusters added so far are kept as a tree in which each cluster is
+ * a bitset over the taxa and each taxon points to the smallest cluster
+ * containing it. The only clusters that can overlap a candidate are
+ * those on the paths from its taxa to the root, so only these are
+ * tested, each with a bitwise subset test, stopping at the first cluster
+ * that contains the candidate. A candidate is rejected as soon as one of
+ * them is neither a subset nor a superset of it, and the first such
+ * cluster is recorded with three taxa showing the conflict. Added
+ * clusters take the place of their parent for their taxa, and adopt the
+ * children of that parent which they contain, so the clusters can be
+ * added in any order of size.
+ */
+class GreedySupertree
+{
+public:
+	/**
+	 * @param candidates the candidate clusters, after Count
+	 */
+	GreedySupertree (CandidateClusters *candidates);
+	virtual ~GreedySupertree () {};
+
+	/**
+	 * @param order goV (the default) or goNetSupport
+	 */
+	virtual void SetOrder (int order) { Order = order; };
+	virtual void Compute ();
+
+	int GetNumClusters () const { return (int)Accepted.size(); };
+	/**
+	 * @return the candidate added kth
+	 */
+	int GetCluster (int k) const { return Accepted[k]; };
+	int GetNumRejected () const { return (int)Rejected.size(); };
+	/**
+	 * @return the candidate rejected kth
+	 */
+	int GetRejected (int k) const { return Rejected[k]; };
+	/**
+	 * @return the cluster already added that the kth rejected candidate
+	 * conflicts with
+	 */
+	int GetReason (int k) const { return Reason[k]; };
+	/**
+	 * A taxon in both the kth rejected candidate and the cluster it
+	 * conflicts with (a), one only in the candidate (b) and one only in the
+	 * cluster (c).
+	 */
+	void GetWitness (int k, int &a, int &b, int &c) const { a = Witness[3 * k]; b = Witness[3 * k + 1]; c = Witness[3 * k + 2]; };
+
+	/**
+	 * Build the supertree.
+	 * @param t the indexed tree
+	 * @param node the node of t for each cluster, in the order added
+	 */
+	virtual void BuildIndex (TreeIndex &t, std::vector<int> &node) const;
+	/**
+	 * Write one line per rejected candidate: the candidate, its S, Q, P
+	 * and V, the cluster it conflicts with and the three taxa.
+	 */
+	virtual void Report (std::ostream &f, const std::vector<std::string> &labels);
+
+protected:
+	CandidateClusters *Candidates;
+	int Order;
+	std::vector<int> Accepted;
+	std::vector<int> Rejected;
+	std::vector<int> Reason;
+	std::vector<int> Witness;
+};
+
+#endif
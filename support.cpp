@@ -0,0 +1,539 @@
+#include "support.h"
+
+#include <algorithm>
+
+//------------------------------------------------------------------------------
+SupportEngine::SupportEngine (const TreeIndex *supertree)
+	: Sliced (supertree)
+{
+	ST = supertree;
+	BothSides = false;
+	BitSliced = true;
+	Retention = false;
+	Specialised = true;
+	Observer = NULL;
+	Witnesses = NULL;
+	Mask = NULL;
+	Weights = NULL;
+	PosOfTaxon.assign (ST->GetNumTaxa(), -1);
+	Clear ();
+}
+
+//------------------------------------------------------------------------------
+void SupportEngine::Clear ()
+{
+	NumTrees = 0;
+	InputClusters.clear ();
+	Undisplayed.clear ();
+	InputConflicts.clear ();
+	Sliced.Clear ();
+	for (int v = svSupport; v <= svPermit; v++)
+	{
+		Tally[v].assign (ST->GetNumNodes(), 0);
+		CTally[v].assign (ST->GetNumNodes(), 0);
+	}
+	for (int v = svSupport; v <= svConflict; v++)
+		WTally[v].assign (ST->GetNumNodes(), 0.0);
+}
+
+//------------------------------------------------------------------------------
+// Number the input leaves that are in the supertree, in preorder, and
+// store each nontrivial non-root cluster as an interval of these numbers.
+void SupportEngine::PrepareTree (const TreeIndex &t)
+{
+	int nleaves = t.GetNumLeaves ();
+	Kept.assign (nleaves + 1, 0);
+	NumPos = 0;
+	Missing = 0;
+	LeafOfPos.clear ();
+	for (int k = 0; k < nleaves; k++)
+	{
+		Kept[k] = NumPos;
+		int x = t.GetTaxon (t.GetLeafAtRank (k));
+		if (Deleted (x))
+			continue;
+		if ((x >= 0) && (x < ST->GetNumTaxa()) && (ST->GetLeafOfTaxon (x) != -1)
+			&& (PosOfTaxon[x] == -1))
+		{
+			PosOfTaxon[x] = NumPos++;
+			LeafOfPos.push_back (t.GetLeafAtRank (k));
+		}
+		else if ((x < 0) || (x >= ST->GetNumTaxa()) || (ST->GetLeafOfTaxon (x) == -1))
+			Missing++;
+	}
+	Kept[nleaves] = NumPos;
+
+	ClusterLo.clear ();
+	ClusterHi.clear ();
+	ClusterNext.clear ();
+	ClusterWeight.clear ();
+	ClusterHead.assign (NumPos, -1);
+	for (int i = 0; i < t.GetNumNodes(); i++)
+	{
+		if (!t.IsLeaf (i) && (i != t.GetRoot()))
+		{
+			int lo = Kept[t.GetLeafLo (i)];
+			int hi = Kept[t.GetLeafHi (i) + 1] - 1;
+			if ((hi - lo + 1 >= 2) && (hi - lo + 1 < NumPos))
+			{
+				ClusterNext.push_back (ClusterHead[lo]);
+				ClusterHead[lo] = (int)ClusterLo.size();
+				ClusterLo.push_back (lo);
+				ClusterHi.push_back (hi);
+				ClusterWeight.push_back (Weights ? (*Weights)[i] : 1.0);
+			}
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+int SupportEngine::FindCluster (int lo, int hi) const
+{
+	for (int c = ClusterHead[lo]; c != -1; c = ClusterNext[c])
+		if (ClusterHi[c] == hi)
+			return c;
+	return -1;
+}
+
+//------------------------------------------------------------------------------
+void SupportEngine::FoundCluster (int lo, int hi)
+{
+	for (int c = ClusterHead[lo]; c != -1; c = ClusterNext[c])
+		if (ClusterHi[c] == hi)
+			ClusterFound[c] = true;
+}
+
+//------------------------------------------------------------------------------
+// Options are tested as (options & ko...), which the compiler folds to a
+// constant unless OPTIONS is koGeneric, so a kernel keeps only the code for
+// the options it was compiled for.
+template <int OPTIONS>
+void SupportEngine::Classify (int lo, int hi, int count, int first, int last, int options, int &verdict, int &cverdict)
+{
+	if (OPTIONS != koGeneric)
+		options = OPTIONS;
+	int n = NumPos;
+	int ccount = n - count;
+
+	// A clade is supported if it is an input cluster, which requires its
+	// positions to be an interval. Taxa missing from the supertree are
+	// outside every clade and its complement, so rule out support.
+	SupportedBy = -1;
+	if ((Missing == 0) && (hi - lo + 1 == count))
+		SupportedBy = FindCluster (lo, hi);
+	bool sup = (SupportedBy != -1);
+	bool csup = false;
+
+	// A single taxon is compatible with every cluster
+	bool con = false;
+	bool ccon = false;
+	ConflictWith = -1;
+	ConflictWeight = 0.0;
+	bool needl = !sup && (count >= 2);
+	if (needl || (options & koBothSides))
+	{
+		// Count the members of the clade in any interval using prefix sums
+		Prefix.assign (n + 1, 0);
+		for (int i = first; i <= last; i++)
+			Prefix[LeafSeq[i] + 1] = 1;
+
+		// The complement may be an interval even if the clade is not
+		// (if the clade is made up of a prefix and a suffix)
+		if ((options & koBothSides) && (Missing == 0) && (ccount >= 2))
+		{
+			int clo = 0;
+			while (Prefix[clo + 1] == 1)
+				clo++;
+			int chi = n - 1;
+			while (Prefix[chi + 1] == 1)
+				chi--;
+			csup = (chi - clo + 1 == ccount) && (FindCluster (clo, chi) != -1);
+		}
+		for (int i = 0; i < n; i++)
+			Prefix[i + 1] += Prefix[i];
+
+		bool needc = (options & koBothSides) && !csup;
+		int m = (int)ClusterLo.size();
+		for (int c = 0; (c < m) && (needl || needc); c++)
+		{
+			int size = ClusterHi[c] - ClusterLo[c] + 1;
+			int in = Prefix[ClusterHi[c] + 1] - Prefix[ClusterLo[c]];
+			if ((in > 0) && (in < size))
+			{
+				// Cluster overlaps clade without being contained in it
+				if ((in < count) && !con)
+				{
+					con = true;
+					ConflictWith = c;
+				}
+				if ((options & koRetention) && (in < count))
+					ClusterConflict[c] = true;
+				if ((options & koWeighted) && (in < count))
+					ConflictWeight = std::max (ConflictWeight, ClusterWeight[c]);
+				if (size - in < ccount)
+					ccon = true;
+			}
+			if ((!needl || (con && !(options & (koRetention | koWeighted)))) && (!needc || ccon))
+				break;
+		}
+	}
+
+	verdict = sup ? svSupport : (con ? svConflict : svPermit);
+	cverdict = csup ? svSupport : (ccon ? svConflict : svPermit);
+}
+
+//------------------------------------------------------------------------------
+template <int OPTIONS>
+void SupportEngine::ClassifyNodes (const TreeIndex &t)
+{
+	const int options = (OPTIONS == koGeneric) ? GetOptions () : OPTIONS;
+	int m = Sub.GetNumNodes();
+	for (int r = 0; r < m; r++)
+	{
+		int h = Sub.Host[r];
+		if (ST->IsLeaf (h))
+		{
+			int pos = PosOfTaxon[ST->GetTaxon (h)];
+			Lo[r] = Hi[r] = pos;
+			Count[r] = 1;
+			First[r] = Last[r] = (int)LeafSeq.size();
+			LeafSeq.push_back (pos);
+		}
+		int a = Sub.Parent[r];
+		if (a != -1)
+		{
+			Lo[a] = std::min (Lo[a], Lo[r]);
+			Hi[a] = std::max (Hi[a], Hi[r]);
+			Count[a] += Count[r];
+			First[a] = std::min (First[a], First[r]);
+			Last[a] = std::max (Last[a], Last[r]);
+
+			if ((Count[r] >= 2) && (Hi[r] - Lo[r] + 1 == Count[r]))
+				FoundCluster (Lo[r], Hi[r]);
+			Classify<OPTIONS> (Lo[r], Hi[r], Count[r], First[r], Last[r], options, Verdict[r], CVerdict[r]);
+			if ((options & koWitnesses) && (Verdict[r] == svConflict))
+				FindWitness (t, First[r], Last[r], WitnessA[r], WitnessB[r], WitnessC[r]);
+
+			// Supertree nodes from Host[r] up to (but excluding) Host[a]
+			// all restrict to this clade
+			Tally[Verdict[r]][h]++;
+			Tally[Verdict[r]][Sub.Host[a]]--;
+			if (options & koBothSides)
+			{
+				CTally[CVerdict[r]][h]++;
+				CTally[CVerdict[r]][Sub.Host[a]]--;
+			}
+			if ((Verdict[r] == svSupport) || (Verdict[r] == svConflict))
+			{
+				double w = 1.0;
+				if (options & koWeighted)
+					w = (Verdict[r] == svSupport) ? ClusterWeight[SupportedBy] : ConflictWeight;
+				WTally[Verdict[r]][h] += w;
+				WTally[Verdict[r]][Sub.Host[a]] -= w;
+			}
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+const SupportEngine::NodeKernel SupportEngine::Kernels[koGeneric + 1] =
+{
+	&SupportEngine::ClassifyNodes<0>,
+	&SupportEngine::ClassifyNodes<1>,
+	&SupportEngine::ClassifyNodes<2>,
+	&SupportEngine::ClassifyNodes<3>,
+	&SupportEngine::ClassifyNodes<4>,
+	&SupportEngine::ClassifyNodes<5>,
+	&SupportEngine::ClassifyNodes<6>,
+	&SupportEngine::ClassifyNodes<7>,
+	&SupportEngine::ClassifyNodes<8>,
+	&SupportEngine::ClassifyNodes<9>,
+	&SupportEngine::ClassifyNodes<10>,
+	&SupportEngine::ClassifyNodes<11>,
+	&SupportEngine::ClassifyNodes<12>,
+	&SupportEngine::ClassifyNodes<13>,
+	&SupportEngine::ClassifyNodes<14>,
+	&SupportEngine::ClassifyNodes<15>,
+	&SupportEngine::ClassifyNodes<koGeneric>
+};
+
+//------------------------------------------------------------------------------
+void SupportEngine::AddTree (const TreeIndex &t, int id, const std::vector<double> *weights)
+{
+	NumTrees++;
+	if (BitSliced && !BothSides && !Observer && !Witnesses && !Mask && !weights
+		&& Sliced.AddTree (t, NumTrees - 1))
+	{
+		// Counts filled in by Finish
+		InputClusters.push_back (0);
+		Undisplayed.push_back (0);
+		InputConflicts.push_back (0);
+		return;
+	}
+	Weights = weights;
+	PrepareTree (t);
+
+	Leaves.clear ();
+	for (int k = 0; k < t.GetNumLeaves(); k++)
+	{
+		int x = t.GetTaxon (t.GetLeafAtRank (k));
+		if ((x >= 0) && (x < ST->GetNumTaxa()) && (PosOfTaxon[x] != -1))
+			Leaves.push_back (ST->GetLeafOfTaxon (x));
+	}
+	ST->Induce (Leaves, Sub);
+	ClusterFound.assign (ClusterLo.size(), false);
+	ClusterConflict.assign (ClusterLo.size(), false);
+
+	// Range of positions, and of leaves of the induced subtree (which are
+	// contiguous in postorder) below each induced node
+	int m = Sub.GetNumNodes();
+	Lo.assign (m, NumPos);
+	Hi.assign (m, -1);
+	Count.assign (m, 0);
+	First.assign (m, m);
+	Last.assign (m, -1);
+	Verdict.assign (m, svIrrelevant);
+	CVerdict.assign (m, svIrrelevant);
+	if (Witnesses)
+	{
+		WitnessA.assign (m, -1);
+		WitnessB.assign (m, -1);
+		WitnessC.assign (m, -1);
+	}
+	LeafSeq.clear ();
+	(this->*Kernels[Specialised ? GetOptions () : koGeneric]) (t);
+
+	// The input tree is displayed if each of its clusters is a cluster of
+	// the induced subtree
+	int undisplayed = 0;
+	int conflicts = 0;
+	for (int c = 0; c < (int)ClusterLo.size(); c++)
+	{
+		if (!ClusterFound[c])
+			undisplayed++;
+		if (ClusterConflict[c])
+			conflicts++;
+	}
+	InputClusters.push_back ((int)ClusterLo.size());
+	Undisplayed.push_back (undisplayed);
+	InputConflicts.push_back (conflicts);
+
+	if (Observer)
+		ReportVerdicts (id);
+	if (Witnesses)
+		ReportWitnesses (id);
+
+	for (int k = 0; k < t.GetNumLeaves(); k++)
+	{
+		int x = t.GetTaxon (t.GetLeafAtRank (k));
+		if ((x >= 0) && (x < ST->GetNumTaxa()))
+			PosOfTaxon[x] = -1;
+	}
+	Weights = NULL;
+}
+
+//------------------------------------------------------------------------------
+// The conflicting cluster X contains a member of the clade and a
+// non-member, and misses a member of the clade. Of the pairs of
+// consecutive positions in X that differ in membership, take the one
+// whose LCA in the input tree is deepest, so the triplet is displayed by
+// the smallest possible input cluster.
+void SupportEngine::FindWitness (const TreeIndex &t, int first, int last, int &a, int &b, int &c) const
+{
+	int lo = ClusterLo[ConflictWith];
+	int hi = ClusterHi[ConflictWith];
+	int in = -1, out = -1, depth = -1;
+	for (int i = lo; i < hi; i++)
+	{
+		bool here = (Prefix[i + 1] - Prefix[i]) == 1;
+		bool next = (Prefix[i + 2] - Prefix[i + 1]) == 1;
+		if (here != next)
+		{
+			int d = t.GetDepth (t.LCA (LeafOfPos[i], LeafOfPos[i + 1]));
+			if (d > depth)
+			{
+				depth = d;
+				in = here ? i : i + 1;
+				out = here ? i + 1 : i;
+			}
+		}
+	}
+	int other = -1;
+	for (int i = first; (i <= last) && (other == -1); i++)
+		if ((LeafSeq[i] < lo) || (LeafSeq[i] > hi))
+			other = LeafSeq[i];
+
+	a = t.GetTaxon (LeafOfPos[in]);
+	b = t.GetTaxon (LeafOfPos[out]);
+	c = t.GetTaxon (LeafOfPos[other]);
+}
+
+//------------------------------------------------------------------------------
+void SupportEngine::ReportWitnesses (int id)
+{
+	for (int r = 0; r < Sub.GetNumNodes() - 1; r++)
+	{
+		if (Verdict[r] != svConflict)
+			continue;
+		int top = Sub.Host[Sub.Parent[r]];
+		for (int u = Sub.Host[r]; u != top; u = ST->GetParent (u))
+			Witnesses->Witnessed (id, u, WitnessA[r], WitnessB[r], WitnessC[r]);
+	}
+}
+
+//------------------------------------------------------------------------------
+void SupportEngine::ReportVerdicts (int id)
+{
+	NodeVerdict.assign (ST->GetNumNodes(), svIrrelevant);
+	for (int r = 0; r < Sub.GetNumNodes() - 1; r++)
+	{
+		int top = Sub.Host[Sub.Parent[r]];
+		for (int u = Sub.Host[r]; u != top; u = ST->GetParent (u))
+			NodeVerdict[u] = Verdict[r];
+	}
+	for (int u = ST->GetNumLeaves(); u < ST->GetNumNodes(); u++)
+		if (u != ST->GetRoot())
+			Observer->Classified (id, u, NodeVerdict[u]);
+}
+
+//------------------------------------------------------------------------------
+void SupportEngine::AddTrees (const TreeCollection &trees, int firstId)
+{
+	SuccinctTree s;
+	TreeIndex t;
+	for (int k = 0; k < trees.GetNumTrees(); k++)
+	{
+		trees.GetTree (k, s);
+		t.Build (s, ST->GetNumTaxa());
+		if (Witnesses)
+			t.BuildLCA ();
+		AddTree (t, firstId + k);
+	}
+}
+
+//------------------------------------------------------------------------------
+void SupportEngine::Finish ()
+{
+	// Trees classified in blocks
+	Sliced.Flush ();
+	for (int u = 0; u < ST->GetNumNodes(); u++)
+	{
+		for (int v = svSupport; v <= svPermit; v++)
+			Tally[v][u] += Sliced.GetDifference (u, v);
+		for (int v = svSupport; v <= svConflict; v++)
+			WTally[v][u] += Sliced.GetDifference (u, v);
+	}
+	for (int i = 0; i < Sliced.GetNumTrees(); i++)
+	{
+		int k, clusters, undisplayed, conflicts;
+		Sliced.GetTreeCounts (i, k, clusters, undisplayed, conflicts);
+		InputClusters[k] = clusters;
+		Undisplayed[k] = undisplayed;
+		InputConflicts[k] = Retention ? conflicts : 0;
+	}
+
+	// Sum differences over subtrees, visiting children before parents
+	for (int k = ST->GetNumNodes() - 1; k > 0; k--)
+	{
+		int u = ST->GetNodeAtPreorder (k);
+		int a = ST->GetParent (u);
+		for (int v = svSupport; v <= svPermit; v++)
+		{
+			Tally[v][a] += Tally[v][u];
+			CTally[v][a] += CTally[v][u];
+		}
+		for (int v = svSupport; v <= svConflict; v++)
+			WTally[v][a] += WTally[v][u];
+	}
+}
+
+//------------------------------------------------------------------------------
+void SupportSummary::Clear ()
+{
+	Clades = 0;
+	u1 = u2 = u3 = u4 = u5 = 0;
+	SumV = SumVPlus = SumVMinus = 0.0;
+	MinV = MinVPlus = MinVMinus = 1.0;
+	MaxV = MaxVPlus = MaxVMinus = -1.0;
+}
+
+//------------------------------------------------------------------------------
+void SupportSummary::Indices (double s, double q, int p, double &v, double &vplus, double &vminus)
+{
+	if (s + q != 0)
+		v = (s - q) / (s + q);
+	else
+		v = 0;
+	if (s + q + p != 0)
+	{
+		vplus = ((s - q) + p) / (s + q + p);
+		vminus = ((s - q) - p) / (s + q + p);
+	}
+	else
+	{
+		vplus = 0;
+		vminus = 0;
+	}
+}
+
+//------------------------------------------------------------------------------
+void SupportSummary::AddClade (double s, double q, int p, int r, int t)
+{
+	Clades++;
+	if (s == 0)
+	{
+		u1++;
+		if (q > 0) u2++;
+		if (!(q < (double) (t - r) / 2)) u3++;
+		if (q == (t - r)) u4++;
+		if (q == t) u5++;
+	}
+	double v, vplus, vminus;
+	Indices (s, q, p, v, vplus, vminus);
+	SumV += v;
+	SumVPlus += vplus;
+	SumVMinus += vminus;
+	MinV = std::min (MinV, v);
+	MaxV = std::max (MaxV, v);
+	MinVPlus = std::min (MinVPlus, vplus);
+	MaxVPlus = std::max (MaxVPlus, vplus);
+	MinVMinus = std::min (MinVMinus, vminus);
+	MaxVMinus = std::max (MaxVMinus, vminus);
+}
+
+//------------------------------------------------------------------------------
+void SupportSummary::Add (const SupportSummary &other)
+{
+	Clades += other.Clades;
+	u1 += other.u1;
+	u2 += other.u2;
+	u3 += other.u3;
+	u4 += other.u4;
+	u5 += other.u5;
+	SumV += other.SumV;
+	SumVPlus += other.SumVPlus;
+	SumVMinus += other.SumVMinus;
+}
+
+//------------------------------------------------------------------------------
+void SupportSummary::Subtract (const SupportSummary &other)
+{
+	Clades -= other.Clades;
+	u1 -= other.u1;
+	u2 -= other.u2;
+	u3 -= other.u3;
+	u4 -= other.u4;
+	u5 -= other.u5;
+	SumV -= other.SumV;
+	SumVPlus -= other.SumVPlus;
+	SumVMinus -= other.SumVMinus;
+}
+
+//------------------------------------------------------------------------------
+void SupportSummary::Write (std::ostream &f) const
+{
+	f << u1 << "\t" << u2 << "\t" << u3 << "\t" << u4 << "\t" << u5 << "\t";
+	f << MeanV() << " (" << MinV << "," << MaxV << ")" << "\t";
+	f << MeanVPlus() << " (" << MinVPlus << "," << MaxVPlus << ")" << "\t";
+	f << MeanVMinus() << " (" << MinVMinus << "," << MaxVMinus << ")" << "\t";
+}
@@ -0,0 +1,392 @@
+/**
+ * @file support.h
+ *
+ * Classify supertree clades against a set of input trees, and summarise the
+ * support measures of Wilkinson et al. (2005, Syst. Biol. 54:823-831).
+ *
+ */
+
+#ifndef SUPPORTH
+#define SUPPORTH
+
+#include <iostream>
+#include <vector>
+
+#include "treeindex.h"
+#include "succinct.h"
+#include "bitslice.h"
+
+/**
+ * Relationship between a supertree clade and an input tree.
+ */
+enum
+{
+	svIrrelevant = 0,	// input tree lacks taxa from the clade or from its complement
+	svSupport,			// input tree has the clade (restricted to its leaves)
+	svConflict,			// input tree has a cluster incompatible with the clade
+	svPermit			// neither supports nor conflicts
+};
+
+/**
+ * @class SupportObserver
+ * Receives every (clade, input tree) verdict found by a SupportEngine. Only
+ * needed when the individual verdicts, rather than the totals, are wanted
+ * (e.g., for verbose output).
+ */
+class SupportObserver
+{
+public:
+	virtual ~SupportObserver () {};
+	/**
+	 * @param tree the id of the input tree passed to SupportEngine::AddTree
+	 * @param node the supertree node (index into the TreeIndex)
+	 * @param verdict one of svIrrelevant, svSupport, svConflict, svPermit
+	 */
+	virtual void Classified (int tree, int node, int verdict) = 0;
+};
+
+/**
+ * @class WitnessObserver
+ * Receives a witness for every (clade, input tree) conflict found by a
+ * SupportEngine: a rooted triplet ab|c displayed by the input tree that
+ * the clade contradicts, because the clade contains a and c but not b.
+ */
+class WitnessObserver
+{
+public:
+	virtual ~WitnessObserver () {};
+	/**
+	 * @param tree the id of the input tree passed to SupportEngine::AddTree
+	 * @param node the supertree node (index into the TreeIndex)
+	 * @param a,b,c taxa of the triplet ab|c
+	 */
+	virtual void Witnessed (int tree, int node, int a, int b, int c) = 0;
+};
+
+/**
+ * @class SupportEngine
+ * Counts, for each supertree node, the number of input trees that support,
+ * conflict with, permit, or are irrelevant to the clade below that node.
+ *
+ * A clade C is relevant to an input tree with leaf set L if C and its
+ * complement both contain taxa in L. The verdict depends only on C restricted
+ * to L, so each input tree is compared with the subtree of the supertree
+ * induced by L, whose clusters are exactly the distinct restricted clades.
+ * The verdict for an induced node applies to the path of supertree nodes it
+ * represents, which is recorded by adding at the bottom of the path and
+ * subtracting at the top. Finish sums these differences over subtrees. The
+ * cost of each input tree is therefore independent of the size of the
+ * supertree, apart from the induced subtree construction.
+ *
+ * If SetBothSides is on, the verdicts are also found for the complement
+ * of each clade (the taxa not below the node), which is what is needed if
+ * the supertree were rooted within that clade.
+ *
+ * Input trees are treated as rooted. Taxa absent from the supertree are
+ * ignored, except that (as in earlier versions of stsupport) an input tree
+ * containing any such taxa cannot support a clade.
+ *
+ * Small input trees are by default passed to a BitSlicedClassifier, which
+ * classifies them 64 at a time, unless verdicts are wanted for the
+ * complement, for each tree (observers), or for a subset of the taxa,
+ * or the tree is weighted.
+ *
+ * Other trees are classified by a kernel compiled for the options in force
+ * (complements, retention, weights and witnesses), chosen once per input
+ * tree, so the loop over its clades tests none of them and makes no
+ * virtual calls. SetSpecialised (false) uses a generic kernel instead,
+ * which tests the options for every clade; the counts are the same.
+ */
+class SupportEngine
+{
+public:
+	/**
+	 * @param supertree the indexed supertree. BuildLCA must have been called.
+	 */
+	SupportEngine (const TreeIndex *supertree);
+	virtual ~SupportEngine () {};
+
+	/**
+	 * Reset all counts to zero.
+	 */
+	virtual void Clear ();
+	/**
+	 * Classify every supertree clade against an input tree.
+	 * @param t the indexed input tree
+	 * @param id identifier passed on to the observer
+	 * @param weights weight of each node of t (e.g., from LabelSupport),
+	 * for GetWeightedCount, or NULL to count the tree as 1
+	 */
+	virtual void AddTree (const TreeIndex &t, int id, const std::vector<double> *weights = NULL);
+	/**
+	 * Classify every supertree clade against each tree of a collection,
+	 * unpacking one tree at a time.
+	 * @param trees the input trees
+	 * @param firstId identifier of the first tree, the others following on
+	 */
+	virtual void AddTrees (const TreeCollection &trees, int firstId);
+	/**
+	 * Compute the counts for each node. Call once after all trees have been added.
+	 */
+	virtual void Finish ();
+
+	virtual void SetBothSides (bool on) { BothSides = on; };
+	/**
+	 * Classify small input trees in blocks with a BitSlicedClassifier
+	 * (the default) rather than one at a time. The counts are the same.
+	 */
+	virtual void SetBitSliced (bool on) { BitSliced = on; };
+	/**
+	 * Classify input trees with the kernel compiled for the options in
+	 * force (the default) rather than the generic one.
+	 */
+	virtual void SetSpecialised (bool on) { Specialised = on; };
+	/**
+	 * Also classify the clusters of each input tree against the supertree
+	 * restricted to its taxa. Conflict is symmetric, so this only means
+	 * scanning all the input clusters for each clade, rather than
+	 * stopping at the first conflict.
+	 */
+	virtual void SetRetention (bool on) { Retention = on; };
+	virtual void SetObserver (SupportObserver *o) { Observer = o; };
+	/**
+	 * Find a witness triplet for each conflict. Input trees must then have
+	 * had BuildLCA called.
+	 */
+	virtual void SetWitnessObserver (WitnessObserver *o) { Witnesses = o; };
+	/**
+	 * Restrict the analysis to a subset of the taxa. Taxa x with
+	 * (*mask)[x] false are treated as deleted from the supertree and from
+	 * every input tree. The counts for a supertree node are then those of
+	 * its clade restricted to the remaining taxa. Pass NULL to use all taxa.
+	 */
+	virtual void SetTaxonMask (const std::vector<bool> *mask) { Mask = mask; };
+
+	int GetNumTrees () const { return NumTrees; };
+	/**
+	 * @return the number of nontrivial clusters of the kth input tree added,
+	 * restricted to the taxa it shares with the supertree
+	 */
+	int GetNumInputClusters (int k) const { return InputClusters[k]; };
+	/**
+	 * @return the number of those clusters that are not clusters of the
+	 * supertree restricted to the same taxa
+	 */
+	int GetNumUndisplayed (int k) const { return Undisplayed[k]; };
+	/**
+	 * @return true if the supertree, restricted to the taxa of the kth
+	 * input tree, displays that tree
+	 */
+	bool IsDisplayed (int k) const { return Undisplayed[k] == 0; };
+	/**
+	 * @return the number of clusters of the kth input tree that conflict
+	 * with the restricted supertree. Requires SetRetention (true). The
+	 * remaining clusters are either retained (GetNumInputClusters -
+	 * GetNumUndisplayed of them) or permitted.
+	 */
+	int GetNumInputConflicts (int k) const { return InputConflicts[k]; };
+	/**
+	 * @return the number of input trees with the given verdict on the
+	 * clade below node
+	 */
+	int GetCount (int node, int verdict) const
+	{
+		if (verdict == svIrrelevant)
+			return NumTrees - Tally[svSupport][node] - Tally[svConflict][node] - Tally[svPermit][node];
+		return Tally[verdict][node];
+	};
+	/**
+	 * @return the number of input trees with the given verdict on the
+	 * clade below node, a supporting tree counting as the weight of its
+	 * cluster equal to the clade, and a conflicting tree as the largest
+	 * weight of its clusters that conflict with the clade. Trees added
+	 * without weights count 1. Permitting and irrelevant trees are counted
+	 * as by GetCount.
+	 */
+	double GetWeightedCount (int node, int verdict) const
+	{
+		if ((verdict == svSupport) || (verdict == svConflict))
+			return WTally[verdict][node];
+		return GetCount (node, verdict);
+	};
+	/**
+	 * @return the number of input trees with the given verdict on the
+	 * complement of the clade below node. Requires SetBothSides (true).
+	 */
+	int GetComplementCount (int node, int verdict) const
+	{
+		if (verdict == svIrrelevant)
+			return NumTrees - CTally[svSupport][node] - CTally[svConflict][node] - CTally[svPermit][node];
+		return CTally[verdict][node];
+	};
+
+protected:
+	const TreeIndex *ST;
+	bool BothSides;
+	bool BitSliced;
+	bool Retention;
+	bool Specialised;
+	SupportObserver *Observer;
+	WitnessObserver *Witnesses;
+	const std::vector<bool> *Mask;
+	int NumTrees;
+	/**
+	 * Differences (before Finish) or counts (after) for each verdict and
+	 * supertree node, indexed [verdict][node]
+	 */
+	std::vector<int> Tally[4];
+	std::vector<int> CTally[4];
+	/**
+	 * Weighted differences or counts of support and conflict, indexed
+	 * [verdict][node]
+	 */
+	std::vector<double> WTally[3];
+	/**
+	 * Number of clusters, and of clusters not displayed, of each input tree
+	 */
+	std::vector<int> InputClusters;
+	std::vector<int> Undisplayed;
+	std::vector<int> InputConflicts;
+	BitSlicedClassifier Sliced;
+
+	// Input tree being classified. Leaves are given positions in preorder,
+	// so each input cluster is an interval [ClusterLo, ClusterHi].
+	int NumPos;
+	int Missing;
+	std::vector<int> PosOfTaxon;
+	std::vector<int> LeafOfPos;
+	std::vector<int> ClusterLo;
+	std::vector<int> ClusterHi;
+	std::vector<int> ClusterHead;
+	std::vector<int> ClusterNext;
+	std::vector<double> ClusterWeight;
+	const std::vector<double> *Weights;
+	std::vector<bool> ClusterFound;
+	std::vector<bool> ClusterConflict;
+
+	// Scratch space
+	std::vector<int> Kept;
+	std::vector<int> Leaves;
+	std::vector<int> LeafSeq;
+	std::vector<int> Lo;
+	std::vector<int> Hi;
+	std::vector<int> Count;
+	std::vector<int> First;
+	std::vector<int> Last;
+	std::vector<int> Prefix;
+	std::vector<int> Verdict;
+	std::vector<int> CVerdict;
+	std::vector<int> NodeVerdict;
+	std::vector<int> WitnessA;
+	std::vector<int> WitnessB;
+	std::vector<int> WitnessC;
+	int SupportedBy;			// cluster equal to the clade, found by the last Classify
+	int ConflictWith;			// cluster found to conflict by the last Classify
+	double ConflictWeight;		// largest weight of the clusters that conflict, if Weights
+	InducedSubtree Sub;
+
+	bool Deleted (int x) const { return (Mask != NULL) && (x >= 0) && (x < (int)Mask->size()) && !(*Mask)[x]; };
+	virtual void PrepareTree (const TreeIndex &t);
+	/**
+	 * @return the cluster [lo, hi] of the input tree, or -1 if it has none
+	 */
+	int FindCluster (int lo, int hi) const;
+	/**
+	 * Record that the supertree has cluster [lo, hi]
+	 */
+	void FoundCluster (int lo, int hi);
+	/**
+	 * Options a kernel is compiled for, or koGeneric for one that tests
+	 * them at run time
+	 */
+	enum
+	{
+		koBothSides = 1,
+		koRetention = 2,
+		koWeighted = 4,
+		koWitnesses = 8,
+		koGeneric = 16
+	};
+	/**
+	 * @return the options in force for the tree being classified
+	 */
+	int GetOptions () const
+	{
+		return (BothSides ? koBothSides : 0) | (Retention ? koRetention : 0)
+			| (Weights ? koWeighted : 0) | (Witnesses ? koWitnesses : 0);
+	};
+	/**
+	 * Classify each clade of the induced subtree Sub against input tree t,
+	 * adding the verdicts to the tallies.
+	 */
+	template <int OPTIONS>
+	void ClassifyNodes (const TreeIndex &t);
+	/**
+	 * Classify the restricted clade formed by positions LeafSeq[first..last]
+	 * (and its complement, if koBothSides is in options, which must equal
+	 * OPTIONS unless that is koGeneric).
+	 */
+	template <int OPTIONS>
+	void Classify (int lo, int hi, int count, int first, int last, int options, int &verdict, int &cverdict);
+	/**
+	 * ClassifyNodes for each combination of options, then the generic one
+	 */
+	typedef void (SupportEngine::*NodeKernel) (const TreeIndex &t);
+	static const NodeKernel Kernels[koGeneric + 1];
+	/**
+	 * Find a witness for the conflict between the clade formed by
+	 * LeafSeq[first..last] and cluster ConflictWith of input tree t.
+	 * Uses the prefix sums left by Classify.
+	 */
+	void FindWitness (const TreeIndex &t, int first, int last, int &a, int &b, int &c) const;
+	virtual void ReportVerdicts (int id);
+	virtual void ReportWitnesses (int id);
+};
+
+/**
+ * @class SupportSummary
+ * Summary statistics over a set of supertree clades, as written to the
+ * output file: the number of unsupported clades of each kind (u1 to u5)
+ * and the mean and range of V, V+ and V-.
+ *
+ * Clades, the u counts and the sums of V are additive, so summaries of
+ * disjoint sets of clades can be combined with Add and Subtract. The
+ * minima and maxima are only maintained by AddClade.
+ */
+class SupportSummary
+{
+public:
+	int Clades;
+	int u1, u2, u3, u4, u5;
+	double SumV, SumVPlus, SumVMinus;
+	double MinV, MaxV, MinVPlus, MaxVPlus, MinVMinus, MaxVMinus;
+
+	SupportSummary () { Clear (); };
+	virtual ~SupportSummary () {};
+
+	virtual void Clear ();
+	/**
+	 * Add a clade with s supporting, q conflicting, p permitting and r
+	 * irrelevant trees, out of t input trees. S and Q may be weighted
+	 * counts.
+	 */
+	virtual void AddClade (double s, double q, int p, int r, int t);
+	virtual void Add (const SupportSummary &other);
+	virtual void Subtract (const SupportSummary &other);
+
+	double MeanV () const { return SumV / Clades; };
+	double MeanVPlus () const { return SumVPlus / Clades; };
+	double MeanVMinus () const { return SumVMinus / Clades; };
+
+	/**
+	 * Write u1 to u5 and the V, V+ and V- means and ranges, tab-delimited.
+	 */
+	virtual void Write (std::ostream &f) const;
+
+	/**
+	 * Compute V, V+ and V- for one clade. S and Q may be weighted counts.
+	 */
+	static void Indices (double s, double q, int p, double &v, double &vplus, double &vminus);
+};
+
+#endif
@@ -0,0 +1,351 @@
+#include "transfer.h"
+
+#include <algorithm>
+#include <climits>
+
+// Number of input trees whose results are held in memory at once
+#define TRANSFER_BATCH 256
+
+const double TransferSupport::IndexScale = 1099511627776.0;	// 2^40
+
+/**
+ * @class TransferTree
+ * An induced subtree with its children stored contiguously, the number of
+ * leaves below each node, and each node's child with the most leaves.
+ */
+class TransferTree
+{
+public:
+	int NumNodes;
+	std::vector<int> Parent;
+	std::vector<int> Leaf;
+	std::vector<int> Size;
+	std::vector<int> Heavy;
+	std::vector<int> ChildStart;
+	std::vector<int> Children;
+
+	TransferTree (const TreeIndex &host, const InducedSubtree &s, const std::vector<int> &taxa)
+	{
+		NumNodes = s.GetNumNodes ();
+		Parent = s.Parent;
+		Leaf.assign (NumNodes, -1);
+		Size.assign (NumNodes, 0);
+		Heavy.assign (NumNodes, -1);
+		ChildStart.assign (NumNodes + 1, 0);
+		for (int r = 0; r < NumNodes; r++)
+		{
+			int h = s.Host[r];
+			if (host.IsLeaf (h))
+			{
+				Leaf[r] = (int)(std::lower_bound (taxa.begin(), taxa.end(), host.GetTaxon (h)) - taxa.begin());
+				Size[r] = 1;
+			}
+			int p = Parent[r];
+			if (p != -1)
+			{
+				ChildStart[p + 1]++;
+				Size[p] += Size[r];
+				if ((Heavy[p] == -1) || (Size[r] > Size[Heavy[p]]))
+					Heavy[p] = r;
+			}
+		}
+		for (int r = 0; r < NumNodes; r++)
+			ChildStart[r + 1] += ChildStart[r];
+		Children.resize (ChildStart[NumNodes]);
+		std::vector<int> next (ChildStart.begin(), ChildStart.end() - 1);
+		for (int r = 0; r < NumNodes; r++)
+			if (Parent[r] != -1)
+				Children[next[Parent[r]]++] = r;
+	}
+	int GetRoot () const { return NumNodes - 1; };
+	int GetDegree (int r) const { return ChildStart[r + 1] - ChildStart[r]; };
+	int GetChild (int r, int i) const { return Children[ChildStart[r] + i]; };
+};
+
+/**
+ * @class PathMinimum
+ * A value for each node of a TransferTree, with additions to every value on
+ * the path from a node to the root, and the minimum of them all. Nodes are
+ * numbered so that each heavy path (a node, its heaviest child, that
+ * child's heaviest child, and so on) is an interval, and the values are
+ * kept in a segment tree over those numbers, so a path is O(log n)
+ * intervals of O(log n) segments.
+ */
+class PathMinimum
+{
+public:
+	PathMinimum (const TransferTree &t, const std::vector<int> &value) : T (t)
+	{
+		Head.assign (T.NumNodes, -1);
+		Pos.assign (T.NumNodes, -1);
+		std::vector<int> stk (1, T.GetRoot());
+		int next = 0;
+		while (!stk.empty())
+		{
+			int h = stk.back ();
+			stk.pop_back ();
+			for (int u = h; u != -1; u = T.Heavy[u])
+			{
+				Head[u] = h;
+				Pos[u] = next++;
+				for (int i = 0; i < T.GetDegree (u); i++)
+					if (T.GetChild (u, i) != T.Heavy[u])
+						stk.push_back (T.GetChild (u, i));
+			}
+		}
+
+		Width = 1;
+		while (Width < T.NumNodes)
+			Width *= 2;
+		Min.assign (2 * Width, INT_MAX / 2);
+		Add.assign (2 * Width, 0);
+		for (int u = 0; u < T.NumNodes; u++)
+			Min[Width + Pos[u]] = value[u];
+		for (int k = Width - 1; k >= 1; k--)
+			Min[k] = std::min (Min[2 * k], Min[2 * k + 1]);
+	}
+
+	/**
+	 * Add d to the values of node u and all its ancestors.
+	 */
+	void AddPath (int u, int d)
+	{
+		while (u != -1)
+		{
+			int h = Head[u];
+			AddRange (1, 0, Width - 1, Pos[h], Pos[u], d);
+			u = T.Parent[h];
+		}
+	}
+	int GetMin () const { return Min[1]; };
+
+protected:
+	const TransferTree &T;
+	std::vector<int> Head;
+	std::vector<int> Pos;
+	int Width;
+	// Minimum below each segment, and the addition to all of it
+	std::vector<int> Min;
+	std::vector<int> Add;
+
+	void AddRange (int k, int lo, int hi, int from, int to, int d)
+	{
+		if ((to < lo) || (from > hi))
+			return;
+		if ((from <= lo) && (hi <= to))
+		{
+			Min[k] += d;
+			Add[k] += d;
+			return;
+		}
+		int mid = (lo + hi) / 2;
+		AddRange (2 * k, lo, mid, from, to, d);
+		AddRange (2 * k + 1, mid + 1, hi, from, to, d);
+		Min[k] = std::min (Min[2 * k], Min[2 * k + 1]) + Add[k];
+	}
+};
+
+//------------------------------------------------------------------------------
+void TransferSupport::ComputeTree (const TreeIndex &t, std::vector<int> &record) const
+{
+	record.clear ();
+
+	// Taxa in both trees
+	std::vector<int> taxa;
+	for (int k = 0; k < t.GetNumLeaves(); k++)
+	{
+		int x = t.GetTaxon (t.GetLeafAtRank (k));
+		if ((x >= 0) && (x < ST->GetNumTaxa()) && (ST->GetLeafOfTaxon (x) != -1))
+			taxa.push_back (x);
+	}
+	std::sort (taxa.begin(), taxa.end());
+	taxa.erase (std::unique (taxa.begin(), taxa.end()), taxa.end());
+	int n = (int)taxa.size();
+	if (n < 3)
+		return;
+
+	std::vector<int> leaves1, leaves2;
+	for (int k = 0; k < n; k++)
+	{
+		leaves1.push_back (t.GetLeafOfTaxon (taxa[k]));
+		leaves2.push_back (ST->GetLeafOfTaxon (taxa[k]));
+	}
+	InducedSubtree s1, s2;
+	t.Induce (leaves1, s1);
+	ST->Induce (leaves2, s2);
+	TransferTree A (t, s1, taxa);
+	TransferTree B (*ST, s2, taxa);
+
+	// With R empty, |R - X| + |X - R| = |X|, and adding a taxon takes two
+	// from the values of the clusters holding it once the rise of one for
+	// every cluster is counted in |R|
+	PathMinimum m (A, A.Size);
+	std::vector<int> leafNode (n, -1);
+	for (int a = 0; a < A.NumNodes; a++)
+		if (A.Leaf[a] != -1)
+			leafNode[A.Leaf[a]] = a;
+
+	// Number the leaves of the supertree's induced subtree in preorder,
+	// visiting the heaviest child first, so the leaves below each node are
+	// an interval starting with those of its heaviest child
+	std::vector<int> first (B.NumNodes, 0);
+	std::vector<int> order;
+	std::vector<int> stk (1, B.GetRoot());
+	while (!stk.empty())
+	{
+		int v = stk.back ();
+		stk.pop_back ();
+		first[v] = (int)order.size();
+		if (B.Leaf[v] != -1)
+			order.push_back (leafNode[B.Leaf[v]]);
+		for (int i = 0; i < B.GetDegree (v); i++)
+			if (B.GetChild (v, i) != B.Heavy[v])
+				stk.push_back (B.GetChild (v, i));
+		if (B.Heavy[v] != -1)
+			stk.push_back (B.Heavy[v]);
+	}
+
+	// Visit each node after its children, the lighter ones first. The taxa
+	// of a lighter child are removed once it is done, those of the heaviest
+	// kept, and the node then adds the taxa of its lighter children.
+	std::vector<int> node (1, B.GetRoot());
+	std::vector<bool> keep (1, true);
+	std::vector<bool> expanded (1, false);
+	while (!node.empty())
+	{
+		int v = node.back ();
+		if (!expanded.back())
+		{
+			expanded.back() = true;
+			if (B.Heavy[v] != -1)
+			{
+				node.push_back (B.Heavy[v]);
+				keep.push_back (true);
+				expanded.push_back (false);
+			}
+			for (int i = 0; i < B.GetDegree (v); i++)
+			{
+				if (B.GetChild (v, i) != B.Heavy[v])
+				{
+					node.push_back (B.GetChild (v, i));
+					keep.push_back (false);
+					expanded.push_back (false);
+				}
+			}
+			continue;
+		}
+		bool kept = keep.back ();
+		node.pop_back ();
+		keep.pop_back ();
+		expanded.pop_back ();
+
+		int lo = first[v] + ((B.Heavy[v] != -1) ? B.Size[B.Heavy[v]] : 0);
+		int hi = first[v] + B.Size[v];
+		for (int k = lo; k < hi; k++)
+			m.AddPath (order[k], -2);
+		int r = B.Size[v];
+		if ((r >= 2) && (r < n))
+		{
+			record.push_back (s2.Host[v]);
+			record.push_back (s2.Host[B.Parent[v]]);
+			record.push_back (r + m.GetMin());
+			record.push_back (std::min (r - 1, n - r));
+		}
+		if (!kept)
+			for (int k = first[v]; k < hi; k++)
+				m.AddPath (order[k], 2);
+	}
+}
+
+//------------------------------------------------------------------------------
+void TransferSupport::Compute (const std::vector<TreeIndex> &trees)
+{
+	int nn = ST->GetNumNodes ();
+	Trees.assign (nn, 0);
+	SumDistance.assign (nn, 0.0);
+	SumIndex.assign (nn, 0);
+
+	// Each record adds to the clades from its node up to, but not
+	// including, its ancestor, so add at the node and take away at the
+	// ancestor, and sum over subtrees at the end
+	std::vector< std::vector<int> > records (TRANSFER_BATCH);
+	int ntrees = (int)trees.size();
+	for (int first = 0; first < ntrees; first += TRANSFER_BATCH)
+	{
+		int batch = std::min (TRANSFER_BATCH, ntrees - first);
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic)
+#endif
+		for (int b = 0; b < batch; b++)
+			ComputeTree (trees[first + b], records[b]);
+
+		// Combine in tree order so that the sums are reproducible
+		for (int b = 0; b < batch; b++)
+		{
+			const std::vector<int> &rec = records[b];
+			for (int i = 0; i < (int)rec.size(); i += 4)
+			{
+				double d = rec[i + 2];
+				long long index = (long long)((1.0 - d / rec[i + 3]) * IndexScale + 0.5);
+				Trees[rec[i]]++;
+				Trees[rec[i + 1]]--;
+				SumDistance[rec[i]] += d;
+				SumDistance[rec[i + 1]] -= d;
+				SumIndex[rec[i]] += index;
+				SumIndex[rec[i + 1]] -= index;
+			}
+		}
+	}
+
+	// Nodes are numbered with each before its parent
+	for (int u = 0; u < nn; u++)
+	{
+		int p = ST->GetParent (u);
+		if (p != -1)
+		{
+			Trees[p] += Trees[u];
+			SumDistance[p] += SumDistance[u];
+			SumIndex[p] += SumIndex[u];
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+double TransferSupport::GetMeanIndex () const
+{
+	double sum = 0.0;
+	int n = 0;
+	for (int u = ST->GetNumLeaves(); u < ST->GetNumNodes(); u++)
+	{
+		if ((u != ST->GetRoot()) && (Trees[u] > 0))
+		{
+			sum += GetIndex (u);
+			n++;
+		}
+	}
+	return n ? sum / n : 0.0;
+}
+
+//------------------------------------------------------------------------------
+void TransferSupport::Report (std::ostream &f, const std::vector<std::string> &labels) const
+{
+	for (int u = ST->GetNumLeaves(); u < ST->GetNumNodes(); u++)
+	{
+		if (u == ST->GetRoot())
+			continue;
+		f << "(";
+		for (int k = ST->GetLeafLo (u); k <= ST->GetLeafHi (u); k++)
+		{
+			if (k != ST->GetLeafLo (u))
+				f << ",";
+			f << labels[ST->GetTaxon (ST->GetLeafAtRank (k))];
+		}
+		f << ")\t" << Trees[u];
+		if (Trees[u] > 0)
+			f << "\t" << GetMeanDistance (u) << "\t" << GetIndex (u);
+		else
+			f << "\t-\t-";
+		f << std::endl;
+	}
+	f << "Mean\t" << GetMeanIndex () << std::endl;
+}
@@ -0,0 +1,116 @@
+/**
+ * @file transfer.h
+ *
+ * Transfer support index of each supertree clade.
+ *
+ */
+
+#ifndef TRANSFERH
+#define TRANSFERH
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "treeindex.h"
+
+/**
+ * @class TransferSupport
+ * For each supertree clade C and input tree with leaf set L (the taxa it
+ * shares with the supertree), the transfer distance is the smallest number
+ * of taxa that must be moved into or out of R = C restricted to L for it
+ * to become a cluster of the input tree, i.e. the smallest |R - X| + |X - R|
+ * over the clusters X of the input tree restricted to L (including L and
+ * its single taxa). It is counted for the trees to which C is relevant
+ * (R has at least two taxa and is not L). As a single taxon and L are
+ * always clusters, the distance is at most p = min(|R| - 1, |L| - |R|), and
+ * the transfer index is 1 - distance / p, as in the booster measure of
+ * Lemoine et al. (2018, Nature 556:452-456): 1 if R is a cluster of the
+ * input tree, 0 if it is no closer to one than a star tree would be.
+ * Unlike S and Q, the index of a large clade falls only a little when a
+ * single taxon is misplaced.
+ *
+ * The distances are found for all clades at once, for each input tree,
+ * using the subtrees of both trees induced by the shared taxa. Adding a
+ * taxon to R lowers |R - X| + |X - R| by one for the clusters X holding it
+ * and raises it by one for the rest, so with the input tree's nodes in a
+ * heavy path order, a segment tree gives the minimum over all X after
+ * O(log n) range additions along the taxon's path to the root. The clades
+ * of the supertree are visited keeping the taxa of each node's largest
+ * child and adding those of the others, so each taxon is added O(log n)
+ * times, and a tree with n shared taxa costs O(n log^3 n) at worst (less
+ * for balanced trees) rather than the O(n^2) of comparing every pair of
+ * clusters. Supertree clades with the same taxa of L, which lie on a path
+ * in the supertree, are recorded once.
+ *
+ * Input trees must have had BuildLCA called. If compiled with OpenMP the
+ * input trees are shared between threads, and the results are combined in
+ * tree order so they do not depend on the number of threads.
+ */
+class TransferSupport
+{
+public:
+	/**
+	 * @param supertree the indexed supertree. BuildLCA must have been called.
+	 */
+	TransferSupport (const TreeIndex *supertree) { ST = supertree; };
+	virtual ~TransferSupport () {};
+
+	/**
+	 * Compute the transfer distances of the supertree clades to each input
+	 * tree.
+	 * @param trees the indexed input trees
+	 */
+	virtual void Compute (const std::vector<TreeIndex> &trees);
+
+	/**
+	 * @return the number of input trees to which the clade below node is
+	 * relevant
+	 */
+	int GetNumTrees (int node) const { return Trees[node]; };
+	/**
+	 * @return the mean transfer distance of the clade below node
+	 */
+	double GetMeanDistance (int node) const { return Trees[node] ? SumDistance[node] / Trees[node] : 0.0; };
+	/**
+	 * @return the transfer support index of the clade below node, the mean
+	 * transfer index over the trees to which it is relevant
+	 */
+	double GetIndex (int node) const { return Trees[node] ? (double)SumIndex[node] / IndexScale / Trees[node] : 0.0; };
+	/**
+	 * @return the mean transfer support index of the clades that are
+	 * relevant to at least one input tree
+	 */
+	virtual double GetMeanIndex () const;
+
+	/**
+	 * Write one line per supertree clade: the clade, the number of input
+	 * trees to which it is relevant, its mean transfer distance and its
+	 * transfer support index, followed by the mean index.
+	 * @param f output stream
+	 * @param labels taxon labels, indexed by taxon
+	 */
+	virtual void Report (std::ostream &f, const std::vector<std::string> &labels) const;
+
+protected:
+	const TreeIndex *ST;
+	std::vector<int> Trees;
+	std::vector<double> SumDistance;
+	/**
+	 * Sums of the transfer indices in units of 1 / IndexScale, so that the
+	 * additions and subtractions made for each tree cancel exactly
+	 */
+	std::vector<long long> SumIndex;
+	static const double IndexScale;
+
+	/**
+	 * Find the transfer distances for input tree t. For each distinct
+	 * relevant clade, records its supertree node and the node of the
+	 * nearest ancestor with other taxa of t (the clades in between have
+	 * the same ones), its transfer distance, and its largest possible
+	 * distance p.
+	 */
+	virtual void ComputeTree (const TreeIndex &t, std::vector<int> &record) const;
+};
+
+#endif
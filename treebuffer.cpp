@@ -0,0 +1,348 @@
+#include "treebuffer.h"
+#include "treeindex.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stack>
+
+//------------------------------------------------------------------------------
+BufferedTreeWriter::BufferedTreeWriter (std::ostream *s, int bufferSize)
+{
+	f = s;
+	Buffer.resize (bufferSize > 0 ? bufferSize : 1);
+	Used = 0;
+	Translate = false;
+	SetPrecision (6);
+}
+
+//------------------------------------------------------------------------------
+BufferedTreeWriter::~BufferedTreeWriter ()
+{
+	Flush ();
+}
+
+//------------------------------------------------------------------------------
+void BufferedTreeWriter::Flush ()
+{
+	if (Used > 0)
+		f->write (&Buffer[0], Used);
+	Used = 0;
+}
+
+//------------------------------------------------------------------------------
+void BufferedTreeWriter::Put (const char *s, int n)
+{
+	while (n > 0)
+	{
+		int m = (int)Buffer.size() - Used;
+		if (m > n)
+			m = n;
+		memcpy (&Buffer[Used], s, m);
+		Used += m;
+		s += m;
+		n -= m;
+		if (Used == (int)Buffer.size())
+			Flush ();
+	}
+}
+
+//------------------------------------------------------------------------------
+void BufferedTreeWriter::Write (const char *s)
+{
+	Put (s, (int)strlen (s));
+}
+
+//------------------------------------------------------------------------------
+void BufferedTreeWriter::WriteInteger (long long n)
+{
+	char digits[24];
+	int k = 0;
+	unsigned long long u = (n < 0) ? (unsigned long long)(-(n + 1)) + 1 : (unsigned long long)n;
+	do
+	{
+		digits[k++] = (char)('0' + u % 10);
+		u /= 10;
+	} while (u);
+	if (n < 0)
+		Write ('-');
+	while (k > 0)
+		Write (digits[--k]);
+}
+
+//------------------------------------------------------------------------------
+void BufferedTreeWriter::SetPrecision (int places)
+{
+	if (places < 0)
+		places = 0;
+	if (places > 15)
+		places = 15;
+	Places = places;
+	Scale = 1.0;
+	for (int i = 0; i < Places; i++)
+		Scale *= 10.0;
+}
+
+//------------------------------------------------------------------------------
+void BufferedTreeWriter::WriteReal (double x)
+{
+	// Very large values, infinities and NaNs are left to the C library
+	if (!(fabs (x) < 1e15))
+	{
+		char s[32];
+		sprintf (s, "%g", x);
+		Write (s);
+		return;
+	}
+	bool negative = (x < 0.0);
+	if (negative)
+		x = -x;
+	long long whole = (long long)x;
+	long long frac = (long long)((x - (double)whole) * Scale + 0.5);
+	if ((double)frac >= Scale)
+	{
+		whole++;
+		frac -= (long long)Scale;
+	}
+	if (negative && ((whole > 0) || (frac > 0)))
+		Write ('-');
+	WriteInteger (whole);
+	if (frac == 0)
+		return;
+
+	char digits[16];
+	for (int i = Places - 1; i >= 0; i--)
+	{
+		digits[i] = (char)('0' + frac % 10);
+		frac /= 10;
+	}
+	int n = Places;
+	while (digits[n - 1] == '0')
+		n--;
+	Write ('.');
+	Put (digits, n);
+}
+
+//------------------------------------------------------------------------------
+void BufferedTreeWriter::SetLabels (const std::vector<std::string> &labels)
+{
+	Labels.clear ();
+	TaxonOfLabel.clear ();
+	for (int x = 0; x < (int)labels.size(); x++)
+	{
+		Labels.push_back (NEXUSString (labels[x]));
+		TaxonOfLabel[labels[x]] = x;
+	}
+}
+
+//------------------------------------------------------------------------------
+void BufferedTreeWriter::WriteTranslate (const char *endOfLine)
+{
+	if (Labels.empty())
+		return;
+	Write ("\ttranslate");
+	Write (endOfLine);
+	for (int x = 0; x < (int)Labels.size(); x++)
+	{
+		Write ("\t\t");
+		WriteInteger (x + 1);
+		Write (' ');
+		Write (Labels[x]);
+		Write ((x == (int)Labels.size() - 1) ? ';' : ',');
+		Write (endOfLine);
+	}
+	Translate = true;
+}
+
+//------------------------------------------------------------------------------
+void BufferedTreeWriter::PutLeaf (int taxon)
+{
+	if (!Translate && (taxon >= 0) && (taxon < (int)Labels.size()))
+		Write (Labels[taxon]);
+	else
+		WriteInteger (taxon + 1);
+}
+
+//------------------------------------------------------------------------------
+void BufferedTreeWriter::PutLeaf (const std::string &label)
+{
+	std::map<std::string, int>::const_iterator there = TaxonOfLabel.find (label);
+	if (there != TaxonOfLabel.end())
+		PutLeaf (there->second);
+	else
+		Write (NEXUSString (label));
+}
+
+//------------------------------------------------------------------------------
+void BufferedTreeWriter::WriteTree (const TreeIndex &t, const std::vector<double> *lengths)
+{
+	int root = t.GetRoot ();
+	for (int k = 0; k < t.GetNumNodes(); k++)
+	{
+		int u = t.GetNodeAtPreorder (k);
+		if (!t.IsLeaf (u))
+		{
+			Write ('(');
+			continue;
+		}
+		PutLeaf (t.GetTaxon (u));
+		if (lengths && (u != root))
+		{
+			Write (':');
+			WriteReal ((*lengths)[u]);
+		}
+		// Close the ancestors whose last child this leaf ends
+		while ((u != root) && (t.GetSibling (u) == -1))
+		{
+			u = t.GetParent (u);
+			Write (')');
+			if (lengths && (u != root))
+			{
+				Write (':');
+				WriteReal ((*lengths)[u]);
+			}
+		}
+		if (u != root)
+			Write (',');
+	}
+	Write (';');
+}
+
+//------------------------------------------------------------------------------
+void BufferedTreeWriter::WriteTree (Tree &t)
+{
+	bool edgeLengths = t.GetHasEdgeLengths ();
+	NodePtr root = t.GetRoot ();
+	NodePtr cur = root;
+	std::stack<NodePtr, std::vector<NodePtr> > stk;
+	while (cur)
+	{
+		if (cur->GetChild())
+		{
+			Write ('(');
+			stk.push (cur);
+			cur = cur->GetChild();
+			continue;
+		}
+		PutLeaf (cur->GetLabel());
+		if (edgeLengths && (cur != root))
+		{
+			Write (':');
+			WriteReal (cur->GetEdgeLength());
+		}
+		while (!stk.empty() && (cur->GetSibling() == NULL))
+		{
+			cur = stk.top();
+			stk.pop();
+			Write (')');
+			if (cur->GetLabel() != "")
+				Write (NEXUSString (cur->GetLabel()));
+			if (edgeLengths && (cur != root))
+			{
+				Write (':');
+				WriteReal (cur->GetEdgeLength());
+			}
+		}
+		if (stk.empty())
+			cur = NULL;
+		else
+		{
+			Write (',');
+			cur = cur->GetSibling();
+		}
+	}
+	Write (';');
+}
+
+//------------------------------------------------------------------------------
+NodePtr BufferedTreeWriter::Descend (NodePtr p, const std::vector<int> &kept, double &length) const
+{
+	while (p->GetChild())
+	{
+		NodePtr only = NULL;
+		int n = 0;
+		for (NodePtr q = p->GetChild(); q; q = q->GetSibling())
+		{
+			if (kept[q->GetIndex()] > 0)
+			{
+				only = q;
+				n++;
+			}
+		}
+		if (n != 1)
+			break;
+		length += only->GetEdgeLength();
+		p = only;
+	}
+	return p;
+}
+
+//------------------------------------------------------------------------------
+void BufferedTreeWriter::WriteTree (Tree &t, const std::vector<int> &kept)
+{
+	bool edgeLengths = t.GetHasEdgeLengths ();
+	double length = 0.0;
+	NodePtr root = Descend (t.GetRoot(), kept, length);
+	if (!root->GetChild())
+	{
+		PutLeaf (root->GetLabel());
+		Write (';');
+		return;
+	}
+
+	// Nodes written but not yet closed, the next of each one's children to
+	// consider, and the length of the edge above each
+	std::vector<NodePtr> stk (1, root);
+	std::vector<NodePtr> next (1, root->GetChild());
+	std::vector<double> above (1, 0.0);
+	bool comma = false;
+	Write ('(');
+	while (!stk.empty())
+	{
+		NodePtr c = next.back();
+		while (c && (kept[c->GetIndex()] == 0))
+			c = c->GetSibling();
+		if (c == NULL)
+		{
+			NodePtr u = stk.back();
+			double l = above.back();
+			stk.pop_back ();
+			next.pop_back ();
+			above.pop_back ();
+			Write (')');
+			if (u->GetLabel() != "")
+				Write (NEXUSString (u->GetLabel()));
+			if (edgeLengths && !stk.empty())
+			{
+				Write (':');
+				WriteReal (l);
+			}
+			comma = true;
+			continue;
+		}
+		next.back() = c->GetSibling();
+		if (comma)
+			Write (',');
+		length = c->GetEdgeLength();
+		NodePtr d = Descend (c, kept, length);
+		if (d->GetChild())
+		{
+			Write ('(');
+			stk.push_back (d);
+			next.push_back (d->GetChild());
+			above.push_back (length);
+			comma = false;
+		}
+		else
+		{
+			PutLeaf (d->GetLabel());
+			if (edgeLengths)
+			{
+				Write (':');
+				WriteReal (length);
+			}
+			comma = true;
+		}
+	}
+	Write (';');
+}
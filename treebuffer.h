@@ -0,0 +1,138 @@
+/**
+ * @file treebuffer.h
+ *
+ * Fast writing of many trees in Newick and NEXUS format.
+ *
+ */
+
+#ifndef TREEBUFFERH
+#define TREEBUFFERH
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "TreeLib.h"
+
+class TreeIndex;
+
+#define TREE_BUFFER_SIZE 1048576
+
+/**
+ * @class BufferedTreeWriter
+ * Writes tree descriptions into a large buffer that is passed to the output
+ * stream only when full, rather than sending each token through the stream
+ * as NewickTreeWriter and Tree::Write do. Leaf labels are quoted once, when
+ * the labels are set, and edge lengths are formatted directly into the
+ * buffer.
+ *
+ * After WriteTranslate leaves are written as the integer codes of a NEXUS
+ * TRANSLATE command (1 + the index of the label), which makes files of many
+ * trees on the same taxa much smaller. Trees can be written either from a
+ * TreeIndex, whose leaves are already numbered by taxon, or from a Tree,
+ * whose leaves are looked up by label.
+ */
+class BufferedTreeWriter
+{
+public:
+	/**
+	 * @param s the stream to which the buffer is written
+	 * @param bufferSize size of the buffer in bytes
+	 */
+	BufferedTreeWriter (std::ostream *s, int bufferSize = TREE_BUFFER_SIZE);
+	/**
+	 * Flushes the buffer.
+	 */
+	virtual ~BufferedTreeWriter ();
+
+	/**
+	 * Set the leaf labels, indexed by taxon.
+	 */
+	virtual void SetLabels (const std::vector<std::string> &labels);
+	/**
+	 * Set the number of decimal places written for edge lengths (default 6).
+	 * Trailing zeros are dropped.
+	 */
+	virtual void SetPrecision (int places);
+	/**
+	 * Write a NEXUS TRANSLATE command for the labels, and write leaves as
+	 * their codes from now on.
+	 * @param endOfLine the end of line sequence
+	 */
+	virtual void WriteTranslate (const char *endOfLine = "\n");
+	/**
+	 * Write the description of a tree, ending in ";". Leaves whose taxon has
+	 * no label are written as (taxon + 1).
+	 * @param t the tree
+	 * @param lengths if not NULL, the length of the edge above each node,
+	 * indexed as t; the root's is not written
+	 */
+	virtual void WriteTree (const TreeIndex &t, const std::vector<double> *lengths = NULL);
+	/**
+	 * Write the description of a tree, ending in ";", with the edge lengths
+	 * if the tree has them and the labels of any labelled internal nodes.
+	 * Leaves whose label was not set are written in full even after
+	 * WriteTranslate.
+	 */
+	virtual void WriteTree (Tree &t);
+	/**
+	 * Write the description of a tree restricted to some of its leaves, as
+	 * WriteTree (t), without the subtrees that have none of those leaves.
+	 * Nodes left with one child are suppressed, adding the length of their
+	 * edge to the child's, and dropping their label.
+	 * @param t the tree, whose node list must have been made
+	 * @param kept the number of leaves kept below each node, indexed by
+	 * Node::GetIndex
+	 */
+	virtual void WriteTree (Tree &t, const std::vector<int> &kept);
+	/**
+	 * Append text to the buffer.
+	 */
+	void Write (const std::string &s) { Put (s.c_str(), (int)s.length()); };
+	void Write (const char *s);
+	void Write (char c)
+	{
+		if (Used == (int)Buffer.size())
+			Flush ();
+		Buffer[Used++] = c;
+	};
+	/**
+	 * Append a number to the buffer.
+	 */
+	virtual void WriteInteger (long long n);
+	virtual void WriteReal (double x);
+	/**
+	 * Pass the buffer to the stream.
+	 */
+	virtual void Flush ();
+
+protected:
+	std::ostream *f;
+	std::vector<char> Buffer;
+	int Used;
+	int Places;
+	double Scale;
+	bool Translate;
+	/**
+	 * Label of each taxon, quoted if need be
+	 */
+	std::vector<std::string> Labels;
+	/**
+	 * Taxon of each label
+	 */
+	std::map<std::string, int> TaxonOfLabel;
+
+	void Put (const char *s, int n);
+	void PutLeaf (int taxon);
+	void PutLeaf (const std::string &label);
+	/**
+	 * Follow the path down from p while only one child has kept leaves,
+	 * adding the lengths of the edges passed to length.
+	 * @return the node reached, a leaf or a node with two or more such
+	 * children
+	 */
+	NodePtr Descend (NodePtr p, const std::vector<int> &kept, double &length) const;
+};
+
+#endif
@@ -0,0 +1,625 @@
+#include "treefileindex.h"
+
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+#define SCAN_BUFFER_SIZE 1048576
+#define FINGERPRINT_BLOCK 65536
+#define FNV_BASIS 0xCBF29CE484222325ULL
+
+/**
+ * @class ScanBuffer
+ * Reads a stream in large blocks, one character at a time.
+ */
+class ScanBuffer
+{
+public:
+	ScanBuffer (std::istream &f) : in (f), buf (SCAN_BUFFER_SIZE) { len = pos = 0; offset = 0; };
+	/**
+	 * @return the next character, or EOF
+	 */
+	int Get ()
+	{
+		if ((pos == len) && !Fill ())
+			return EOF;
+		return (unsigned char)buf[pos++];
+	};
+	int Peek ()
+	{
+		if ((pos == len) && !Fill ())
+			return EOF;
+		return (unsigned char)buf[pos];
+	};
+	/**
+	 * @return the offset in the file of the character last returned by Get
+	 */
+	long long Position () const { return offset + pos - 1; };
+protected:
+	std::istream &in;
+	std::vector<char> buf;
+	int len;
+	int pos;
+	long long offset;
+
+	bool Fill ()
+	{
+		offset += len;
+		in.read (&buf[0], SCAN_BUFFER_SIZE);
+		len = (int)in.gcount();
+		pos = 0;
+		return len > 0;
+	};
+};
+
+//------------------------------------------------------------------------------
+// One step of a 64-bit FNV-1a hash
+static unsigned long long HashByte (unsigned long long h, int c)
+{
+	return (h ^ (unsigned long long)(unsigned char)c) * 0x100000001B3ULL;
+}
+
+//------------------------------------------------------------------------------
+static std::string Lower (const std::string &s)
+{
+	std::string t (s);
+	for (int i = 0; i < (int)t.size(); i++)
+		t[i] = (char)tolower (t[i]);
+	return t;
+}
+
+//------------------------------------------------------------------------------
+void TreeFileIndex::Clear ()
+{
+	Format = tfUnknown;
+	Size = -1;
+	ModTime = -1;
+	Fingerprint = 0;
+	FileName.clear ();
+	Built = false;
+	Start.clear ();
+	End.clear ();
+	Names.clear ();
+	Rooted.clear ();
+	Table.clear ();
+	Hash.clear ();
+	TableStart.clear ();
+	TableEnd.clear ();
+	Translations.clear ();
+}
+
+//------------------------------------------------------------------------------
+long long TreeFileIndex::FileSize (const char *filename)
+{
+	std::ifstream f (filename, std::ios::in | std::ios::binary);
+	if (!f)
+		return -1;
+	f.seekg (0, std::ios::end);
+	return (long long)f.tellg ();
+}
+
+//------------------------------------------------------------------------------
+unsigned long long TreeFileIndex::FileHash (const char *filename)
+{
+	std::ifstream f (filename, std::ios::in | std::ios::binary);
+	if (!f)
+		return 0;
+	unsigned long long h = 0xCBF29CE484222325ULL;
+	ScanBuffer in (f);
+	int c;
+	while ((c = in.Get ()) != EOF)
+	{
+		h ^= (unsigned long long)c;
+		h *= 0x100000001B3ULL;
+	}
+	return h;
+}
+
+//------------------------------------------------------------------------------
+long long TreeFileIndex::FileTime (const char *filename)
+{
+	struct stat st;
+	if (stat (filename, &st) != 0)
+		return -1;
+	return (long long)st.st_mtime;
+}
+
+//------------------------------------------------------------------------------
+// Hash the first block and the last block (which overlap in a small file),
+// so a change at either end is caught without reading the whole file.
+unsigned long long TreeFileIndex::FileFingerprint (const char *filename)
+{
+	std::ifstream f (filename, std::ios::in | std::ios::binary);
+	if (!f)
+		return 0;
+	f.seekg (0, std::ios::end);
+	long long size = (long long)f.tellg ();
+	long long tail = (size > FINGERPRINT_BLOCK) ? size - FINGERPRINT_BLOCK : 0;
+	std::vector<char> buf (FINGERPRINT_BLOCK);
+	unsigned long long h = FNV_BASIS;
+	for (int b = 0; b < 2; b++)
+	{
+		f.clear ();
+		f.seekg ((b == 0) ? 0 : tail);
+		f.read (&buf[0], FINGERPRINT_BLOCK);
+		for (int i = 0; i < (int)f.gcount(); i++)
+			h = HashByte (h, buf[i]);
+	}
+	return h;
+}
+
+//------------------------------------------------------------------------------
+bool TreeFileIndex::Build (const char *filename)
+{
+	Clear ();
+	std::ifstream f (filename, std::ios::in | std::ios::binary);
+	if (!f)
+		return false;
+	Size = FileSize (filename);
+	ModTime = FileTime (filename);
+	Fingerprint = FileFingerprint (filename);
+	Built = true;
+
+	// As Profile::ReadTrees, decide the format from the first character
+	char ch = (char)f.peek ();
+	if (ch == '#')
+	{
+		Format = tfNEXUS;
+		ScanNEXUS (f);
+	}
+	else if (strchr ("([", ch))
+	{
+		Format = tfPHYLIP;
+		ScanPHYLIP (f);
+	}
+	return !Start.empty();
+}
+
+//------------------------------------------------------------------------------
+void TreeFileIndex::ScanNEXUS (std::istream &f)
+{
+	ScanBuffer in (f);
+	bool inTrees = false;
+	int table = -1;
+	std::string command, word, name, comment;
+	int words = 0;			// words so far in the current command
+	bool quoted = false;	// inside a quoted word
+	bool pending = false;	// a word has been started
+	int depth = 0;			// comment nesting
+	bool equals = false;	// TREE command has reached "="
+	long long descStart = -1, tableStart = -1;
+	int rooted = -1;
+	unsigned long long hash = FNV_BASIS;	// of the description after its first character
+	int c;
+	while ((c = in.Get ()) != EOF)
+	{
+		long long pos = in.Position ();
+		hash = (descStart == -1) ? FNV_BASIS : HashByte (hash, c);
+		if (depth > 0)
+		{
+			if (c == '[')
+				depth++;
+			else if (c == ']')
+			{
+				depth--;
+				// [&R] or [&U] before the tree description
+				if ((depth == 0) && (command == "tree") && (descStart == -1) && (comment.size() == 2) && (comment[0] == '&'))
+				{
+					if (toupper (comment[1]) == 'R')
+						rooted = 1;
+					else if (toupper (comment[1]) == 'U')
+						rooted = 0;
+				}
+			}
+			else if (comment.size() < 3)
+				comment += (char)c;
+			continue;
+		}
+		if (quoted)
+		{
+			if (c == '\'')
+			{
+				if (in.Peek () == '\'')
+					word += (char)in.Get ();
+				else
+					quoted = false;
+			}
+			else
+				word += (char)c;
+			continue;
+		}
+		if (c == '[')
+		{
+			depth = 1;
+			comment.clear ();
+			continue;
+		}
+
+		bool space = (isspace (c) != 0);
+		bool punct = !space && (strchr ("(),;:=*", c) != NULL);
+		if (!space && !punct)
+		{
+			if (equals && (descStart == -1))
+				descStart = pos;
+			if (c == '\'')
+				quoted = true;
+			else
+				word += (char)c;
+			pending = true;
+			continue;
+		}
+
+		// End of a word
+		if (pending)
+		{
+			if (words == 0)
+			{
+				command = Lower (word);
+				// "#NEXUS" is not followed by a semicolon
+				if (command == "#nexus")
+				{
+					command.clear ();
+					words = -1;
+				}
+				else if ((command == "end") || (command == "endblock"))
+					inTrees = false;
+				else if (command == "translate")
+					tableStart = pos;
+				name.clear ();
+				equals = false;
+				descStart = -1;
+				rooted = -1;
+			}
+			else if ((words == 1) && (command == "begin"))
+			{
+				inTrees = (Lower (word) == "trees");
+				table = -1;
+			}
+			else if ((words == 1) && (command == "tree"))
+				name = word;
+			words++;
+			word.clear ();
+			pending = false;
+		}
+
+		if (c == ';')
+		{
+			if (inTrees && (command == "translate"))
+			{
+				TableStart.push_back (tableStart);
+				TableEnd.push_back (pos);
+				table = (int)TableStart.size() - 1;
+			}
+			else if (inTrees && (command == "tree") && (descStart != -1))
+			{
+				Start.push_back (descStart);
+				End.push_back (pos);
+				Names.push_back (name);
+				Rooted.push_back (rooted);
+				Table.push_back (table);
+				Hash.push_back (hash);
+			}
+			words = 0;
+			command.clear ();
+			equals = false;
+		}
+		else if ((c == '=') && (command == "tree") && !equals)
+			equals = true;
+		else if (punct && equals && (descStart == -1))
+			descStart = pos;
+	}
+}
+
+//------------------------------------------------------------------------------
+void TreeFileIndex::ScanPHYLIP (std::istream &f)
+{
+	ScanBuffer in (f);
+	long long start = -1;
+	int depth = 0;
+	bool quoted = false;
+	unsigned long long hash = FNV_BASIS;
+	int c;
+	while ((c = in.Get ()) != EOF)
+	{
+		long long pos = in.Position ();
+		hash = (start == -1) ? FNV_BASIS : HashByte (hash, c);
+		if (depth > 0)
+		{
+			if (c == '[')
+				depth++;
+			else if (c == ']')
+				depth--;
+			continue;
+		}
+		if (quoted)
+		{
+			if (c == '\'')
+			{
+				if (in.Peek () == '\'')
+					in.Get ();
+				else
+					quoted = false;
+			}
+			continue;
+		}
+		if (isspace (c))
+			continue;
+		if (start == -1)
+			start = pos;
+		if (c == '[')
+			depth = 1;
+		else if (c == '\'')
+			quoted = true;
+		else if (c == ';')
+		{
+			Start.push_back (start);
+			End.push_back (pos);
+			Names.push_back ("");
+			Rooted.push_back (-1);
+			Table.push_back (-1);
+			Hash.push_back (hash);
+			start = -1;
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+bool TreeFileIndex::Save (const char *filename) const
+{
+	std::ofstream f (filename);
+	if (!f)
+		return false;
+	f << "#stsupport tree file index" << std::endl;
+	f << "format\t" << ((Format == tfNEXUS) ? "NEXUS" : "PHYLIP") << std::endl;
+	f << "size\t" << Size << std::endl;
+	f << "mtime\t" << ModTime << std::endl;
+	f << "fingerprint\t" << Fingerprint << std::endl;
+	for (int t = 0; t < (int)TableStart.size(); t++)
+		f << "table\t" << TableStart[t] << "\t" << TableEnd[t] << std::endl;
+	for (int k = 0; k < GetNumTrees(); k++)
+		f << "tree\t" << Start[k] << "\t" << End[k] << "\t" << Table[k] << "\t" << Rooted[k] << "\t" << Hash[k] << "\t" << Names[k] << std::endl;
+	return f.good ();
+}
+
+//------------------------------------------------------------------------------
+bool TreeFileIndex::Load (const char *filename)
+{
+	Clear ();
+	std::ifstream f (filename);
+	if (!f)
+		return false;
+	std::string line;
+	while (std::getline (f, line))
+	{
+		std::istringstream s (line);
+		std::string key;
+		s >> key;
+		if (key == "format")
+		{
+			std::string format;
+			s >> format;
+			Format = (format == "NEXUS") ? tfNEXUS : tfPHYLIP;
+		}
+		else if (key == "size")
+			s >> Size;
+		else if (key == "mtime")
+			s >> ModTime;
+		else if (key == "fingerprint")
+			s >> Fingerprint;
+		else if (key == "table")
+		{
+			long long a, b;
+			s >> a >> b;
+			TableStart.push_back (a);
+			TableEnd.push_back (b);
+		}
+		else if (key == "tree")
+		{
+			long long a, b;
+			int table, rooted;
+			unsigned long long hash;
+			s >> a >> b >> table >> rooted >> hash;
+			std::string name;
+			s.get ();
+			std::getline (s, name);
+			Start.push_back (a);
+			End.push_back (b);
+			Table.push_back (table);
+			Rooted.push_back (rooted);
+			Hash.push_back (hash);
+			Names.push_back (name);
+		}
+	}
+	return (Format != tfUnknown) && !Start.empty();
+}
+
+//------------------------------------------------------------------------------
+bool TreeFileIndex::Matches (const char *filename) const
+{
+	return (Size >= 0) && (FileSize (filename) == Size) && (ModTime != -1)
+		&& (FileTime (filename) == ModTime) && (FileFingerprint (filename) == Fingerprint);
+}
+
+//------------------------------------------------------------------------------
+bool TreeFileIndex::Open (const char *filename)
+{
+	std::string indexname = std::string (filename) + ".idx";
+	if (!(Load (indexname.c_str()) && Matches (filename)))
+	{
+		if (!Build (filename))
+			return false;
+		Save (indexname.c_str());
+	}
+	FileName = filename;
+	return true;
+}
+
+//------------------------------------------------------------------------------
+bool TreeFileIndex::Rebuild ()
+{
+	if (Built || FileName.empty())
+		return false;
+	std::string name (FileName);
+	if (!Build (name.c_str()))
+		return false;
+	FileName = name;
+	Save ((name + ".idx").c_str());
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Pairs of tokens (key, label) separated by commas
+bool TreeFileIndex::ReadTable (std::istream &f, int t)
+{
+	std::string text (TableEnd[t] - TableStart[t] + 1, ' ');
+	f.clear ();
+	f.seekg (TableStart[t]);
+	f.read (&text[0], text.size());
+	if ((f.gcount() != (std::streamsize)text.size()) || (text[text.size() - 1] != ';'))
+		return false;
+	text.erase (text.size() - 1);
+
+	std::map<std::string, std::string> &m = Translations[t];
+
+	std::vector<std::string> tokens;
+	std::string token;
+	bool pending = false;
+	for (int i = 0; i <= (int)text.size(); i++)
+	{
+		char c = (i < (int)text.size()) ? text[i] : ',';
+		if (c == '[')
+		{
+			for (int depth = 0; i < (int)text.size(); i++)
+			{
+				if (text[i] == '[')
+					depth++;
+				else if ((text[i] == ']') && (--depth == 0))
+					break;
+			}
+			continue;
+		}
+		if (c == '\'')
+		{
+			pending = true;
+			for (i++; i < (int)text.size(); i++)
+			{
+				if (text[i] == '\'')
+				{
+					if ((i + 1 < (int)text.size()) && (text[i + 1] == '\''))
+						i++;
+					else
+						break;
+				}
+				token += text[i];
+			}
+			continue;
+		}
+		if (isspace (c) || (c == ','))
+		{
+			if (pending)
+				tokens.push_back (token);
+			token.clear ();
+			pending = false;
+			if (c == ',')
+			{
+				if (tokens.size() >= 2)
+					m[tokens[0]] = tokens[1];
+				tokens.clear ();
+			}
+			continue;
+		}
+		token += c;
+		pending = true;
+	}
+	return true;
+}
+
+//------------------------------------------------------------------------------
+bool TreeFileIndex::ReadTree (std::istream &f, int k, std::string &description)
+{
+	// The description runs up to the ";" recorded as its end, with the hash
+	// recorded. If not, the file has changed since the index was saved.
+	std::string text (End[k] - Start[k] + 1, ' ');
+	f.clear ();
+	f.seekg (Start[k]);
+	f.read (&text[0], text.size());
+	unsigned long long hash = FNV_BASIS;
+	for (int i = 1; i < (int)f.gcount(); i++)
+		hash = HashByte (hash, text[i]);
+	if ((f.gcount() != (std::streamsize)text.size()) || (text[text.size() - 1] != ';') || (hash != Hash[k]))
+		return Rebuild () && (k < GetNumTrees()) && ReadTree (f, k, description);
+	text.erase (text.size() - 1);
+
+	// Drop comments and white space outside quotes
+	std::string s;
+	for (int i = 0; i < (int)text.size(); i++)
+	{
+		char c = text[i];
+		if (c == '[')
+		{
+			for (int depth = 0; i < (int)text.size(); i++)
+			{
+				if (text[i] == '[')
+					depth++;
+				else if ((text[i] == ']') && (--depth == 0))
+					break;
+			}
+		}
+		else if (c == '\'')
+		{
+			s += c;
+			for (i++; i < (int)text.size(); i++)
+			{
+				s += text[i];
+				if (text[i] == '\'')
+				{
+					if ((i + 1 < (int)text.size()) && (text[i + 1] == '\''))
+						s += text[++i];
+					else
+						break;
+				}
+			}
+		}
+		else if (!isspace (c))
+			s += c;
+	}
+
+	int t = Table[k];
+	if (t == -1)
+	{
+		description = s + ";";
+		return true;
+	}
+
+	// Translate numbers following "(" or "," as TreesBlock does, quoting
+	// the labels with blanks converted to underscores
+	if ((Translations.find (t) == Translations.end()) && !ReadTable (f, t))
+		return Rebuild () && (k < GetNumTrees()) && ReadTree (f, k, description);
+	const std::map<std::string, std::string> &m = Translations[t];
+	description.clear ();
+	for (int i = 0; i < (int)s.size(); i++)
+	{
+		if (isdigit (s[i]) && (i > 0) && ((s[i - 1] == '(') || (s[i - 1] == ',')))
+		{
+			int j = i;
+			while ((j < (int)s.size()) && isdigit (s[j]))
+				j++;
+			std::map<std::string, std::string>::const_iterator it = m.find (s.substr (i, j - i));
+			if (it != m.end())
+			{
+				std::string label = it->second;
+				for (int l = 0; l < (int)label.size(); l++)
+					if (label[l] == ' ')
+						label[l] = '_';
+				description += "'" + label + "'";
+				i = j - 1;
+				continue;
+			}
+		}
+		description += s[i];
+	}
+	description += ";";
+	return true;
+}
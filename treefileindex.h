@@ -0,0 +1,179 @@
+/**
+ * @file treefileindex.h
+ *
+ * Byte offsets of the trees in a NEXUS or PHYLIP file, so that single trees
+ * can be read without parsing the rest of the file.
+ *
+ */
+
+#ifndef TREEFILEINDEXH
+#define TREEFILEINDEXH
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @class TreeFileIndex
+ * Index of the trees in a tree file, built by a single scan of the file
+ * that tracks only comments, quoted labels and command boundaries. For
+ * each tree it records the byte range of its description (from the first
+ * character after "=" up to the ";"), its name, whether it is flagged
+ * rooted ([&R]) or unrooted ([&U]), and the TRANSLATE command in force,
+ * itself recorded as a byte range. PHYLIP files have one unnamed tree per
+ * ";".
+ *
+ * The index can be saved to and loaded from a small text file (by
+ * convention the tree file name followed by ".idx"), so a large file need
+ * only be scanned once. ReadTree then seeks straight to a tree and returns
+ * its description translated as TreesBlock::GetTranslatedTreeDescription
+ * would, ready for Tree::Parse.
+ *
+ * A saved index is only used if the tree file has the size and
+ * modification time it had when the index was built, and the same first
+ * and last blocks. As that can miss a change in the middle of the file,
+ * ReadTree also checks that each tree still ends at its recorded ";" and
+ * has the hash recorded for it, and an index opened with Open is rebuilt
+ * (and saved again) if not.
+ */
+class TreeFileIndex
+{
+public:
+	enum
+	{
+		tfUnknown = 0,
+		tfNEXUS,
+		tfPHYLIP
+	};
+
+	TreeFileIndex () { Clear (); };
+	virtual ~TreeFileIndex () {};
+
+	virtual void Clear ();
+	/**
+	 * Scan a tree file.
+	 * @param filename the tree file
+	 * @return true if the file could be read and contains at least one tree
+	 */
+	virtual bool Build (const char *filename);
+	/**
+	 * Write the index to a file.
+	 * @return true if successful
+	 */
+	virtual bool Save (const char *filename) const;
+	/**
+	 * Read an index written by Save.
+	 * @return true if successful
+	 */
+	virtual bool Load (const char *filename);
+	/**
+	 * @return true if the index could belong to the tree file, i.e. the
+	 * file has the size, modification time and first and last blocks it
+	 * had when the index was built
+	 */
+	virtual bool Matches (const char *filename) const;
+	/**
+	 * Load the index kept beside a tree file (the file name followed by
+	 * ".idx"), or build it and save it there if there is none or it doesn't
+	 * match the file. ReadTree then rebuilds it the same way if it finds
+	 * it out of date.
+	 * @param filename the tree file
+	 * @return true if successful
+	 */
+	virtual bool Open (const char *filename);
+
+	int GetFormat () const { return Format; };
+	int GetNumTrees () const { return (int)Start.size(); };
+	long long GetStart (int k) const { return Start[k]; };
+	long long GetEnd (int k) const { return End[k]; };
+	const std::string &GetName (int k) const { return Names[k]; };
+	/**
+	 * @return 1 if tree k is flagged rooted, 0 if flagged unrooted, -1 if
+	 * not flagged
+	 */
+	int GetRooted (int k) const { return Rooted[k]; };
+	/**
+	 * @return the TRANSLATE command for tree k, or -1 if there is none
+	 */
+	int GetTable (int k) const { return Table[k]; };
+
+	/**
+	 * Read the description of tree k, with comments and white space
+	 * removed and node numbers translated, ending in ";". If tree k no
+	 * longer matches the index and the index was loaded by Open,
+	 * the index is rebuilt and tree k read from the new one.
+	 * @param f the tree file
+	 * @param k the tree
+	 * @param description the tree description
+	 * @return true if successful
+	 */
+	virtual bool ReadTree (std::istream &f, int k, std::string &description);
+
+	/**
+	 * @return the size of a file in bytes, or -1 if it can't be read
+	 */
+	static long long FileSize (const char *filename);
+	/**
+	 * @return a 64-bit FNV-1a hash of the contents of a file, or 0 if it
+	 * can't be read
+	 */
+	static unsigned long long FileHash (const char *filename);
+	/**
+	 * @return the modification time of a file, or -1 if it can't be read
+	 */
+	static long long FileTime (const char *filename);
+	/**
+	 * @return a 64-bit FNV-1a hash of the first and last blocks of a file,
+	 * or 0 if it can't be read
+	 */
+	static unsigned long long FileFingerprint (const char *filename);
+
+protected:
+	int Format;
+	long long Size;
+	long long ModTime;
+	unsigned long long Fingerprint;
+	/**
+	 * Tree file of an index loaded by Open, which can be rebuilt
+	 */
+	std::string FileName;
+	/**
+	 * True if the index was built from the file rather than loaded
+	 */
+	bool Built;
+	std::vector<long long> Start;
+	std::vector<long long> End;
+	std::vector<std::string> Names;
+	std::vector<int> Rooted;
+	std::vector<int> Table;
+	/**
+	 * FNV-1a hash of each description after its first character, up to and
+	 * including the ";"
+	 */
+	std::vector<unsigned long long> Hash;
+	/**
+	 * Byte range of each TRANSLATE command, after the keyword
+	 */
+	std::vector<long long> TableStart;
+	std::vector<long long> TableEnd;
+	/**
+	 * TRANSLATE commands read so far, by number
+	 */
+	std::map<int, std::map<std::string, std::string> > Translations;
+
+	virtual void ScanNEXUS (std::istream &f);
+	virtual void ScanPHYLIP (std::istream &f);
+	/**
+	 * @return false if table t no longer ends at its recorded ";"
+	 */
+	virtual bool ReadTable (std::istream &f, int t);
+	/**
+	 * Build the index of the file given to Open again, and save it.
+	 * @return false if it was built from the file in the first place, or
+	 * can't be rebuilt
+	 */
+	virtual bool Rebuild ();
+};
+
+#endif
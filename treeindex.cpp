@@ -0,0 +1,472 @@
+#include "treeindex.h"
+#include "succinct.h"
+
+#include <algorithm>
+
+/**
+ * @class PreorderLess
+ * Orders node indices by their position in a preorder traversal.
+ */
+class PreorderLess
+{
+public:
+	PreorderLess (const TreeIndex *t) { index = t; };
+	bool operator() (int a, int b) const { return index->GetPreorder (a) < index->GetPreorder (b); };
+protected:
+	const TreeIndex *index;
+};
+
+//------------------------------------------------------------------------------
+void TreeIndex::Build (Tree &t, int numTaxa)
+{
+	t.MakeNodeList ();
+	int n = t.GetNumNodes ();
+	Allocate (n, numTaxa);
+
+	Root = t.GetRoot()->GetIndex();
+	for (int i = 0; i < n; i++)
+	{
+		NodePtr p = t[i];
+		if (p->GetAnc())
+			Parent[i] = p->GetAnc()->GetIndex();
+		if (p->GetChild())
+			Child[i] = p->GetChild()->GetIndex();
+		if (p->GetSibling())
+			Sibling[i] = p->GetSibling()->GetIndex();
+		if (!p->GetChild())
+		{
+			int x = p->GetLabelNumber() - 1;
+			if ((x >= 0) && (x < numTaxa))
+			{
+				Taxon[i] = x;
+				LeafOfTaxon[x] = i;
+			}
+		}
+	}
+	Traverse ();
+}
+
+//------------------------------------------------------------------------------
+void TreeIndex::Build (const SuccinctTree &s, int numTaxa)
+{
+	int n = s.GetNumNodes ();
+	int leaves = s.GetNumLeaves ();
+	Allocate (n, numTaxa);
+
+	// One pass over the parentheses. Each node is numbered when it closes,
+	// and linked to its last closed child and to its previous sibling.
+	std::vector<int> stack;
+	int leaf = 0, internal = leaves;
+	for (int i = 0; i < 2 * n; i++)
+	{
+		if (s.IsOpen (i))
+		{
+			stack.push_back (-1);
+			continue;
+		}
+		int v;
+		if (s.IsOpen (i - 1))
+		{
+			v = leaf;
+			int x = s.GetTaxonAtRank (leaf++);
+			if ((x >= 0) && (x < numTaxa))
+			{
+				Taxon[v] = x;
+				LeafOfTaxon[x] = v;
+			}
+		}
+		else
+		{
+			v = internal++;
+			Child[v] = stack.back();
+		}
+		stack.pop_back ();
+		// Children of v were linked last to first, so reverse them
+		int prev = -1;
+		for (int c = Child[v]; c != -1; )
+		{
+			int next = Sibling[c];
+			Sibling[c] = prev;
+			Parent[c] = v;
+			prev = c;
+			c = next;
+		}
+		Child[v] = prev;
+		if (!stack.empty())
+		{
+			Sibling[v] = stack.back();
+			stack.back() = v;
+		}
+		else
+			Root = v;
+	}
+	Traverse ();
+}
+
+//------------------------------------------------------------------------------
+void TreeIndex::Contract (const std::vector<bool> &contract, std::vector<int> &map)
+{
+	int n = GetNumNodes ();
+	map.assign (n, -1);
+	int m = 0;
+	for (int i = 0; i < n; i++)
+		if (IsLeaf (i) || (i == Root) || !contract[i])
+			map[i] = m++;
+	if (m == n)
+		return;
+
+	// Nearest remaining proper ancestor of each node, parents first
+	std::vector<int> up (n, -1);
+	for (int k = 1; k < n; k++)
+	{
+		int u = Order[k];
+		int a = Parent[u];
+		up[u] = (map[a] != -1) ? a : up[a];
+	}
+
+	std::vector<int> order (Order);
+	std::vector<int> taxon (Taxon);
+	int root = Root;
+	Allocate (m, GetNumTaxa());
+	Root = map[root];
+
+	// Visiting in reverse preorder and adding each node to the front of its
+	// parent's children keeps the children in their original order
+	for (int k = n - 1; k >= 0; k--)
+	{
+		int u = order[k];
+		int v = map[u];
+		if (v == -1)
+			continue;
+		if (taxon[u] != -1)
+		{
+			Taxon[v] = taxon[u];
+			LeafOfTaxon[taxon[u]] = v;
+		}
+		if (u != root)
+		{
+			int a = map[up[u]];
+			Parent[v] = a;
+			Sibling[v] = Child[a];
+			Child[a] = v;
+		}
+	}
+	Traverse ();
+}
+
+//------------------------------------------------------------------------------
+int TreeIndex::Reroot (const std::vector<bool> &outgroup, std::vector<int> &edge)
+{
+	int n = GetNumNodes ();
+	edge.clear ();
+
+	// Leaves of the outgroup below each node, children before parents
+	std::vector<int> count (n, 0);
+	int m = 0;
+	for (int i = 0; i < n; i++)
+	{
+		int x = Taxon[i];
+		if ((x != -1) && (x < (int)outgroup.size()) && outgroup[x])
+		{
+			count[i] = 1;
+			m++;
+		}
+	}
+	if ((m == 0) || (m == NumLeaves))
+		return rrMissing;
+	for (int k = n - 1; k > 0; k--)
+		count[Parent[Order[k]]] += count[Order[k]];
+
+	// The edge above v separates the outgroup from the rest if v's cluster
+	// is either the outgroup or everything else
+	int v = -1;
+	for (int k = 1; (k < n) && (v == -1); k++)
+	{
+		int u = Order[k];
+		int size = GetClusterSize (u);
+		if (((count[u] == m) && (size == m)) || ((count[u] == 0) && (size == NumLeaves - m)))
+			v = u;
+	}
+	if (v == -1)
+		return rrNotMonophyletic;
+
+	// New parent of each node, with the new root as node n. Reversing the
+	// path from v's parent p up to the old root makes each node on it the
+	// parent of the one above, which takes over that node's edge.
+	int p = Parent[v];
+	std::vector<int> parent (Parent);
+	parent.push_back (-1);
+	std::vector<int> from (n + 1, -1);
+	for (int i = 0; i < n; i++)
+		from[i] = i;
+	for (int a = p; Parent[a] != -1; a = Parent[a])
+	{
+		parent[Parent[a]] = a;
+		from[Parent[a]] = a;
+	}
+	parent[v] = n;
+	parent[p] = n;
+	from[p] = v;
+
+	// The old root has lost one child, and is suppressed if left with one
+	std::vector<bool> removed (n + 1, false);
+	if (Degree[Root] <= 2)
+	{
+		removed[Root] = true;
+		for (int c = Child[Root]; c != -1; c = Sibling[c])
+			if (parent[c] == Root)
+				parent[c] = parent[Root];
+	}
+
+	// Children in their old preorder, except the new root's, which are the
+	// outgroup's side then the rest
+	std::vector<int> child (n + 1, -1);
+	std::vector<int> sibling (n + 1, -1);
+	std::vector<int> last (n + 1, -1);
+	int other = -1;
+	for (int k = 0; k < n; k++)
+	{
+		int u = Order[k];
+		int a = parent[u];
+		if (removed[u])
+			continue;
+		if (a == n)
+		{
+			if (u != v)
+				other = u;
+			continue;
+		}
+		if (last[a] == -1)
+			child[a] = u;
+		else
+			sibling[last[a]] = u;
+		last[a] = u;
+	}
+	child[n] = (count[v] == m) ? v : other;
+	sibling[child[n]] = (count[v] == m) ? other : v;
+
+	// Leaves keep their indices, and internal nodes are numbered in postorder
+	std::vector<int> id (n + 1, -1);
+	int next = NumLeaves;
+	int u = n;
+	while (child[u] != -1)
+		u = child[u];
+	for (;;)
+	{
+		id[u] = (child[u] == -1) ? u : next++;
+		if (u == n)
+			break;
+		if (sibling[u] != -1)
+		{
+			u = sibling[u];
+			while (child[u] != -1)
+				u = child[u];
+		}
+		else
+			u = parent[u];
+	}
+
+	std::vector<int> taxon (Taxon);
+	Allocate (next, GetNumTaxa());
+	Root = id[n];
+	edge.assign (next, -1);
+	for (int i = 0; i <= n; i++)
+	{
+		int w = id[i];
+		if (w == -1)
+			continue;
+		if (i != n)
+			Parent[w] = id[parent[i]];
+		if (child[i] != -1)
+			Child[w] = id[child[i]];
+		if (sibling[i] != -1)
+			Sibling[w] = id[sibling[i]];
+		if ((i < n) && (taxon[i] != -1))
+		{
+			Taxon[w] = taxon[i];
+			LeafOfTaxon[taxon[i]] = w;
+		}
+		edge[w] = from[i];
+	}
+	Traverse ();
+	return rrRerooted;
+}
+
+//------------------------------------------------------------------------------
+void TreeIndex::Allocate (int n, int numTaxa)
+{
+	Parent.assign (n, -1);
+	Child.assign (n, -1);
+	Sibling.assign (n, -1);
+	Degree.assign (n, 0);
+	Depth.assign (n, 0);
+	Taxon.assign (n, -1);
+	LeafOfTaxon.assign (numTaxa, -1);
+	Pre.assign (n, 0);
+	Order.assign (n, 0);
+	Size.assign (n, 1);
+	LeafLo.assign (n, n);
+	LeafHi.assign (n, -1);
+	LeafAtRank.clear ();
+	Sparse.clear ();
+	Log2.clear ();
+	Root = -1;
+}
+
+//------------------------------------------------------------------------------
+void TreeIndex::Traverse ()
+{
+	int n = GetNumNodes ();
+	NumLeaves = 0;
+	for (int i = 0; i < n; i++)
+		if (Child[i] == -1)
+			NumLeaves++;
+	Parent[Root] = -1;
+	Sibling[Root] = -1;
+
+	// Preorder traversal without recursion, so deep (e.g., caterpillar)
+	// trees don't exhaust the stack
+	int k = 0;
+	int p = Root;
+	while (p != -1)
+	{
+		Pre[p] = k;
+		Order[k++] = p;
+		if (p != Root)
+		{
+			Depth[p] = Depth[Parent[p]] + 1;
+			Degree[Parent[p]]++;
+		}
+		if (Child[p] != -1)
+			p = Child[p];
+		else
+		{
+			LeafLo[p] = LeafHi[p] = (int)LeafAtRank.size();
+			LeafAtRank.push_back (p);
+			while ((p != -1) && (Sibling[p] == -1))
+				p = Parent[p];
+			if (p != -1)
+				p = Sibling[p];
+		}
+	}
+
+	// Clusters and subtree sizes, children before parents
+	for (int j = n - 1; j > 0; j--)
+	{
+		int q = Order[j];
+		int a = Parent[q];
+		Size[a] += Size[q];
+		if (LeafLo[q] < LeafLo[a])
+			LeafLo[a] = LeafLo[q];
+		if (LeafHi[q] > LeafHi[a])
+			LeafHi[a] = LeafHi[q];
+	}
+}
+
+//------------------------------------------------------------------------------
+void TreeIndex::BuildLCA ()
+{
+	int n = GetNumNodes ();
+	Log2.assign (n + 1, 0);
+	for (int i = 2; i <= n; i++)
+		Log2[i] = Log2[i / 2] + 1;
+
+	Sparse.assign (1, Order);
+	for (int j = 1; (1 << j) <= n; j++)
+	{
+		int half = 1 << (j - 1);
+		int len = n - (1 << j) + 1;
+		Sparse.push_back (std::vector<int> (len));
+		std::vector<int> &prev = Sparse[j - 1];
+		std::vector<int> &cur = Sparse[j];
+		for (int i = 0; i < len; i++)
+		{
+			int a = prev[i];
+			int b = prev[i + half];
+			cur[i] = (Depth[a] <= Depth[b]) ? a : b;
+		}
+	}
+}
+
+//------------------------------------------------------------------------------
+// The shallowest node strictly after i and up to j in preorder is a child
+// of LCA(i,j) (Fischer and Heun 2006), so one range minimum query suffices.
+int TreeIndex::LCA (int i, int j) const
+{
+	if (i == j)
+		return i;
+	int a = Pre[i];
+	int b = Pre[j];
+	if (a > b)
+	{
+		int tmp = a;
+		a = b;
+		b = tmp;
+	}
+	a++;
+	int k = Log2[b - a + 1];
+	int x = Sparse[k][a];
+	int y = Sparse[k][b - (1 << k) + 1];
+	return Parent[(Depth[x] <= Depth[y]) ? x : y];
+}
+
+//------------------------------------------------------------------------------
+void TreeIndex::Induce (std::vector<int> &leaves, InducedSubtree &s) const
+{
+	s.Clear ();
+	if (leaves.empty())
+		return;
+	std::sort (leaves.begin(), leaves.end(), PreorderLess (this));
+	leaves.erase (std::unique (leaves.begin(), leaves.end()), leaves.end());
+
+	// Build the subtree with a stack holding the rightmost path, recording
+	// each node and the host node of its parent as it is popped. Nodes are
+	// popped after all of their descendants, which gives postorder.
+	std::vector<int> stk;
+	std::vector<int> anc;
+	stk.push_back (leaves[0]);
+	for (unsigned int i = 1; i < leaves.size(); i++)
+	{
+		int v = leaves[i];
+		int l = LCA (v, stk.back());
+		if (l != stk.back())
+		{
+			while ((stk.size() >= 2) && (Depth[stk[stk.size() - 2]] >= Depth[l]))
+			{
+				s.Host.push_back (stk.back());
+				anc.push_back (stk[stk.size() - 2]);
+				stk.pop_back ();
+			}
+			if (stk.back() != l)
+			{
+				s.Host.push_back (stk.back());
+				anc.push_back (l);
+				stk.pop_back ();
+				stk.push_back (l);
+			}
+		}
+		stk.push_back (v);
+	}
+	while (stk.size() >= 2)
+	{
+		s.Host.push_back (stk.back());
+		anc.push_back (stk[stk.size() - 2]);
+		stk.pop_back ();
+	}
+	s.Host.push_back (stk[0]);
+	anc.push_back (-1);
+
+	// Convert host node of each parent into a position in s.Host
+	int m = (int)s.Host.size();
+	std::vector< std::pair<int,int> > pos (m);
+	for (int i = 0; i < m; i++)
+		pos[i] = std::pair<int,int> (s.Host[i], i);
+	std::sort (pos.begin(), pos.end());
+	s.Parent.assign (m, -1);
+	for (int i = 0; i < m - 1; i++)
+	{
+		std::vector< std::pair<int,int> >::iterator it =
+			std::lower_bound (pos.begin(), pos.end(), std::pair<int,int> (anc[i], -1));
+		s.Parent[i] = (*it).second;
+	}
+}
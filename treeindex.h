@@ -0,0 +1,207 @@
+/**
+ * @file treeindex.h
+ *
+ * Flat, array based view of a rooted tree for fast cluster queries.
+ *
+ */
+
+#ifndef TREEINDEXH
+#define TREEINDEXH
+
+#include <vector>
+
+#include "TreeLib.h"
+
+class SuccinctTree;
+
+/**
+ * @class InducedSubtree
+ * The subtree of a host tree induced by a set of its leaves, i.e. the
+ * minimal subtree connecting those leaves with nodes of degree two
+ * suppressed. Each node is identified with a node of the host tree
+ * (the LCA of the leaves below it).
+ */
+class InducedSubtree
+{
+public:
+	/**
+	 * Host node of each node of the induced subtree, in postorder
+	 * (children before parents, root last).
+	 */
+	std::vector<int> Host;
+	/**
+	 * For each node, the position in Host of its parent, or -1 for the root.
+	 */
+	std::vector<int> Parent;
+
+	virtual ~InducedSubtree () {};
+	virtual void Clear () { Host.clear(); Parent.clear(); };
+	virtual int GetNumNodes () const { return (int)Host.size(); };
+	virtual int GetRoot () const { return (int)Host.size() - 1; };
+};
+
+/**
+ * Outcomes of TreeIndex::Reroot
+ */
+enum
+{
+	rrRerooted = 0,			// rooted on the edge separating the outgroup
+	rrMissing,				// the tree has no taxa of the outgroup, or only those
+	rrNotMonophyletic		// no edge separates the outgroup from the rest
+};
+
+/**
+ * @class TreeIndex
+ * Stores a rooted tree as a set of integer arrays indexed by the node's
+ * position in the tree's node list (Node::GetIndex), so leaves have indices
+ * 0 to (leaves - 1) and internal nodes follow in postorder.
+ *
+ * Leaves are mapped onto taxa using Node::GetLabelNumber, which
+ * callers are expected to have set to (1 + the index of the leaf's label in
+ * the profile), as in main.cpp. Leaves are also ranked in preorder, so
+ * that the cluster of every node is an interval of leaf ranks
+ * (Day 1985, J. Classif. 2:7-28). LCA queries take O(1) time after an
+ * O(n log n) preprocessing step that is only done if BuildLCA is called.
+ */
+class TreeIndex
+{
+public:
+	TreeIndex () { Root = -1; };
+	virtual ~TreeIndex () {};
+
+	/**
+	 * Index the tree t. Calls t.MakeNodeList().
+	 * @param t the tree
+	 * @param numTaxa number of taxa in the profile, used to size the
+	 * taxon to leaf map
+	 */
+	virtual void Build (Tree &t, int numTaxa);
+	/**
+	 * Index a tree unpacked from a TreeCollection. Leaves are numbered in
+	 * preorder and internal nodes in postorder after them.
+	 * @param s the tree
+	 * @param numTaxa number of taxa in the profile
+	 */
+	virtual void Build (const SuccinctTree &s, int numTaxa);
+	/**
+	 * Contract the edges above the flagged internal nodes, so their children
+	 * become children of their parents. The root and leaves are never
+	 * removed. The remaining nodes keep their order, so leaves still come
+	 * first and internal nodes follow in postorder. Call before BuildLCA.
+	 * @param contract true for each node to remove
+	 * @param map the new index of each old node, or -1 if it was removed
+	 */
+	virtual void Contract (const std::vector<bool> &contract, std::vector<int> &map);
+	/**
+	 * Treat the tree as unrooted and root it on the edge that separates the
+	 * taxa of an outgroup from the rest, in O(n) time. The new root has the
+	 * outgroup's side as its first child and the rest as its second, and an
+	 * old root left with one child is suppressed. Leaves keep their indices
+	 * and internal nodes are renumbered in postorder. If there is no such
+	 * edge the tree is unchanged. Call before BuildLCA.
+	 * @param outgroup true for each taxon in the outgroup
+	 * @param edge for each new node, the old node whose edge to its parent
+	 * is now the edge above it (the paths from the old to the new root are
+	 * reversed), or -1 for the new root
+	 * @return rrRerooted, rrMissing or rrNotMonophyletic
+	 */
+	virtual int Reroot (const std::vector<bool> &outgroup, std::vector<int> &edge);
+	/**
+	 * Prepare the sparse table used by LCA.
+	 */
+	virtual void BuildLCA ();
+
+	int GetNumNodes () const { return (int)Parent.size(); };
+	int GetNumLeaves () const { return NumLeaves; };
+	int GetNumTaxa () const { return (int)LeafOfTaxon.size(); };
+	int GetRoot () const { return Root; };
+	int GetParent (int i) const { return Parent[i]; };
+	int GetChild (int i) const { return Child[i]; };
+	int GetSibling (int i) const { return Sibling[i]; };
+	int GetDegree (int i) const { return Degree[i]; };
+	int GetDepth (int i) const { return Depth[i]; };
+	bool IsLeaf (int i) const { return Child[i] == -1; };
+	/**
+	 * @return the taxon of leaf i, or -1 if i is internal
+	 */
+	int GetTaxon (int i) const { return Taxon[i]; };
+	/**
+	 * @return the leaf labelled with taxon x, or -1 if x is not in the tree
+	 */
+	int GetLeafOfTaxon (int x) const { return LeafOfTaxon[x]; };
+	/**
+	 * @return the position of node i in a preorder traversal of the tree
+	 */
+	int GetPreorder (int i) const { return Pre[i]; };
+	/**
+	 * @return the node at position k in a preorder traversal of the tree
+	 */
+	int GetNodeAtPreorder (int k) const { return Order[k]; };
+	/**
+	 * @return the number of nodes in the subtree rooted at i (including i)
+	 */
+	int GetSubtreeSize (int i) const { return Size[i]; };
+	/**
+	 * The cluster of node i is the set of leaves with ranks
+	 * GetLeafLo(i) to GetLeafHi(i) inclusive.
+	 */
+	int GetLeafLo (int i) const { return LeafLo[i]; };
+	int GetLeafHi (int i) const { return LeafHi[i]; };
+	/**
+	 * @return the number of leaves in the cluster of node i
+	 */
+	int GetClusterSize (int i) const { return LeafHi[i] - LeafLo[i] + 1; };
+	/**
+	 * @return the leaf with rank k in the preorder leaf ordering
+	 */
+	int GetLeafAtRank (int k) const { return LeafAtRank[k]; };
+	/**
+	 * @return true if a is an ancestor of (or equal to) b
+	 */
+	bool IsAncestor (int a, int b) const { return (Pre[a] <= Pre[b]) && (Pre[b] < Pre[a] + Size[a]); };
+	/**
+	 * @return the lowest common ancestor of nodes i and j. BuildLCA must
+	 * have been called.
+	 */
+	int LCA (int i, int j) const;
+	/**
+	 * Build the subtree induced by a set of leaves.
+	 * @param leaves the leaves (node indices), sorted into preorder on return
+	 * @param s the induced subtree
+	 */
+	virtual void Induce (std::vector<int> &leaves, InducedSubtree &s) const;
+
+protected:
+	int Root;
+	int NumLeaves;
+	std::vector<int> Parent;
+	std::vector<int> Child;
+	std::vector<int> Sibling;
+	std::vector<int> Degree;
+	std::vector<int> Depth;
+	std::vector<int> Taxon;
+	std::vector<int> LeafOfTaxon;
+	std::vector<int> Pre;
+	std::vector<int> Order;
+	std::vector<int> Size;
+	std::vector<int> LeafLo;
+	std::vector<int> LeafHi;
+	std::vector<int> LeafAtRank;
+	/**
+	 * Sparse table of the shallowest node in each run of 2^k nodes in preorder
+	 */
+	std::vector< std::vector<int> > Sparse;
+	std::vector<int> Log2;
+
+	/**
+	 * Size the arrays for a tree of n nodes.
+	 */
+	virtual void Allocate (int n, int numTaxa);
+	/**
+	 * Fill in the traversal orders, depths, degrees and clusters once
+	 * Root, Parent, Child, Sibling and Taxon are set.
+	 */
+	virtual void Traverse ();
+};
+
+#endif